@@ -8,30 +8,265 @@
 // CLASS/TERM:    CP372/14S8W2
 // DESIGNER:      Andrew Batzel
 // FUNCTIONS:     getFile - Prompts the user for an input file.
+//                openMappedInput - Maps the input file into memory for fast parsing.
+//                readInteger - Reads the next integer from the input file.
+//                scanDigits - Converts a run of up to 8 digits at once.
+//                closeInput - Closes the input file.
 //                fileExists - Tests to see if the file exists.
 //                isEmptyFile - Tests to see if there is any data in the file.
 //                getData - Reads from file to generate search tree.
+//                bulkLoad - Reads the whole file and builds a balanced tree from it.
+//                collectIntegers - Reads every integer in the file into an array.
+//                sortUnique - Sorts an array and removes repeated values.
+//                reportDuplicates - Displays a notice for each repeated value in input order.
+//                buildBalanced - Builds a height optimal subtree from sorted values.
+//                parallelLoad - Reads, sorts and builds the tree on several threads.
+//                splitInput - Splits the file contents into chunks at whitespace.
+//                parseChunk - Reads and sorts the integers in one chunk.
+//                mergeRuns - Merges two sorted arrays and notes values in both.
+//                buildParallel - Builds the subtrees of a balanced tree on several threads.
+//                loadInputFile - Prompts for the input file and loads the tree from it.
+//                findTree - Looks up a named tree.
+//                addTree - Adds a tree to the named trees.
+//                createNamedTree - Creates an empty tree set up the way the options select.
+//                loadNamedTree - Builds a named tree from an input file.
+//                releaseTree - Deallocates a tree and all of its nodes.
+//                destroyCatalog - Deallocates every named tree.
+//                loadLogBase - Loads the snapshot the mutation log was last compacted into.
+//                openLog - Replays the mutation log and opens it for new changes.
+//                replayLog - Reads the changes in one mutation log file.
+//                applyChanges - Applies logged changes to the tree.
+//                appendLog - Records an add or delete in the mutation log.
+//                runCommitter - Writes and syncs the mutation log a group at a time.
+//                commitLog - Writes and syncs one group of log records.
+//                logChecksum - Computes the checksum of a group of log records.
+//                compactLog - Starts folding the mutation log into its base snapshot.
+//                writeLogBase - Writes sorted integers as a synced snapshot file.
+//                foldLog - Replaces the base snapshot and drops the folded log.
+//                replayBase - Rebuilds the keys of the tree from the base and the folded log.
+//                replaceFile - Renames a file over another one.
+//                syncPath - Forces a file or directory to disk.
+//                closeLog - Commits the mutation log and stops its threads.
+//                reportLogFailure - Reports the first failed write to the mutation log.
+//                saveSnapshot - Writes the tree to a binary snapshot file.
+//                loadSnapshot - Rebuilds the tree from a binary snapshot file.
+//                recalculateNodes - Sets the height and size of every node after a rebuild.
+//                balanceTree - Rebalances a whole tree in place.
+//                compressVine - Rotates every other node of a vine to its parent.
 //                createTree - Allocates memory for the main tree structure.
 //                isEmptyTree - Tests to see if the tree is NULL.
 //                createNode - Allocates memory for nodes within the tree.
+//                createArena - Allocates an empty node arena.
+//                growArena - Adds a slab of node memory to an arena.
+//                allocateSlab - Allocates slab memory, using huge pages when asked.
+//                releaseSlab - Returns slab memory to the operating system.
+//                releaseNode - Returns a node to its arena free list or the heap.
+//                joinArena - Moves the slabs of one arena into another.
+//                destroyArena - Releases every slab, and every node, of an arena.
 //                insertNode - Inserts a node into the correct location in the tree.
+//                fingerInsert - Adds a key starting from where the last one was added.
+//                settleLevel - Adds the inserts counted at one finger level to its node size.
+//                dropLevels - Drops the finger levels nearest the root once it is full.
+//                settleAbove - Adds the inserts counted above a finger to the nodes there.
+//                finishFinger - Brings every node size a finger kept up to date.
+//                nodeHeight - Returns the height of a subtree.
+//                updateNode - Recalculates the height and size of a node from its children.
+//                nodeSize - Returns the number of nodes in a subtree.
+//                rotateLeft - Rotates a subtree to the left.
+//                rotateRight - Rotates a subtree to the right.
+//                rebalanceNode - Restores the AVL balance of a subtree.
+//                rebalancePath - Rebalances every node along a recorded path.
+//                sameKey - Tests whether two keys are equal under the tree's comparison.
+//                copyEntry - Copies the key and any value of one node to another.
 //                findNode - Searches for a target node in the tree.
+//                findBatch - Searches for a batch of keys with the searches interleaved.
+//                createCache - Allocates an empty hot key cache.
+//                cacheSlot - Returns the cache entry a key is kept in.
+//                cachedFind - Looks a key up in the hot key cache.
+//                storeCache - Keeps the result of a search in the hot key cache.
+//                forgetKey - Drops the cached result for one key.
+//                clearCache - Drops every cached result.
+//                destroyCache - Deallocates a hot key cache.
+//                indexedFind - Searches an index of the tree when there is a current one.
+//                freezeTree - Builds the cache friendly frozen index of the tree.
+//                frozenFind - Searches the frozen index.
+//                buildKary - Builds the wide node index searched with SIMD.
+//                fillKary - Places sorted integers in a block and its subtrees.
+//                selectBlockRank - Picks the block comparison the processor supports.
+//                scalarBlockRank - Ranks a value in a block one key at a time.
+//                sse2BlockRank - Ranks a value in a block 4 keys at a time.
+//                avx2BlockRank - Ranks a value in a block 8 keys at a time.
+//                karyContains - Tests whether an integer is in the wide node index.
+//                containsBatch - Tests a batch of integers for membership.
+//                membershipDisplay - Displays the tested integers found in the tree.
 //                displayMenu - Displays the actions available to the user.
 //                actionController - Makes function calls based on the users chosen action.
+//                readNumber - Reads the number of an add, delete or find.
+//                reportAdd - Writes the result of an add.
+//                reportDelete - Writes the result of a delete.
+//                reportFind - Writes the heading of a find, or that the number is missing.
+//                addInteger - Adds a number unless it is already in the tree.
+//                deleteInteger - Deletes a number if it is in the tree.
+//                displayTree - Displays every integer of a tree.
+//                displaySubtree - Finds a number and displays the subtree below it.
+//                showPrompt - Displays a prompt when a user is at the menu.
+//                finishAction - Pauses and clears the screen when a user is at the menu.
+//                runBatch - Runs a stream of menu commands without prompts or pauses.
+//                runCommands - Runs the batch file or the menu until exit.
+//                batchOutput - Output buffer that writes in large blocks.
 //                deleteNode - Finds the location of a target node that will be deleted.
 //                deleteFromTree - Removes a node from the search tree.
+//                insertBatch - Adds a batch of keys in one sorted pass.
+//                deleteBatch - Removes a batch of keys in one sorted pass.
+//                sortBatch - Sorts the keys of a batch and sets aside repeats.
+//                mergeBatch - Merges sorted keys into, or out of, the tree.
+//                joinTrees - Joins two subtrees with a node between them.
+//                removeLargest - Takes the largest node out of a subtree.
 //                nodeCount - Accesses the count element of the tree structure.
 //                inOrderDisplay - Traverses the tree in ascending order.
+//                startIterator - Positions an inorder iterator at the start of a subtree.
+//                nextNode - Returns the next node of an inorder iterator.
+//                seekIterator - Positions an inorder iterator at the first node not less than a value.
+//                countLess - Counts the integers less than a value (rank).
+//                selectNode - Finds the integer at a position in ascending order.
+//                countRange - Counts the integers between two values.
+//                rangeDisplay - Displays the integers between two values.
+//                combineTrees - Builds the union, intersection or difference of two trees.
+//                combineParallel - Builds the same tree as combineTrees on several threads.
+//                mergeKeys - Merges the keys of two trees within a range by a set operation.
+//                nextBefore - Returns the next node of an iterator that is below a limit.
 //                formatDisplay - Displays a number within the tree and ensures only 10 numbers are on each row.
+//                startDisplay - Readies a display buffer for an output stream.
+//                flushDisplay - Writes the display buffer to its output stream.
+//                depthHistogram - Counts the nodes at each depth of the tree.
+//                displayStats - Displays the tree shape, search and latency statistics.
+//                writeStatsJson - Writes the statistics as JSON.
+//                recordLatency - Adds a command time to its histogram (BST_STATS builds).
+//                latencyPercentile - Finds the latency a fraction of commands fall within.
 //                freeNodes - Deallocates all nodes within the search tree.
 //                destroyTree - Deallocates the main tree structure.
+//                createConcurrentTree - Copies a tree into a tree readers can search without locks.
+//                registerReader - Claims a reader slot for a lookup thread.
+//                unregisterReader - Releases a reader slot.
+//                concurrentFind - Searches the published tree without taking a lock.
+//                concurrentInsert - Adds an integer by copying the path to it.
+//                concurrentDelete - Removes an integer by copying the path to it.
+//                ownNode - Makes a private copy of a published node for an update.
+//                rebalanceCopy - Rebalances a private node, copying the nodes it rotates.
+//                publishRoot - Publishes the root of an update and retires replaced nodes.
+//                reclaimNodes - Deletes retired nodes no reader can still see.
+//                openSnapshot - Keeps the current version of a concurrent tree readable.
+//                closeSnapshot - Releases a version kept by openSnapshot.
+//                snapshotDisplay - Displays one version while changes go on.
+//                destroyConcurrentTree - Deallocates a concurrent tree.
+//                runMainTree - Runs the menu commands on the BST.
+//                runCompact - Runs the menu commands on the compact node store.
+//                buildCompact - Builds a height optimal compact subtree from sorted values.
+//                createCompactTree - Allocates an empty compact node store.
+//                runSharded - Runs the menu commands on a tree split over shards.
+//                createShardedTree - Splits a BST by key range over shards with worker threads.
+//                splitTree - Moves the nodes at or above a value into a second tree.
+//                findShard - Finds the shard whose key range holds an integer.
+//                runShard - Runs the batches queued to a shard (worker thread).
+//                runOperation - Runs an add, delete or find on a shard's tree.
+//                readOperations - Reads a group of adds, deletes and finds from a batch.
+//                submitOperations - Queues a group of operations to the shards.
+//                waitOperations - Waits for the shards to run a group of operations.
+//                finishOperations - Waits for a group of operations and reports them.
+//                sendOperation - Runs one add, delete or find on its shard and waits for it.
+//                getOptions - Reads the command line options.
+//                allowOption - Reports an option given with a mode it does not apply to.
+//                runBenchmarks - Times the tree operations (BST_BENCHMARK builds only).
+//                getBenchmarkOptions - Reads the benchmark command line options.
+//                splitList - Splits a comma separated list.
+//                generateWorkload - Generates the integers for one distribution.
+//                createZipf - Prepares a Zipf distribution.
+//                nextZipf - Draws a rank from a Zipf distribution.
+//                scatterRank - Maps a Zipf rank to a scattered integer.
+//                isolateBenchmark - Runs the benchmark of a structure in a process of its own.
+//                benchmarkStructure - Runs the benchmark of a structure.
+//                benchmarkTree - Times add, find, display and delete on the tree.
+//                benchmarkSet - Times the same operations on std::set.
+//                benchmarkShards - Times the same operations on a sharded tree.
+//                runGroup - Runs a group of adds, deletes or finds on the shards.
+//                benchmarkConcurrent - Times the concurrent tree with lookup threads.
+//                benchmarkSnapshot - Times deletes from a concurrent tree under a snapshot.
+//                benchmarkFinger - Times and checks the finger insert of the file load.
+//                benchmarkRecords - Times a tree of long long keys with string values.
+//                timeOperations - Times a run of operations and samples latencies.
+//                reportResult - Writes one benchmark result.
+//                treeDepth - Measures the height of any tree.
+//                peakMemory - Returns the peak memory of the process.
 //------------------------------------------------------------------------------
 
 #include <iostream>
 #include <iomanip>
 #include <fstream>
+#include <sstream>
 #include <cstddef>
+#include <new>
+#include <cstdint>
+#include <climits>
 #include <cctype>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <streambuf>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <system_error>
+#include <chrono>
+#include <functional>
+#include <type_traits>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// the benchmark build replaces the menu with timed workloads
+#if defined(BST_BENCHMARK)
+#include <random>
+#include <set>
+#include <cmath>
+#if defined(_WIN32)
+#include <psapi.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
+#endif
+
+// memory is fetched ahead of use where the compiler supports it
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address)
+#endif
+
+// wide node blocks are compared with SSE2 or AVX2, chosen when the program runs
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define KARY_X86
+#endif
+
+// digits are converted 8 at a time on little endian machines
+#if defined(_WIN32) || (defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__))
+#define SCAN_WIDE_DIGITS
+#endif
 
 using namespace std;
 
@@ -39,807 +274,12409 @@ using namespace std;
 const int MAX_COLUMNS = 10,
           INIT_COLUMN = 0;
 const char EXIT_CHAR = 'E';
+const char MENU_CHOICES[] = "SADFMIXRKCLWNOUTE";
+const size_t MENU_COMMANDS = sizeof(MENU_CHOICES) - 1;
+const char *const MENU_LINES[MENU_COMMANDS] = {"S - Show all integerrs in the binary search tree.",
+                                               "A - Add an integer to the tree.",
+                                               "D - Delete an integer from the tree.",
+                                               "F - Find an integer and display its subtree.",
+                                               "M - Test a list of integers for membership.",
+                                               "I - Add a list of integers to the tree.",
+                                               "X - Delete a list of integers from the tree.",
+                                               "R - Rank an integer among those in the tree.",
+                                               "K - Find the integer at a position in ascending order.",
+                                               "C - Count the integers between two values.",
+                                               "L - List the integers between two values.",
+                                               "W - Write a snapshot of the tree to a file.",
+                                               "N - Load a file of integers into a new named tree.",
+                                               "O - Combine two named trees by union, intersection or difference.",
+                                               "U - Use a named tree for the other options.",
+                                               "T - Show tree and search statistics.",
+                                               "E - Exit the program."};
+const int MAX_TREE_HEIGHT = 64;
+const size_t FINGER_MAX_LEVELS = MAX_TREE_HEIGHT;
+const size_t ARENA_SLAB_BYTES = 2 * 1024 * 1024;
+const int MAX_READERS = 64;
+const int PARALLEL_MIN_KEYS = 65536;
+const int FIND_BATCH_STREAMS = 16;
+const int HOT_CACHE_BITS = 12,
+          HOT_CACHE_ENTRIES = 1 << HOT_CACHE_BITS;
+const int FROZEN_LINE_KEYS = 16,
+          FROZEN_REBUILD_DIVISOR = 4,
+          KARY_WIDTH = 16;
+const int STATS_OPERATIONS = 3,
+          STATS_FIND = 0,
+          STATS_INSERT = 1,
+          STATS_DELETE = 2,
+          STATS_LATENCY_BUCKETS = 40,
+          STATS_DEPTH_ROWS = 32;
+const char BATCH_INSERTED = 'I',
+           BATCH_DUPLICATE = 'U',
+           BATCH_DELETED = 'D',
+           BATCH_MISSING = 'M',
+           BATCH_FAILED = 'F';
+const int BATCH_SPLIT = 0,
+          BATCH_LEFT = 1,
+          BATCH_JOIN = 2;
+const char SET_UNION = 'U',
+           SET_INTERSECTION = 'I',
+           SET_DIFFERENCE = 'D';
+const char MAIN_TREE_NAME[] = "main";
+const char LOG_INSERT = 'A',
+           LOG_DELETE = 'D';
+const char LOG_BASE_SUFFIX[] = ".base",
+           LOG_OLD_SUFFIX[] = ".old",
+           LOG_TEMPORARY_SUFFIX[] = ".tmp";
+const size_t LOG_RECORD_BYTES = 5,
+             LOG_GROUP_BYTES = 64 * 1024;
+const int LOG_COMMIT_MS = 10;
+const unsigned long long LOG_COMPACT_RECORDS = 4 * 1024 * 1024;
+const size_t BATCH_BUFFER_BYTES = 1024 * 1024,
+             DISPLAY_BUFFER_BYTES = 1024 * 1024,
+             DISPLAY_ENTRY_BYTES = 16;
+const int DISPLAY_WIDTH = 6;
+const char DIGIT_PAIRS[] = "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+                           "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+                           "8081828384858687888990919293949596979899";
+const char SNAPSHOT_MAGIC[4] = {'B', 'S', 'T', 'S'};
+const unsigned int SNAPSHOT_VERSION = 1,
+                   SNAPSHOT_BALANCED = 1,
+                   SHAPE_LEFT = 1,
+                   SHAPE_RIGHT = 2;
+const unsigned int COMPACT_NULL = 0,
+                   COMPACT_FIRST_NODES = 1024,
+                   COMPACT_MAX_NODES = UINT_MAX;
+const char COMPACT_CHOICES[] = "SADFE";
+const int MAX_SHARDS = 64,
+          SHARD_QUEUE_SLOTS = 8,
+          SHARD_GROUP_OPERATIONS = 4096,
+          SHARD_IDLE_SPINS = 64;
+const char SHARD_CHOICES[] = "SADFE";
+const unsigned long long POWERS_OF_TEN[9] = {1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL,
+                                             1000000ULL, 10000000ULL, 100000000ULL};
 
 // abstract data types
 
-struct treeNode {
-                   int number;
-                   treeNode *leftPtr;
-                   treeNode *rightPtr;
-                };
+// the tree is a template over its key type, key comparison and mapped value;
+// the menu program uses the int set, basicTree<int>
+template <typename Node>
+struct basicArena;
+
+template <typename Node>
+struct basicPath;
+
+template <typename Node>
+struct basicCache;
+
+// value type of a set, which has no value stored with each key
+struct noPayload {
+                 };
+
+template <typename Key, typename Mapped>
+struct basicNode {
+                    typedef Key keyType;
+                    typedef basicArena<basicNode> arenaType;
+                    typedef basicPath<basicNode> pathType;
+                    
+                    Key number;
+                    basicNode *leftPtr;
+                    basicNode *rightPtr;
+                    int height;
+                    int size;
+                    Mapped value;
+                 };
+
+// set nodes are specialized without a value, so an int node is no larger than before
+template <typename Key>
+struct basicNode<Key, noPayload> {
+                                    typedef Key keyType;
+                                    typedef basicArena<basicNode> arenaType;
+                                    typedef basicPath<basicNode> pathType;
+                                    
+                                    Key number;
+                                    basicNode *leftPtr;
+                                    basicNode *rightPtr;
+                                    int height;
+                                    int size;
+                                 };
+
+typedef basicNode<int, noPayload> treeNode;
+
+// slab header, the nodes of the slab follow it in the same block of memory;
+// mapped is set when the block came from the operating system rather than the
+// heap, whether or not it got huge pages
+struct arenaSlab {
+                    arenaSlab *next;
+                    bool mapped;
+                 };
+
+template <typename Node>
+struct basicArena {
+                     arenaSlab *slabs;
+                     Node *freeList;
+                     Node *nextNode;
+                     Node *slabEnd;
+                     bool hugePages;
+                  };
+
+typedef basicArena<treeNode> nodeArena;
+
+typedef int (*blockRankFunction)(const int *block, int num);
+
+// sorted keys in blocks of 16, one cache line each, with 17 children per block
+struct karyIndex {
+                    vector<int> storage;
+                    int *blocks;
+                    int blockCount;
+                    int size;
+                    int largest;
+                    blockRankFunction blockRank;
+                 };
+
+// read only copy of the tree in Eytzinger order, rebuilt after the tree changes
+struct frozenIndex {
+                      vector<int> storage;
+                      int *keys;
+                      vector<treeNode *> nodes;
+                      int size;
+                      bool stale;
+                      int staleLookups;
+                      karyIndex wide;
+                   };
+
+#if defined(BST_STATS)
+// searches and comparisons by kind of search, and a histogram of the time
+// each menu command took where bucket i counts times under 2 to the i ns
+struct treeStats {
+                    unsigned long long searches[STATS_OPERATIONS];
+                    unsigned long long comparisons[STATS_OPERATIONS];
+                    unsigned long long frozenSearches;
+                    unsigned long long latency[MENU_COMMANDS][STATS_LATENCY_BUCKETS];
+                 };
+
+#define STATS_ADD(tree, counter, amount) ((tree)->stats.counter += (amount))
+#define STATS_TIMER(timer) chrono::steady_clock::time_point timer
+#define STATS_START(timer) (timer = chrono::steady_clock::now())
+#define STATS_COMMAND(tree, command, timer) recordLatency(tree, command, timer)
+#else
+#define STATS_ADD(tree, counter, amount)
+#define STATS_TIMER(timer)
+#define STATS_START(timer)
+#define STATS_COMMAND(tree, command, timer)
+#endif
+
+// keys are ordered by Compare, and two keys are equal when neither is less;
+// only the int set builds a frozen index
+template <typename Key, typename Compare = less<Key>, typename Mapped = noPayload>
+struct basicTree {
+                    typedef Key keyType;
+                    typedef basicNode<Key, Mapped> nodeType;
+                    
+                    int count;
+                    nodeType *root;
+                    bool balanced;
+                    basicArena<nodeType> *arena;
+                    frozenIndex *frozen;
+                    basicCache<nodeType> *cache;
+                    Compare compare;
+#if defined(BST_STATS)
+                    treeStats stats;
+#endif
+                 };
+
+typedef basicTree<int> binarySearchTree;
+
+// formatted tree numbers waiting to be written to the output stream. Each
+// front end keeps one for as long as it runs, so the text is allocated once
+struct displayBuffer {
+                        vector<char> text;
+                        size_t used;
+                        ostream *out;
+                     };
+
+// node of the compact store, whose children are indices into the node array
+// instead of pointers, so a node takes 12 bytes rather than 24
+struct compactNode {
+                      int number;
+                      unsigned int leftPtr;
+                      unsigned int rightPtr;
+                   };
+
+// int set kept in one growing array of compact nodes. Index COMPACT_NULL is
+// never given to a node so it can stand for no child, and the indices of
+// deleted nodes are chained through leftPtr to be reused by createNode
+struct compactTree {
+                      compactNode *nodes;
+                      unsigned int used;
+                      unsigned int capacity;
+                      unsigned int root;
+                      unsigned int freeList;
+                      int count;
+                   };
+
+// one node the compact finger passed through and the open range of keys that
+// belong below it; keys are int, so the wider bounds can stand for no bound
+struct compactLevel {
+                       unsigned int node;
+                       long long low;
+                       long long high;
+                    };
+
+// an add, delete or find sent to a shard. The worker sets done when the
+// integer was added, deleted or found and memoryFail when no node could be
+// allocated; a find that succeeds leaves the subtree display in text
+struct shardOperation {
+                         char action;
+                         int number;
+                         bool done;
+                         bool memoryFail;
+                         string text;
+                      };
+
+struct shardWork;
+
+// the operations of a group that fall in one shard's key range, in the order
+// given
+struct shardBatch {
+                     vector<shardOperation *> operations;
+                     shardWork *work;
+                  };
+
+// a group of operations with one batch for each shard; pending counts the
+// batches not yet done, and the worker that finishes the last one wakes the
+// front end through done
+struct shardWork {
+                    vector<shardOperation> operations;
+                    vector<shardBatch> batches;
+                    int pending;
+                    mutex doneLock;
+                    condition_variable done;
+                 };
+
+// one key range of a sharded tree, from low up to the next shard's low, with
+// its own tree and worker thread. The front end is the only producer and the
+// worker the only consumer of the ring of batches: the front end fills the
+// slot at tail and then moves tail, the worker runs the batch at head and then
+// moves head, so neither needs a lock. Each index has its own cache line. A
+// worker that stays idle sets parked and sleeps on wake until a batch comes
+struct treeShard {
+                    binarySearchTree *tree;
+                    int low;
+                    shardBatch *ring[SHARD_QUEUE_SLOTS];
+                    atomic<unsigned int> head;
+                    char headPadding[64 - sizeof(atomic<unsigned int>)];
+                    atomic<unsigned int> tail;
+                    char tailPadding[64 - sizeof(atomic<unsigned int>)];
+                    atomic<bool> parked;
+                    mutex parkLock;
+                    condition_variable wake;
+                    displayBuffer display;
+                    thread worker;
+                 };
+
+// the integers split by key range over shards in ascending order of low,
+// each shard served by its own worker thread
+struct shardedTree {
+                      vector<treeShard *> shards;
+                      atomic<bool> stopping;
+                   };
+
+// a key searched for recently and the node holding it, NULL when the key is
+// not in the tree; the entry is current while its generation is the cache's
+template <typename Node>
+struct cacheEntry {
+                     typename Node::keyType key;
+                     Node *node;
+                     unsigned int generation;
+                  };
 
-struct binarySearchTree {
-                            int count;
-                            treeNode *root;
+// direct mapped cache of recent search results in front of findNode, for
+// lookups that keep asking for the same few keys, with the searches it saw,
+// how many it answered, and the total depth of the walks it did not answer
+template <typename Node>
+struct basicCache {
+                     cacheEntry<Node> *entries;
+                     unsigned int generation;
+                     unsigned long long lookups;
+                     unsigned long long hits;
+                     unsigned long long depth;
+                  };
+
+// links walked from the root, used to rebalance after an insert or delete
+template <typename Node>
+struct basicPath {
+                    Node **link[MAX_TREE_HEIGHT];
+                    int length;
+                 };
+
+typedef basicPath<treeNode> treePath;
+
+// one link of a finger: the nodes bounding the keys below it, NULL when
+// unbounded, and the inserts below it not yet added to the size of its node
+template <typename Node>
+struct fingerLevel {
+                      Node **link;
+                      Node *low;
+                      Node *high;
+                      int pending;
+                   };
+
+// one search of a batch in flight: the key it is for and the node it reached
+template <typename Node>
+struct findCursor {
+                     int query;
+                     Node *node;
+                  };
+
+// the links from the root to the last node a hinted insert reached; a tree that
+// is not balanced can be any height, so at FINGER_MAX_LEVELS the half nearest
+// the root is dropped and above counts the inserts still owed to those nodes
+template <typename Node>
+struct basicFinger {
+                      vector< fingerLevel<Node> > levels;
+                      int above;
+                   };
+
+// a subtree reached by a batch merge and the range of sorted keys that fall in
+// it; stage moves from BATCH_SPLIT to BATCH_LEFT once the keys are split at the
+// node, then to BATCH_JOIN once its new left subtree is done
+template <typename Node>
+struct batchFrame {
+                     Node *node;
+                     int first;
+                     int last;
+                     int split;
+                     bool found;
+                     int stage;
+                     Node *left;
+                  };
+
+// input file mapped into memory and the position of the next integer in it
+struct integerScanner {
+                         const char *data;
+                         const char *current;
+                         const char *end;
+                         size_t size;
+                         bool mapped;
+                      };
+
+// binary snapshot layout: this header, the keys in preorder, then 2 bits per
+// node (SHAPE_LEFT, SHAPE_RIGHT) packed 4 nodes to a byte giving its children
+struct snapshotHeader {
+                         char magic[4];
+                         unsigned int version;
+                         unsigned int flags;
+                         unsigned int reserved;
+                         unsigned long long count;
+                      };
+
+// nodes whose right subtrees are still to be visited by an inorder traversal
+template <typename Node>
+struct basicIterator {
+                        vector<Node *> pending;
+                     };
+
+typedef basicIterator<treeNode> treeIterator;
+
+// output buffer for batch mode, endl no longer forces a write per line
+class batchOutput : public streambuf {
+    public:
+        batchOutput(FILE *destination);
+        ~batchOutput();
+    protected:
+        int overflow(int character);
+        int sync();
+    private:
+        bool writeBuffer();
+        vector<char> buffer;
+        FILE *file;
+};
+
+// epoch a reader thread entered at, 0 while it is not searching; padded so
+// each reader writes to its own cache line
+struct readerSlot {
+                     atomic<unsigned long long> epoch;
+                     atomic<bool> claimed;
+                     char padding[64 - sizeof(atomic<unsigned long long>) - sizeof(atomic<bool>)];
+                  };
+
+struct retiredNode {
+                      treeNode *node;
+                      unsigned long long epoch;
+                   };
+
+// AVL tree whose published nodes are never changed: the single writer copies
+// the path it changes and publishes a new root, so readers need no locks.
+// Nodes are retired in epoch order, oldest at the front of retired
+struct concurrentTree {
+                         atomic<treeNode *> root;
+                         atomic<int> count;
+                         atomic<unsigned long long> epoch;
+                         readerSlot readers[MAX_READERS];
+                         mutex writerLock;
+                         deque<retiredNode> retired;
+                      };
+
+// a version of a concurrent tree that stays readable while the writer goes on,
+// held by a reader slot that keeps the epoch the snapshot was taken at; view
+// presents the version as a read only BST for findNode, countLess, selectNode,
+// countRange, the iterators and inOrderDisplay
+struct treeSnapshot {
+                       binarySearchTree view;
+                       int slot;
+                    };
+
+// nodes copied by the update in progress, which it may change freely
+struct treeUpdate {
+                     vector<treeNode *> copies;
+                     vector<treeNode *> replaced;
+                  };
+
+#if defined(BST_BENCHMARK)
+const size_t BENCHMARK_DEGENERATE_LIMIT = 100000,
+             BENCHMARK_SAMPLES = 1000000,
+             BENCHMARK_BATCH_KEYS = 1024,
+             BENCHMARK_SHARD_SAMPLE = 1024;
+const int BENCHMARK_CLUSTER_SIZE = 1000,
+          BENCHMARK_SHARDS = 4,
+          BENCHMARK_READERS = 3,
+          BENCHMARK_PERCENTILES = 5;
+const double BENCHMARK_ZIPF_THETA = 0.99;
+const int BENCHMARK_RECORD_SHIFT = 32;
+
+struct benchmarkOptions {
+                           vector<size_t> sizes;
+                           vector<string> distributions;
+                           vector<string> structures;
+                           string resultsFile;
+                           unsigned long seed;
                         };
 
+// measurements of one operation; latency holds p50, p90, p99, p99.9 and max
+struct benchmarkResult {
+                          string structure;
+                          string distribution;
+                          string operation;
+                          size_t size;
+                          size_t operations;
+                          size_t found;
+                          double seconds;
+                          long long latency[BENCHMARK_PERCENTILES];
+                          int height;
+                       };
+
+// a map from keys wider than int to text, to time the tree off the int set
+typedef basicTree<long long, less<long long>, string> recordTree;
+
+struct zipfGenerator {
+                        size_t count;
+                        double theta;
+                        double zeta;
+                        double zetaTwo;
+                        double alpha;
+                        double eta;
+                     };
+
+// stream buffer that throws away what is written, for timing display output
+class discardOutput : public streambuf {
+    protected:
+        int overflow(int character);
+        streamsize xsputn(const char *text, streamsize length);
+};
+#endif
+
+struct programOptions {
+                         bool balanced;
+                         bool bulkLoad;
+                         bool arena;
+                         bool hugePages;
+                         bool mappedInput;
+                         int loadThreads;
+                         bool frozenLookups;
+                         bool hotCache;
+                         bool compactNodes;
+                         int shards;
+                         string statsFile;
+                         string restoreFile;
+                         string saveFile;
+                         string batchFile;
+                         string inputFile;
+                         string logFile;
+                      };
+
+// append only log of the adds and deletes made to the main tree. Each change
+// is a LOG_RECORD_BYTES record: LOG_INSERT or LOG_DELETE and the integer.
+// Records collect in pending until the commit thread writes them as one group,
+// a count and checksum followed by the records, and syncs the file. Compaction
+// moves the log aside, starts a new one, and folds the tree into the base
+// snapshot on another thread. While baseCurrent is set the base snapshot and
+// the log hold the whole tree, so the compaction thread can rebuild the keys
+// from them; failed is set by whichever thread a write fails on and reported
+// once by the main thread
+struct mutationLog {
+                      string fileName;
+                      FILE *file;
+                      binarySearchTree *tree;
+                      vector<char> pending;
+                      vector<char> writing;
+                      mutex pendingLock;
+                      mutex fileLock;
+                      condition_variable wake;
+                      thread committer;
+                      thread compactor;
+                      atomic<bool> compacting;
+                      bool stopping;
+                      atomic<bool> failed;
+                      bool reported;
+                      bool baseCurrent;
+                      unsigned long long records;
+                   };
+
+// the trees loaded or computed by name during a session, the tree loaded at
+// startup is named main; new trees are built the way the options select
+struct treeCatalog {
+                      vector<string> names;
+                      vector<binarySearchTree *> trees;
+                      bool balanced;
+                      bool arena;
+                      bool hugePages;
+                      bool frozenLookups;
+                      bool hotCache;
+                      int threads;
+                      mutationLog *log;
+                      displayBuffer display;
+                   };
+
 // function prototypes
-void getFile(ifstream& dataIn);
+bool getFile(ifstream& dataIn, string& fileName, const string& inputFile);
+bool openMappedInput(const string& fileName, integerScanner& scanner);
+bool readInteger(ifstream& dataIn, int& number);
+bool readInteger(integerScanner& scanner, int& number);
+int scanDigits(const char *position, unsigned long long& value);
+void closeInput(ifstream& dataIn);
+void closeInput(integerScanner& scanner);
 bool fileExists(ifstream& dataIn);
 bool isEmptyFile(ifstream& dataIn);
-void getData(ifstream& dataIn, binarySearchTree *&mainTree, bool& memoryFail);
-binarySearchTree *createTree();
-bool isEmptyTree(binarySearchTree *mainTree);
-treeNode *createNode(int num);
-void insertNode(binarySearchTree *&mainTree, treeNode *newNode);
-treeNode *findNode(binarySearchTree *&mainTree, int num, bool& flag);
-char displayMenu(binarySearchTree *&mainTree);
-void actionController(binarySearchTree *&mainTree, char& treeAction);
-void deleteNode(binarySearchTree *&mainTree, int num);
-void deleteFromTree(treeNode *&nodeToRemove);
-int nodeCount(binarySearchTree *mainTree);
-void inOrderDisplay(treeNode *node, int& currentColumn);
-void formatDisplay(int num, int& currentColumn);
-void freeNodes(treeNode *&node);
-void destroyTree(binarySearchTree *&mainTree);
+template <typename InputType>
+void getData(InputType& dataIn, binarySearchTree *&mainTree, bool& memoryFail);
+template <typename InputType>
+void bulkLoad(InputType& dataIn, binarySearchTree *&mainTree, bool& memoryFail);
+template <typename InputType>
+void collectIntegers(InputType& dataIn, vector<int>& values);
+void sortUnique(vector<int>& keys, vector<int>& duplicates);
+void reportDuplicates(const vector<int>& values, const vector<int>& duplicates);
+template <typename Tree>
+void buildBalanced(typename Tree::nodeType *&link, const typename Tree::keyType keys[], int first,
+                   int last, Tree *mainTree, bool& memoryFail);
+void parallelLoad(integerScanner& scanner, binarySearchTree *&mainTree, int threadCount, bool& memoryFail);
+void splitInput(const integerScanner& scanner, int chunkCount, vector<integerScanner>& chunks);
+void parseChunk(integerScanner chunk, vector<int>& values, vector<int>& keys,
+                vector<int>& duplicates, char& complete);
+void mergeRuns(const vector<int>& first, const vector<int>& second, vector<int>& keys,
+               vector<int>& duplicates);
+template <typename Tree>
+void buildParallel(typename Tree::nodeType *&link, const typename Tree::keyType keys[], int first,
+                   int last, Tree *mainTree, int levels, bool& memoryFail);
+template <typename Tree>
+bool loadInputFile(const programOptions& options, Tree *&mainTree, bool& memoryFail);
+binarySearchTree *findTree(const treeCatalog& catalog, const string& name);
+void addTree(treeCatalog& catalog, const string& name, binarySearchTree *newTree);
+binarySearchTree *createNamedTree(const treeCatalog& catalog);
+bool loadNamedTree(const treeCatalog& catalog, const string& fileName, binarySearchTree *newTree,
+                   bool& memoryFail);
+void releaseTree(binarySearchTree *&mainTree);
+void destroyCatalog(treeCatalog& catalog);
+bool loadLogBase(const string& fileName, binarySearchTree *&mainTree, bool& memoryFail);
+mutationLog *openLog(const string& fileName, binarySearchTree *&mainTree, bool fromBase, bool& memoryFail);
+size_t replayLog(const string& fileName, vector< pair<int, char> >& changes);
+void applyChanges(binarySearchTree *&mainTree, vector< pair<int, char> >& changes, bool& memoryFail);
+void appendLog(mutationLog *log, binarySearchTree *mainTree, char operation, int num);
+void runCommitter(mutationLog *log);
+void commitLog(mutationLog *log);
+unsigned int logChecksum(const char *data, size_t size);
+void compactLog(mutationLog *log);
+bool writeLogBase(const vector<int>& keys, bool balanced, const string& fileName);
+void foldLog(mutationLog *log, vector<int> keys, bool balanced, bool replay);
+bool replayBase(const string& fileName, vector<int>& keys);
+void reportLogFailure(mutationLog *log);
+bool replaceFile(const string& source, const string& target);
+bool syncPath(const string& path);
+void closeLog(mutationLog *&log);
+bool saveSnapshot(binarySearchTree *mainTree, const string& fileName);
+bool loadSnapshot(const string& fileName, binarySearchTree *&mainTree, bool& memoryFail);
+bool recalculateNodes(treeNode *root);
+void balanceTree(binarySearchTree *mainTree);
+void compressVine(treeNode *pseudoRoot, int rotations);
+template <typename Tree = binarySearchTree>
+Tree *createTree();
+template <typename Tree>
+bool isEmptyTree(Tree *mainTree);
+template <typename Node = treeNode>
+Node *createNode(const typename Node::keyType& num, typename Node::arenaType *arena = NULL);
+template <typename Node = treeNode>
+basicArena<Node> *createArena(bool hugePages);
+template <typename Node>
+bool growArena(basicArena<Node> *arena);
+arenaSlab *allocateSlab(bool hugePages);
+void releaseSlab(arenaSlab *slab);
+template <typename Node>
+void releaseNode(Node *node, typename Node::arenaType *arena);
+template <typename Node>
+void joinArena(basicArena<Node> *target, basicArena<Node> *&source);
+template <typename Node>
+void destroyArena(basicArena<Node> *&arena);
+template <typename Tree>
+void insertNode(Tree *&mainTree, typename Tree::nodeType *newNode);
+template <typename Tree>
+typename Tree::nodeType *fingerInsert(Tree *mainTree, basicFinger<typename Tree::nodeType>& finger,
+                                      const typename Tree::keyType& num, bool& found, bool& memoryFail);
+template <typename Node>
+void settleLevel(basicFinger<Node>& finger, int index);
+template <typename Node>
+void dropLevels(basicFinger<Node>& finger);
+template <typename Tree>
+void settleAbove(Tree *mainTree, basicFinger<typename Tree::nodeType>& finger);
+template <typename Tree>
+void finishFinger(Tree *mainTree, basicFinger<typename Tree::nodeType>& finger);
+template <typename Node>
+int nodeHeight(Node *node);
+template <typename Node>
+int nodeSize(Node *node);
+template <typename Node>
+void updateNode(Node *node);
+template <typename Node>
+void rotateLeft(Node *&node);
+template <typename Node>
+void rotateRight(Node *&node);
+template <typename Node>
+void rebalanceNode(Node *&node);
+template <typename Node>
+void rebalancePath(basicPath<Node>& path);
+template <typename Key, typename Compare>
+bool sameKey(const Compare& compare, const Key& first, const Key& second);
+template <typename Key>
+bool sameKey(const less<Key>& compare, const Key& first, const Key& second);
+template <typename Key, typename Mapped>
+void copyEntry(basicNode<Key, Mapped> *target, const basicNode<Key, Mapped> *source);
+template <typename Key>
+void copyEntry(basicNode<Key, noPayload> *target, const basicNode<Key, noPayload> *source);
+template <typename Tree>
+typename Tree::nodeType *findNode(Tree *&mainTree, const typename Tree::keyType& num, bool& flag);
+template <typename Tree>
+int findBatch(Tree *mainTree, const typename Tree::keyType queries[], int count,
+              typename Tree::nodeType *results[]);
+template <typename Node>
+basicCache<Node> *createCache();
+template <typename Node>
+cacheEntry<Node> *cacheSlot(basicCache<Node> *cache, const typename Node::keyType& num);
+template <typename Tree>
+bool cachedFind(Tree *mainTree, const typename Tree::keyType& num, typename Tree::nodeType *&node);
+template <typename Node>
+void storeCache(basicCache<Node> *cache, const typename Node::keyType& num, Node *node, int depth);
+template <typename Node>
+void forgetKey(basicCache<Node> *cache, const typename Node::keyType& num);
+template <typename Node>
+void clearCache(basicCache<Node> *cache);
+template <typename Node>
+void destroyCache(basicCache<Node> *&cache);
+template <typename Tree>
+bool indexedFind(Tree *mainTree, const typename Tree::keyType& num, typename Tree::nodeType *&node);
+bool indexedFind(binarySearchTree *mainTree, int num, treeNode *&node);
+bool freezeTree(binarySearchTree *mainTree);
+treeNode *frozenFind(const frozenIndex *frozen, int num);
+void buildKary(karyIndex& wide, const vector<int>& keys);
+void fillKary(karyIndex& wide, int block, const vector<int>& keys, size_t& next);
+blockRankFunction selectBlockRank();
+int scalarBlockRank(const int *block, int num);
+#if defined(KARY_X86)
+int sse2BlockRank(const int *block, int num);
+int avx2BlockRank(const int *block, int num);
+#endif
+bool karyContains(const karyIndex& wide, int num);
+int containsBatch(binarySearchTree *mainTree, const int queries[], int count, char found[]);
+void membershipDisplay(const vector<int>& queries, const vector<char>& found, int& currentColumn,
+                       displayBuffer& buffer, ostream& out);
+template <typename Tree>
+char displayMenu(Tree *&mainTree, const char choices[]);
+void actionController(binarySearchTree *&mainTree, treeCatalog& catalog, char& treeAction,
+                      istream& commandIn = cin, ostream& out = cout, bool interactive = true);
+template <typename Tree>
+void actionController(Tree *&mainTree, displayBuffer& display, char& treeAction, istream& commandIn = cin,
+                      ostream& out = cout, bool interactive = true);
+bool readNumber(const char prompt[], bool adding, istream& commandIn, ostream& out, bool interactive, int& num);
+void reportAdd(ostream& out, int num, char status);
+void reportDelete(ostream& out, int num, bool deleted);
+void reportFind(ostream& out, int num, bool found);
+char addInteger(binarySearchTree *mainTree, int num);
+bool deleteInteger(binarySearchTree *mainTree, int num);
+void displayTree(binarySearchTree *mainTree, displayBuffer& buffer, ostream& out);
+bool displaySubtree(binarySearchTree *mainTree, int num, displayBuffer& buffer, ostream& out);
+void showPrompt(const char prompt[], bool interactive);
+void finishAction(bool interactive);
+template <typename Tree, typename Context>
+char runBatch(Tree *&mainTree, Context& context, const char choices[], istream& commandIn, ostream& out);
+template <typename Tree, typename Context>
+void runCommands(const programOptions& options, Tree *&mainTree, Context& context, const char choices[]);
+template <typename Tree>
+void deleteNode(Tree *&mainTree, const typename Tree::keyType& num);
+template <typename Node>
+void deleteFromTree(Node *&nodeToRemove, typename Node::pathType *path = NULL,
+                    typename Node::arenaType *arena = NULL);
+template <typename Tree>
+int insertBatch(Tree *&mainTree, const typename Tree::keyType keys[], int count, char status[],
+                bool& memoryFail);
+template <typename Tree>
+int deleteBatch(Tree *&mainTree, const typename Tree::keyType keys[], int count, char status[]);
+template <typename Tree>
+void sortBatch(Tree *mainTree, const typename Tree::keyType keys[], int count, char status[],
+               char keptStatus, char repeatStatus, vector<typename Tree::keyType>& sortedKeys,
+               vector<int>& positions);
+template <typename Tree>
+void mergeBatch(Tree *mainTree, const vector<typename Tree::keyType>& sortedKeys,
+                const vector<int>& positions, char status[], bool deleting, bool& memoryFail);
+template <typename Tree>
+typename Tree::nodeType *joinTrees(Tree *mainTree, typename Tree::nodeType *left,
+                                   typename Tree::nodeType *middle, typename Tree::nodeType *right);
+template <typename Tree>
+typename Tree::nodeType *removeLargest(Tree *mainTree, typename Tree::nodeType *&subtree);
+template <typename Tree>
+int nodeCount(Tree *mainTree);
+void inOrderDisplay(treeNode *node, int& currentColumn, displayBuffer& buffer, ostream& out);
+template <typename Node>
+void startIterator(basicIterator<Node>& iterator, Node *node);
+template <typename Node>
+Node *nextNode(basicIterator<Node>& iterator);
+template <typename Tree>
+void seekIterator(basicIterator<typename Tree::nodeType>& iterator, Tree *mainTree,
+                  const typename Tree::keyType& low);
+template <typename Tree>
+int countLess(Tree *mainTree, const typename Tree::keyType& num, bool inclusive);
+template <typename Tree>
+typename Tree::nodeType *selectNode(Tree *mainTree, int position);
+template <typename Tree>
+int countRange(Tree *mainTree, const typename Tree::keyType& low, const typename Tree::keyType& high);
+void rangeDisplay(binarySearchTree *mainTree, int low, int high, int& currentColumn, displayBuffer& buffer,
+                  ostream& out);
+template <typename Tree>
+void combineTrees(Tree *first, Tree *second, char operation, Tree *result, bool& memoryFail);
+template <typename Tree>
+void combineParallel(Tree *first, Tree *second, char operation, Tree *result, int threadCount,
+                     bool& memoryFail);
+template <typename Tree>
+void mergeKeys(Tree *first, Tree *second, char operation, const typename Tree::keyType *low,
+               const typename Tree::keyType *high, vector<typename Tree::keyType>& keys);
+template <typename Tree>
+typename Tree::nodeType *nextBefore(basicIterator<typename Tree::nodeType>& iterator, Tree *mainTree,
+                                    const typename Tree::keyType *high);
+void formatDisplay(int num, int& currentColumn, displayBuffer& buffer);
+void startDisplay(displayBuffer& buffer, ostream& out);
+void flushDisplay(displayBuffer& buffer);
+int depthHistogram(treeNode *node, vector<int>& counts);
+void displayStats(binarySearchTree *mainTree, ostream& out);
+void writeStatsJson(binarySearchTree *mainTree, ostream& out);
+#if defined(BST_STATS)
+void recordLatency(binarySearchTree *mainTree, char command, chrono::steady_clock::time_point start);
+unsigned long long latencyPercentile(const unsigned long long buckets[], unsigned long long total,
+                                     double fraction);
+#endif
+template <typename Node>
+void freeNodes(Node *&node);
+template <typename Tree>
+void destroyTree(Tree *&mainTree);
+bool getOptions(int argc, char *argv[], programOptions& options);
+bool allowOption(const char mode[], const char option[], bool given);
+concurrentTree *createConcurrentTree(binarySearchTree *source, bool& memoryFail);
+int registerReader(concurrentTree *sharedTree);
+void unregisterReader(concurrentTree *sharedTree, int slot);
+bool concurrentFind(concurrentTree *sharedTree, int slot, int num);
+bool concurrentInsert(concurrentTree *sharedTree, int num, bool& memoryFail);
+bool concurrentDelete(concurrentTree *sharedTree, int num, bool& memoryFail);
+bool ownNode(treeUpdate& update, treeNode *&link);
+bool rebalanceCopy(treeUpdate& update, treeNode *&node);
+void publishRoot(concurrentTree *sharedTree, treeUpdate& update, treeNode *newRoot);
+void reclaimNodes(concurrentTree *sharedTree);
+bool openSnapshot(concurrentTree *sharedTree, treeSnapshot& snapshot);
+void closeSnapshot(concurrentTree *sharedTree, treeSnapshot& snapshot);
+int snapshotDisplay(concurrentTree *sharedTree, int& currentColumn, displayBuffer& buffer, ostream& out);
+void destroyConcurrentTree(concurrentTree *&sharedTree);
+void runMainTree(const programOptions& options);
+void runCompact(const programOptions& options);
+void parallelLoad(integerScanner& scanner, compactTree *&mainTree, int threadCount, bool& memoryFail);
+template <typename InputType>
+void getData(InputType& dataIn, compactTree *&mainTree, bool& memoryFail);
+template <typename InputType>
+void bulkLoad(InputType& dataIn, compactTree *&mainTree, bool& memoryFail);
+unsigned int buildCompact(compactTree *mainTree, const int keys[], int first, int last, bool& memoryFail);
+unsigned int fingerInsert(compactTree *mainTree, vector<compactLevel>& finger, int num, bool& found,
+                          bool& memoryFail);
+compactTree *createCompactTree();
+bool isEmptyTree(compactTree *mainTree);
+unsigned int createNode(compactTree *mainTree, int num);
+void releaseNode(compactTree *mainTree, unsigned int node);
+void insertNode(compactTree *mainTree, unsigned int newNode);
+unsigned int findNode(compactTree *mainTree, int num, bool& flag);
+void deleteNode(compactTree *mainTree, int num);
+void deleteFromTree(compactTree *mainTree, unsigned int& nodeToRemove);
+void inOrderDisplay(compactTree *mainTree, unsigned int node, int& currentColumn, displayBuffer& buffer,
+                    ostream& out);
+char addInteger(compactTree *mainTree, int num);
+bool deleteInteger(compactTree *mainTree, int num);
+void displayTree(compactTree *mainTree, displayBuffer& buffer, ostream& out);
+bool displaySubtree(compactTree *mainTree, int num, displayBuffer& buffer, ostream& out);
+void destroyTree(compactTree *&mainTree);
+void runSharded(const programOptions& options);
+shardedTree *createShardedTree(binarySearchTree *source, int shardCount, const treeCatalog& catalog,
+                               bool& memoryFail);
+void splitTree(treeNode *&root, int low, treeNode *&upper);
+int findShard(shardedTree *shardTree, int num);
+void runShard(shardedTree *shardTree, treeShard *shard);
+void runOperation(binarySearchTree *mainTree, displayBuffer& display, shardOperation& operation);
+char readOperations(istream& commandIn, shardWork& work);
+void submitOperations(shardedTree *shardTree, shardWork& work);
+void waitOperations(shardWork& work);
+bool finishOperations(shardWork& work, ostream& out);
+void sendOperation(shardedTree *shardTree, shardWork& work, char action, int num);
+bool isEmptyTree(shardedTree *shardTree);
+int nodeCount(shardedTree *shardTree);
+void inOrderDisplay(shardedTree *shardTree, int& currentColumn, displayBuffer& buffer, ostream& out);
+char addInteger(shardedTree *shardTree, int num);
+bool deleteInteger(shardedTree *shardTree, int num);
+void displayTree(shardedTree *shardTree, displayBuffer& buffer, ostream& out);
+bool displaySubtree(shardedTree *shardTree, int num, displayBuffer& buffer, ostream& out);
+char runBatch(shardedTree *&shardTree, displayBuffer& display, const char choices[], istream& commandIn,
+              ostream& out);
+void destroyTree(shardedTree *&shardTree);
+#if defined(BST_BENCHMARK)
+int runBenchmarks(int argc, char *argv[]);
+void getBenchmarkOptions(int argc, char *argv[], benchmarkOptions& options);
+void splitList(const string& list, vector<string>& items);
+void generateWorkload(const string& distribution, size_t size, unsigned long seed,
+                      vector<int>& keys, vector<int>& queries);
+void createZipf(zipfGenerator& zipf, size_t count);
+size_t nextZipf(const zipfGenerator& zipf, mt19937& random);
+int scatterRank(size_t rank);
+void isolateBenchmark(const string& structure, const string& distribution, const vector<int>& keys,
+                      const vector<int>& queries, ofstream& results);
+void benchmarkStructure(const string& structure, const string& distribution, const vector<int>& keys,
+                        const vector<int>& queries, ostream& results);
+void benchmarkTree(const string& structure, const string& distribution, const vector<int>& keys,
+                   const vector<int>& queries, ostream& results);
+void benchmarkSet(const string& distribution, const vector<int>& keys, const vector<int>& queries,
+                  ostream& results);
+void benchmarkShards(const string& distribution, const vector<int>& keys, const vector<int>& queries,
+                     ostream& results);
+size_t runGroup(shardedTree *shardTree, shardWork& work, char action, const vector<int>& numbers,
+                size_t first);
+void benchmarkConcurrent(const string& distribution, const vector<int>& keys, const vector<int>& queries,
+                         ostream& results);
+void benchmarkSnapshot(const string& distribution, const vector<int>& keys, ostream& results);
+void benchmarkFinger(const string& distribution, const vector<int>& keys, ostream& results);
+void benchmarkRecords(const string& distribution, const vector<int>& keys, const vector<int>& queries,
+                      ostream& results);
+template <typename Operation>
+void timeOperations(size_t count, benchmarkResult& result, Operation operation, size_t batch = 1);
+void reportResult(const benchmarkResult& result, ostream& results);
+int treeDepth(treeNode *node);
+long peakMemory();
+#endif
+
+#if defined(BST_BENCHMARK)
+//------------------------------------------------------------------------------
+// FUNCTION:     main
+// DESCRIPTION:  Runs the benchmarks in place of the menu program.
+// INPUT:
+//     Parameters:  argc - Number of command line arguments.
+//                  argv - The command line arguments.
+// OUTPUT:
+//     Return Val:  Returns 0 when the results were written.
+// CALLS TO:     runBenchmarks
+//------------------------------------------------------------------------------
 
+int main(int argc, char *argv[])
+{
+    return runBenchmarks(argc, argv);
+}
+#else
 //------------------------------------------------------------------------------
 // FUNCTION:     main
 // DESCRIPTION:  Declares some of the main variable used in the program and makes
 //               key function calls to control the flow of the program.
-// INPUT:        N/A
+// INPUT:
+//     Parameters:  argc - Number of command line arguments.
+//                  argv - The command line arguments.
 // OUTPUT:
-//     Return Val:  Returns 0 upon successful execution of the program.
+//     Return Val:  Returns 0 upon successful execution of the program, 1 when
+//                  the options cannot be used together.
+// CALLS TO:     getOptions
+//               runCompact
+//               runSharded
+//               runMainTree
+//------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    programOptions options;
+    int status = 0;
+    
+    if (!getOptions(argc, argv, options))
+    {
+        status = 1;
+    }
+    else if (options.compactNodes)
+    {
+        runCompact(options);
+    } // end if integers are kept in the compact node store
+    else if (options.shards > 0)
+    {
+        runSharded(options);
+    } // end if the tree is split over shards
+    else
+    {
+        runMainTree(options);
+    }
+
+    return status;
+}
+#endif
+
+//------------------------------------------------------------------------------
+// FUNCTION:     runMainTree
+// DESCRIPTION:  Runs the program on the BST. The tree is loaded from the log,
+//               a snapshot or the input file, the commands are taken from the
+//               menu or the batch file, and the main tree is saved on exit
+//               the way the options select, even when U left another named
+//               tree in use.
+// INPUT:
+//     Parameters:  options - The command line options.
+// OUTPUT:       N/A
 // CALLS TO:     createTree
-//               getFile
-//               isEmptyfile
-//               getData
-//               displayMenu
-//               actionController
-//               freeNodes
-//               destroyTree
+//               addTree
+//               createArena
+//               createCache
+//               loadLogBase
+//               loadSnapshot
+//               loadInputFile
+//               openLog
+//               freezeTree
+//               runCommands
+//               findTree
+//               saveSnapshot
+//               writeStatsJson
+//               closeLog
+//               destroyCatalog
 //------------------------------------------------------------------------------
 
-int main()
+void runMainTree(const programOptions& options)
 {
     binarySearchTree *mainTree;
-    ifstream dataIn;
-    char treeAction;
-    bool memoryFail = false;
+    treeCatalog catalog;
+    bool memoryFail = false,
+         fromBase = false,
+         opened = true;
+    
+    // trees loaded by name later on are set up the same way as the main tree
+    catalog.balanced = options.balanced;
+    catalog.arena = options.arena;
+    catalog.hugePages = options.hugePages;
+    catalog.frozenLookups = options.frozenLookups;
+    catalog.hotCache = options.hotCache;
+    catalog.threads = options.loadThreads;
+    catalog.log = NULL;
     
     // create an empty binary search tree
     mainTree = createTree();
     
     if (mainTree)
     {
-        // Prompt user for a file name & loop until the name of the file exists
-        getFile(dataIn);
+        addTree(catalog, MAIN_TREE_NAME, mainTree);
+        mainTree->balanced = options.balanced;
+        
+        if (options.arena)
+        {
+            mainTree->arena = createArena(options.hugePages);
+            memoryFail = (mainTree->arena == NULL);
+        } // end if nodes come from a node arena
         
-        // Read data if file is not empty
-        if (!isEmptyFile(dataIn))
+        if (options.hotCache && !memoryFail)
+        {
+            mainTree->cache = createCache<treeNode>();
+            memoryFail = (mainTree->cache == NULL);
+        } // end if searches go through a hot key cache
+    } // end if memory correctly allocated for mainTree
+    
+    if (mainTree && !memoryFail)
+    {
+        // Start from the snapshot the mutation log was compacted into, or restore
+        // the snapshot if one is given, otherwise read the input file
+        if (!options.logFile.empty())
+        {
+            fromBase = loadLogBase(options.logFile, mainTree, memoryFail);
+        }
+        if (!fromBase
+            && (options.restoreFile.empty() || !loadSnapshot(options.restoreFile, mainTree, memoryFail)))
         {
-            getData(dataIn, mainTree, memoryFail);
+            opened = loadInputFile(options, mainTree, memoryFail);
         }
+        
+        // replay the changes made since then and log the changes to come
+        if (!options.logFile.empty() && !memoryFail && opened)
+        {
+            catalog.log = openLog(options.logFile, mainTree, fromBase, memoryFail);
+            if ((catalog.log == NULL) && !memoryFail)
+            {
+                cout << "ERROR - Mutation log " << options.logFile << " could not be opened." << endl;
+            }
+        } // end if adds and deletes are logged
+        
+        if (options.frozenLookups && !memoryFail && opened)
+        {
+            memoryFail = !freezeTree(mainTree);
+        } // end if lookups use the frozen index
     } // end if memory correctly allocated for mainTree
     
-    if (!memoryFail)
+    if (!memoryFail && opened)
     {
-        treeAction = displayMenu(mainTree);
+        runCommands(options, mainTree, catalog, MENU_CHOICES);
+        
+        // U may have left another named tree in use, but -save and -stats
+        // are for the main tree
+        mainTree = findTree(catalog, MAIN_TREE_NAME);
         
-        // loop through menu and user selection until exit is selected
-        while (treeAction != 'E')
+        if (!options.saveFile.empty())
         {
-              actionController(mainTree, treeAction);
-              if (treeAction != 'E')
-              {
-                  treeAction = displayMenu(mainTree);
-              }// end if treeAction defults to 'E' because of memory allocation failure
-        } // end while user doesn't exit program
+            if (!saveSnapshot(mainTree, options.saveFile))
+            {
+                cout << "ERROR - Snapshot could not be written to " << options.saveFile << "." << endl;
+            }
+        } // end if tree is saved for the next run
+        
+        if (!options.statsFile.empty())
+        {
+            ofstream statsOut(options.statsFile.c_str());
+            writeStatsJson(mainTree, statsOut);
+            if (!statsOut)
+            {
+                cout << "ERROR - Statistics could not be written to " << options.statsFile << "." << endl;
+            }
+        } // end if statistics are exported
         
         // deallocate all nodes from tree
     } // end if memory allocations were successful
-    else
+    else if (memoryFail)
     {
         cout << "ERROR - A memory allocation failure has occurred." << endl;
         system("pause");
     } // end if memory allocation failed
     
-    // deallocate nodes in tree structure
-    freeNodes(mainTree->root);
-    
-    // deallocate main tree structure
-    destroyTree(mainTree);
+    // commit the last logged changes, then deallocate the main tree and every other named tree
+    closeLog(catalog.log);
+    destroyCatalog(catalog);
 
-    return 0;
+    return;
 }
 
 //------------------------------------------------------------------------------
-// FUNCTION:     getFile
-// DESCRIPTION:  Prompts the user for an input file and opens it for testing by
-//               fileExists function.
+// FUNCTION:     loadInputFile
+// DESCRIPTION:  Prompts the user for an input file, or opens the one given with
+//               -input, and reads its integers into the BST or the compact node
+//               store the way the options select.
 // INPUT:
-//     Parameters:  dataIn - Reading input stream variable.
+//     Parameters:  options - The command line options.
+//                  mainTree - A pointer to the tree.
+//                  memoryFail - Boolean value of memory allocation success/fail.
 // OUTPUT:
-//     Parameters:  dataIn - Same as input, passed by reference.
-// CALLS TO:     fileExists
+//     Parameters:  mainTree - Same as input, passed by reference.
+//                  memoryFail - Same as input, passed by reference.
+//     Return Val:  opened - Boolean value of whether an input file was opened.
+// CALLS TO:     getFile
+//               isEmptyfile
+//               openMappedInput
+//               closeInput
+//               parallelLoad
+//               getData
+//               bulkLoad
 //------------------------------------------------------------------------------
 
-
-void getFile(ifstream& dataIn)
+template <typename Tree>
+bool loadInputFile(const programOptions& options, Tree *&mainTree, bool& memoryFail)
 {
+     ifstream dataIn;
+     integerScanner scanner;
      string fileName;
+     bool opened;
      
-     do
+     // Prompt user for a file name & loop until the name of the file exists
+     opened = getFile(dataIn, fileName, options.inputFile);
+     
+     // Read data if file is not empty
+     if (opened && !isEmptyFile(dataIn))
      {
-         if (!fileExists(dataIn))
+         if ((options.loadThreads > 1) && openMappedInput(fileName, scanner))
+         {
+             closeInput(dataIn);
+             parallelLoad(scanner, mainTree, options.loadThreads, memoryFail);
+         } // end if file is read and built on several threads
+         else if (options.mappedInput && openMappedInput(fileName, scanner))
+         {
+             closeInput(dataIn);
+             
+             if (options.bulkLoad)
+             {
+                 bulkLoad(scanner, mainTree, memoryFail);
+             } // end if tree is built from the sorted file contents
+             else
+             {
+                 getData(scanner, mainTree, memoryFail);
+             }
+         } // end if file is parsed straight from memory
+         else if (options.bulkLoad)
+         {
+             bulkLoad(dataIn, mainTree, memoryFail);
+         } // end if tree is built from the sorted file contents
+         else
          {
-             cout << "File does not exist, enter  a file that does exist." << endl;
-             dataIn.clear();
+             getData(dataIn, mainTree, memoryFail);
          }
-         cout << "Enter a file name for integer data: ";
-         cin >> fileName;
-         
-         dataIn.open (fileName.c_str());
-     } while (!fileExists(dataIn));
+     }
      
-     return;
+     return opened;
 }
 
 //------------------------------------------------------------------------------
-// FUNCTION:     fileExists
-// DESCRIPTION:  Tests that a file exists.
+// FUNCTION:     findTree
+// DESCRIPTION:  Looks up a tree by the name it was loaded or computed under.
 // INPUT:
-//     Parameters:  dataIn - Reading input stream variable.
+//     Parameters:  catalog - The named trees.
+//                  name - The name of the tree.
 // OUTPUT:
-//     Parameters:  dataIn - Same as input, passed by reference.
-//     Return Val:  exists - Boolean value of whether or not the file exists.
+//     Return Val:  namedTree - A pointer to the tree, NULL if no tree has the name.
 // CALLS TO:     N/A
 //------------------------------------------------------------------------------
 
-
-bool fileExists(ifstream& dataIn)
+binarySearchTree *findTree(const treeCatalog& catalog, const string& name)
 {
-     bool exists;
+     binarySearchTree *namedTree = NULL;
+     size_t index;
      
-     if (dataIn)
-     {
-         exists = true;
-     }
-     else
+     for (index = 0; (index < catalog.names.size()) && (namedTree == NULL); index++)
      {
-         exists = false;
+         if (catalog.names[index] == name)
+         {
+             namedTree = catalog.trees[index];
+         }
      }
      
-     return exists;
+     return namedTree;
 }
 
 //------------------------------------------------------------------------------
-// FUNCTION:     isEmptyFile
-// DESCRIPTION:  Tests if there is any data in the input file.
+// FUNCTION:     addTree
+// DESCRIPTION:  Adds a tree to the named trees, which then owns it.
 // INPUT:
-//     Parameters:  dataIn - Reading input stream variable.
+//     Parameters:  catalog - The named trees.
+//                  name - The name of the tree, not already in use.
+//                  newTree - A pointer to the tree.
 // OUTPUT:
-//     Parameters:  dataIn - Same as input, passed by reference.
-//     Return Val:  empty - Boolean value of whether or not the file contains data.
+//     Parameters:  catalog - Same as input, passed by reference.
 // CALLS TO:     N/A
 //------------------------------------------------------------------------------
 
-
-bool isEmptyFile(ifstream& dataIn)
+void addTree(treeCatalog& catalog, const string& name, binarySearchTree *newTree)
 {
-     bool empty;
-
-     if (dataIn.peek() != EOF)
-     {
-         empty = false;
-     }
-     else
-     {
-         empty = true;
-     }
+     catalog.names.push_back(name);
+     catalog.trees.push_back(newTree);
      
-     return empty;
+     return;
 }
 
 //------------------------------------------------------------------------------
-// FUNCTION:     getData
-// DESCRIPTION:  Reads data from the input file into a BST.
+// FUNCTION:     createNamedTree
+// DESCRIPTION:  Creates an empty tree that is balanced, takes its nodes from an
+//               arena and has a hot key cache the same way the main tree does.
 // INPUT:
-//     Parameters:  dataIn - Reading input stream variable.
-//                  mainTree - A pointer to the BST structure.
-//                  memoryFail - Boolean value of memory allocation success/fail.
+//     Parameters:  catalog - The named trees.
 // OUTPUT:
-//     Parameters:  dataIn - Same as input, passed by reference.
-//                  mainTree - Same as input, passed by reference.
-//                  memoryFail - Same as input, passed by reference.
-// CALLS TO:     findNode
-//               createNode
-//               insertNode
+//     Return Val:  newTree - A pointer to the tree, NULL if memory allocation failed.
+// CALLS TO:     createTree
+//               createArena
+//               createCache
+//               destroyTree
+//               releaseTree
 //------------------------------------------------------------------------------
 
-void getData(ifstream& dataIn, binarySearchTree *&mainTree, bool& memoryFail)
+binarySearchTree *createNamedTree(const treeCatalog& catalog)
 {
-     int number;
-     bool flag;
-     treeNode *newNode;
-
-     dataIn >> number;
+     binarySearchTree *newTree;
      
-     while (dataIn && !memoryFail)
+     newTree = createTree();
+     
+     if (newTree)
      {
-         findNode(mainTree, number, flag);
+         newTree->balanced = catalog.balanced;
          
-         if (!flag)
+         if (catalog.arena)
          {
-             newNode = createNode(number);
-             
-             if (newNode)
-             {
-                 insertNode(mainTree, newNode);
-             } // end if memory allocated for new node
-             else
+             newTree->arena = createArena(catalog.hugePages);
+             if (newTree->arena == NULL)
              {
-                 memoryFail = true;
-             } // end memory not allocated
-         } // end if number doesn't already exist in the tree
-         else
-         {
-             cout << endl << number << " already exists in tree and will be ignored." << endl;
-         }
+                 destroyTree(newTree);
+                 newTree = NULL;
+             }
+         } // end if nodes come from a node arena
          
-         dataIn >> number;
-     } // read data from input file until last number
-     
-     dataIn.close();
+         if (catalog.hotCache && (newTree != NULL))
+         {
+             newTree->cache = createCache<treeNode>();
+             if (newTree->cache == NULL)
+             {
+                 releaseTree(newTree);
+             }
+         } // end if searches go through a hot key cache
+     } // end if memory correctly allocated for newTree
      
-     return;
+     return newTree;
 }
 
 //------------------------------------------------------------------------------
-// FUNCTION:     createTree
-// DESCRIPTION:  Allocated memory for the main BST structure and initializes its
-//               variables.
-// INPUT:        N/A
+// FUNCTION:     loadNamedTree
+// DESCRIPTION:  Builds a tree from an input file with the bulk or parallel
+//               load, so every named tree starts height optimal. Repeated
+//               values get the usual notices.
+// INPUT:
+//     Parameters:  catalog - The named trees.
+//                  fileName - The name of the input file.
+//                  newTree - A pointer to an empty tree.
+//                  memoryFail - Boolean value of memory allocation success/fail.
 // OUTPUT:
-//     Return Val:  newTree - A pointer to main BST structure.
-// CALLS TO:     N/A
+//     Parameters:  memoryFail - Same as input, passed by reference.
+//     Return Val:  opened - Boolean value of whether the file could be read.
+// CALLS TO:     openMappedInput
+//               closeInput
+//               parallelLoad
+//               bulkLoad
 //------------------------------------------------------------------------------
 
-
-binarySearchTree *createTree()
+bool loadNamedTree(const treeCatalog& catalog, const string& fileName, binarySearchTree *newTree,
+                   bool& memoryFail)
 {
-    binarySearchTree *newTree;
-    
-    newTree = new (nothrow) binarySearchTree;
-    
-    if (newTree)
-    {
-        newTree->count = 0;
-        newTree->root = NULL;
-    }
-    
-    return newTree;
+     integerScanner scanner;
+     bool opened;
+     
+     opened = openMappedInput(fileName, scanner);
+     
+     if (opened && (scanner.size == 0))
+     {
+         closeInput(scanner);
+     } // end if file is empty
+     else if (opened && (catalog.threads > 1))
+     {
+         parallelLoad(scanner, newTree, catalog.threads, memoryFail);
+     } // end if file is read and built on several threads
+     else if (opened)
+     {
+         bulkLoad(scanner, newTree, memoryFail);
+     }
+     
+     return opened;
 }
 
 //------------------------------------------------------------------------------
-// FUNCTION:     isEmptyTree
-// DESCRIPTION:  Tests the root pointer of BST structure to see if its NULL.
+// FUNCTION:     releaseTree
+// DESCRIPTION:  Deallocates the nodes of a tree, all at once when they share an
+//               arena, and then the tree structure.
 // INPUT:
 //     Parameters:  mainTree - A pointer to the BST structure.
 // OUTPUT:
-//     Return Val:  empty - Boolean value of whether the tree is empty or not
-// CALLS TO:     N/A
+//     Parameters:  mainTree - Set to NULL, passed by reference.
+// CALLS TO:     destroyArena
+//               freeNodes
+//               destroyTree
 //------------------------------------------------------------------------------
 
-
-bool isEmptyTree(binarySearchTree *mainTree)
+void releaseTree(binarySearchTree *&mainTree)
 {
-     bool empty;
-     
-     if (mainTree->root == NULL)
+     if (mainTree->arena != NULL)
      {
-         empty = true;
+         destroyArena(mainTree->arena);
+         mainTree->root = NULL;
      }
      else
      {
-         empty = false;
+         freeNodes(mainTree->root);
      }
      
-     return empty;
+     destroyTree(mainTree);
+     mainTree = NULL;
+     
+     return;
 }
 
 //------------------------------------------------------------------------------
-// FUNCTION:     createNode
-// DESCRIPTION:  Allocates memory for a node within the BST and initializes the
-//               variables in the nodes structure.
+// FUNCTION:     destroyCatalog
+// DESCRIPTION:  Deallocates every named tree, including the main tree.
 // INPUT:
-//     Paramaters:  num - An integer that will be in the node.
+//     Parameters:  catalog - The named trees.
 // OUTPUT:
-//     Return Val:  newNode - A pointer to the newly created node.
-// CALLS TO:     N/A
+//     Parameters:  catalog - Left with no trees, passed by reference.
+// CALLS TO:     releaseTree
 //------------------------------------------------------------------------------
 
-treeNode *createNode(int num)
+void destroyCatalog(treeCatalog& catalog)
 {
-   treeNode *newNode;
-   
-   newNode = new (nothrow) treeNode;
-   
-   if (newNode)
-   {
-       newNode->number = num;
-       newNode->leftPtr = NULL;
-       newNode->rightPtr = NULL;
-   }
-   
-   return newNode;      
+     size_t index;
+     
+     for (index = 0; index < catalog.trees.size(); index++)
+     {
+         releaseTree(catalog.trees[index]);
+     }
+     
+     catalog.names.clear();
+     catalog.trees.clear();
+     
+     return;
 }
 
 //------------------------------------------------------------------------------
-// FUNCTION:     insertNode
-// DESCRIPTION:  Adds a node into the BST in ascending order.
+// FUNCTION:     loadLogBase
+// DESCRIPTION:  Loads the snapshot the mutation log was last compacted into,
+//               which takes the place of the input file when there is one.
 // INPUT:
-//     Parameters:  mainTree - A pointer to the main BST structure.
-//                  newNode - A pointer to the new node being inserted.
+//     Parameters:  fileName - The name of the mutation log.
+//                  mainTree - A pointer to the empty BST structure.
+//                  memoryFail - Boolean value of memory allocation success/fail.
 // OUTPUT:
 //     Parameters:  mainTree - Same as input, passed by reference.
-// CALLS TO:     isEmptyTree     
+//                  memoryFail - Same as input, passed by reference.
+//     Return Val:  loaded - Boolean value of whether the base snapshot was loaded.
+// CALLS TO:     loadSnapshot
 //------------------------------------------------------------------------------
 
-void insertNode(binarySearchTree *&mainTree, treeNode *newNode)
+bool loadLogBase(const string& fileName, binarySearchTree *&mainTree, bool& memoryFail)
 {
-     treeNode *current,
-              *trailCurrent;
-     bool flag;
+     ifstream baseIn((fileName + LOG_BASE_SUFFIX).c_str(), ios::binary);
+     bool loaded = false;
      
-     // make new node the root if the tree is empty
-     if (isEmptyTree(mainTree))
+     if (baseIn)
      {
-         mainTree->count++;
-         mainTree->root = newNode;
-     } // end if tree is empty
-     else
+         baseIn.close();
+         loaded = loadSnapshot(fileName + LOG_BASE_SUFFIX, mainTree, memoryFail);
+     }
+     
+     return loaded;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     openLog
+// DESCRIPTION:  Replays the changes in the mutation log, and in a log a
+//               compaction moved aside but did not finish with, then opens the
+//               log for new changes and starts its commit thread. A torn group
+//               left at the end by a crash is cut off.
+// INPUT:
+//     Parameters:  fileName - The name of the mutation log.
+//                  mainTree - A pointer to the loaded BST structure.
+//                  fromBase - Boolean value of whether the tree was loaded from
+//                             the base snapshot of the log.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+//                  memoryFail - Same as input, passed by reference.
+//     Return Val:  log - A pointer to the open log, NULL if it could not be opened.
+// CALLS TO:     replayLog
+//               applyChanges
+//               startIterator
+//               nextNode
+//               foldLog
+//               runCommitter
+//------------------------------------------------------------------------------
+
+mutationLog *openLog(const string& fileName, binarySearchTree *&mainTree, bool fromBase, bool& memoryFail)
+{
+     mutationLog *log = NULL;
+     ifstream oldIn((fileName + LOG_OLD_SUFFIX).c_str(), ios::binary);
+     vector< pair<int, char> > changes;
+     vector<int> keys;
+     treeIterator iterator;
+     treeNode *node;
+     size_t validBytes,
+            replayed,
+            moved;
+     bool interrupted = !!oldIn;
+     
+     oldIn.close();
+     
+     // changes moved aside by an unfinished compaction come before the current log
+     replayLog(fileName + LOG_OLD_SUFFIX, changes);
+     moved = changes.size();
+     validBytes = replayLog(fileName, changes);
+     replayed = changes.size();
+     applyChanges(mainTree, changes, memoryFail);
+     
+     if (replayed > 0)
      {
-         mainTree->count++;
-         current = mainTree->root;
-         while (current != NULL)
+         cout << replayed << " logged changes replayed from " << fileName << "." << endl;
+     }
+     
+     if (!memoryFail)
+     {
+         log = new (nothrow) mutationLog;
+         memoryFail = (log == NULL);
+     }
+     
+     if (log)
+     {
+         log->fileName = fileName;
+         log->tree = mainTree;
+         log->compacting = false;
+         log->stopping = false;
+         log->failed = false;
+         log->reported = false;
+         log->baseCurrent = fromBase;
+         log->records = replayed - moved;
+         
+         log->file = fopen(fileName.c_str(), "r+b");
+         if (log->file == NULL)
          {
-               trailCurrent = current;
-               if (current->number > newNode->number)
-               {
-                   current = current->leftPtr;
-               } // end if new number is less than current node number
-               else
+             log->file = fopen(fileName.c_str(), "w+b");
+         }
+         
+         if (log->file != NULL)
+         {
+#if defined(_WIN32)
+             log->failed = (_chsize_s(_fileno(log->file), validBytes) != 0);
+#elif defined(__unix__) || defined(__APPLE__)
+             log->failed = (ftruncate(fileno(log->file), validBytes) != 0);
+#endif
+             fseek(log->file, 0, SEEK_END);
+             
+             if (interrupted)
+             {
+                 startIterator(iterator, mainTree->root);
+                 while ((node = nextNode(iterator)) != NULL)
+                 {
+                       keys.push_back(node->number);
+                 }
+                 log->compacting = true;
+                 foldLog(log, keys, mainTree->balanced, false);
+             } // end if the last compaction has to be finished
+             
+             log->committer = thread(runCommitter, log);
+         } // end if log file is open
+         else
+         {
+             delete log;
+             log = NULL;
+         }
+     } // end if memory allocated for the log
+     
+     return log;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     replayLog
+// DESCRIPTION:  Reads the changes in a mutation log file in the order they were
+//               made. Reading stops at the first group that is cut short or does
+//               not match its checksum.
+// INPUT:
+//     Parameters:  fileName - The name of the log file.
+// OUTPUT:
+//     Parameters:  changes - The integer and LOG_INSERT or LOG_DELETE of each
+//                            change, appended.
+//     Return Val:  position - The number of bytes of whole groups in the file.
+// CALLS TO:     openMappedInput
+//               logChecksum
+//               closeInput
+//------------------------------------------------------------------------------
+
+size_t replayLog(const string& fileName, vector< pair<int, char> >& changes)
+{
+     integerScanner logData;
+     unsigned int header[2];
+     size_t position = 0,
+            groupBytes,
+            index;
+     int number;
+     bool valid = true;
+     
+     if (openMappedInput(fileName, logData))
+     {
+         while (valid && (position + sizeof(header) <= logData.size))
+         {
+               memcpy(header, logData.data + position, sizeof(header));
+               groupBytes = header[0] * LOG_RECORD_BYTES;
+               valid = (header[0] > 0) && (groupBytes <= logData.size - position - sizeof(header))
+                       && (logChecksum(logData.data + position + sizeof(header), groupBytes) == header[1]);
+               
+               if (valid)
                {
-                   current = current->rightPtr;
-               }// end if new number is greater than current node number
-         } // end while current points to a value
+                   position += sizeof(header);
+                   for (index = 0; index < groupBytes; index += LOG_RECORD_BYTES)
+                   {
+                       memcpy(&number, logData.data + position + index + 1, sizeof(int));
+                       changes.push_back(make_pair(number, logData.data[position + index]));
+                   }
+                   position += groupBytes;
+               } // end if group was written whole
+         } // end while groups remain
+         
+         closeInput(logData);
+     } // end if log file could be read
+     
+     return position;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     applyChanges
+// DESCRIPTION:  Applies logged changes to the tree. Only the last change to an
+//               integer decides whether it ends up in the tree, so the changes
+//               are sorted and applied with one batch insert and one batch
+//               delete. Applying changes the tree already holds does nothing.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the BST structure.
+//                  changes - The changes in the order they were made.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+//                  changes - Sorted by integer, passed by reference.
+//                  memoryFail - Same as input, passed by reference.
+// CALLS TO:     insertBatch
+//               deleteBatch
+//------------------------------------------------------------------------------
+
+void applyChanges(binarySearchTree *&mainTree, vector< pair<int, char> >& changes, bool& memoryFail)
+{
+     vector<int> adds,
+                 deletes;
+     vector<char> status;
+     size_t index;
+     
+     stable_sort(changes.begin(), changes.end(),
+                 [](const pair<int, char>& first, const pair<int, char>& second)
+                 { return first.first < second.first; });
+     
+     for (index = 0; index < changes.size(); index++)
+     {
+         if ((index + 1 == changes.size()) || (changes[index + 1].first != changes[index].first))
+         {
+             if (changes[index].second == LOG_INSERT)
+             {
+                 adds.push_back(changes[index].first);
+             }
+             else
+             {
+                 deletes.push_back(changes[index].first);
+             }
+         } // end if this is the last change to the integer
+     }
+     
+     if (!adds.empty())
+     {
+         status.resize(adds.size());
+         insertBatch(mainTree, &adds[0], static_cast<int>(adds.size()), &status[0], memoryFail);
+     }
+     if (!deletes.empty() && !memoryFail)
+     {
+         status.resize(deletes.size());
+         deleteBatch(mainTree, &deletes[0], static_cast<int>(deletes.size()), &status[0]);
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     appendLog
+// DESCRIPTION:  Records an add or delete made to the logged tree. The record
+//               waits for the next group commit; the commit thread is woken
+//               early when a group is full. Once enough changes are logged the
+//               log is compacted. A write that failed since the last change
+//               is reported first.
+// INPUT:
+//     Parameters:  log - A pointer to the mutation log, NULL when there is none.
+//                  mainTree - A pointer to the BST structure that was changed.
+//                  operation - LOG_INSERT or LOG_DELETE.
+//                  num - The integer added or deleted.
+// OUTPUT:       N/A
+// CALLS TO:     reportLogFailure
+//               compactLog
+//------------------------------------------------------------------------------
+
+void appendLog(mutationLog *log, binarySearchTree *mainTree, char operation, int num)
+{
+     bool full;
+     
+     if ((log != NULL) && (mainTree == log->tree))
+     {
+         reportLogFailure(log);
          
-         if (trailCurrent->number > newNode->number)
+         log->pendingLock.lock();
+         log->pending.push_back(operation);
+         log->pending.insert(log->pending.end(), reinterpret_cast<const char *>(&num),
+                             reinterpret_cast<const char *>(&num) + sizeof(int));
+         full = (log->pending.size() >= LOG_GROUP_BYTES);
+         log->pendingLock.unlock();
+         
+         if (full)
          {
-             trailCurrent->leftPtr = newNode;
+             log->wake.notify_one();
          }
-         else
+         
+         log->records++;
+         if ((log->records >= LOG_COMPACT_RECORDS) && !log->compacting)
          {
-             trailCurrent->rightPtr = newNode;
+             compactLog(log);
          }
+     } // end if changes to this tree are logged
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     runCommitter
+// DESCRIPTION:  Commit thread of the mutation log. Every LOG_COMMIT_MS, or
+//               sooner when a group fills, the records logged since the last
+//               commit are written and synced together, so one sync covers
+//               many changes. Stops when the log is closed.
+// INPUT:
+//     Parameters:  log - A pointer to the mutation log.
+// OUTPUT:       N/A
+// CALLS TO:     commitLog
+//------------------------------------------------------------------------------
+
+void runCommitter(mutationLog *log)
+{
+     unique_lock<mutex> guard(log->pendingLock);
+     
+     while (!log->stopping)
+     {
+           log->wake.wait_for(guard, chrono::milliseconds(LOG_COMMIT_MS));
+           guard.unlock();
+           commitLog(log);
+           guard.lock();
      }
      
      return;
 }
 
 //------------------------------------------------------------------------------
-// FUNCTION:     findNode
-// DESCRIPTION:  Traverses the BST until a target node is found, or all elements
-//               have been inspected.
+// FUNCTION:     commitLog
+// DESCRIPTION:  Writes the records logged so far as one group, a count and a
+//               checksum followed by the records, and syncs the log file.
 // INPUT:
-//     Parameters:  mainTree - A pointer to the main BST structure.
-//                  num - The integer that is the target value.
-//                  flag - Boolean value of whether the value was found or not.
+//     Parameters:  log - A pointer to the mutation log.
 // OUTPUT:
-//     Parameters:  mainTree - Same as input, passed by reference. 
-//                  flag - Same as input, passed by reference.
-//     Return Val:  testNode - A pointer to the node if found, NULL if not.
-// CALLS TO:     isEmptyTree
+//     Parameters:  log - Same as input, passed by reference.
+// CALLS TO:     logChecksum
 //------------------------------------------------------------------------------
 
-treeNode *findNode(binarySearchTree *&mainTree, int num, bool& flag)
+void commitLog(mutationLog *log)
 {
-    flag = false;
-    treeNode *testNode;
-    
-    testNode = mainTree->root;
-    
-    if (isEmptyTree(mainTree))
-    {
-        flag = false;
-    } // end if tree is empty
-    else
-    {
-        while ((testNode != NULL) && !flag)
-        {
-              if (testNode->number == num)
-              {
-                  flag = true;
-              } // end if target number is found
-              else if (testNode->number > num)
-              {
-                  testNode = testNode->leftPtr;
-              } // end if node number is greater than target number
-              else
-              {
-                  testNode = testNode->rightPtr;
-              } // end if node number is less than target number
-        } // end while pointer contains a value and is not the number searched for
-    } // end if tree is not empty
-    
-    return testNode;
+     lock_guard<mutex> writer(log->fileLock);
+     unsigned int header[2];
+     bool written = true;
+     
+     log->pendingLock.lock();
+     log->writing.swap(log->pending);
+     log->pendingLock.unlock();
+     
+     if (!log->writing.empty() && (log->file != NULL))
+     {
+         header[0] = static_cast<unsigned int>(log->writing.size() / LOG_RECORD_BYTES);
+         header[1] = logChecksum(&log->writing[0], log->writing.size());
+         
+         written = (fwrite(header, sizeof(header), 1, log->file) == 1)
+                   && (fwrite(&log->writing[0], 1, log->writing.size(), log->file) == log->writing.size())
+                   && (fflush(log->file) == 0);
+#if defined(_WIN32)
+         written = written && (_commit(_fileno(log->file)) == 0);
+#elif defined(__unix__) || defined(__APPLE__)
+         written = written && (fsync(fileno(log->file)) == 0);
+#endif
+     } // end if there are records to commit
+     else if (!log->writing.empty())
+     {
+         written = false;
+     } // end if the log file could not be reopened
+     
+     if (!written)
+     {
+         log->failed = true;
+     }
+     log->writing.clear();
+     
+     return;
 }
 
 //------------------------------------------------------------------------------
-// FUNCTION:     displayMenu
-// DESCRIPTION:  Displays the actions available to the user and loops users input
-//               until a valid one is selected.
+// FUNCTION:     logChecksum
+// DESCRIPTION:  Computes the FNV-1a checksum of a group of log records.
 // INPUT:
-//     Parameters:  mainTree - A pointer to the main BST structure.
+//     Parameters:  data - The records.
+//                  size - The number of bytes of records.
 // OUTPUT:
-//     Parameters:  mainTree - Same as input, passed by reference.
-//     Return Val:  menuChoice - A character of the users selected action.
-// CALLS TO:     isEmptyTree
-//               nodeCount
+//     Return Val:  checksum - The checksum.
+// CALLS TO:     N/A
 //------------------------------------------------------------------------------
 
-char displayMenu(binarySearchTree *&mainTree)
+unsigned int logChecksum(const char *data, size_t size)
 {
-     char menuChoice;
+     unsigned int checksum = 2166136261U;
+     size_t index;
+     
+     for (index = 0; index < size; index++)
+     {
+         checksum = (checksum ^ static_cast<unsigned char>(data[index])) * 16777619U;
+     }
+     
+     return checksum;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     compactLog
+// DESCRIPTION:  Commits the log, moves it aside and starts a new one, then
+//               folds the tree into the base snapshot on another thread while
+//               changes go on. When the base is current the tree is the base
+//               with the log moved aside applied, so that thread rebuilds the
+//               keys from the two files; otherwise the keys of the tree are
+//               copied first.
+// INPUT:
+//     Parameters:  log - A pointer to the mutation log.
+// OUTPUT:
+//     Parameters:  log - Same as input, passed by reference.
+// CALLS TO:     commitLog
+//               replaceFile
+//               startIterator
+//               nextNode
+//               foldLog
+//------------------------------------------------------------------------------
+
+void compactLog(mutationLog *log)
+{
+     vector<int> keys;
+     treeIterator iterator;
+     treeNode *node;
+     bool moved;
+     
+     if (log->compactor.joinable())
+     {
+         log->compactor.join();
+     }
+     
+     commitLog(log);
+     
+     log->fileLock.lock();
+     fclose(log->file);
+     moved = replaceFile(log->fileName, log->fileName + LOG_OLD_SUFFIX);
+     log->file = fopen(log->fileName.c_str(), moved ? "w+b" : "a+b");
+     if (log->file == NULL)
+     {
+         log->failed = true;
+     }
+     log->fileLock.unlock();
+     
+     if (moved)
+     {
+         if (!log->baseCurrent)
+         {
+             keys.reserve(log->tree->count);
+             startIterator(iterator, log->tree->root);
+             while ((node = nextNode(iterator)) != NULL)
+             {
+                   keys.push_back(node->number);
+             }
+         } // end if the keys cannot be rebuilt from the base
+         
+         log->records = 0;
+         log->compacting = true;
+         log->compactor = thread(foldLog, log, move(keys), log->tree->balanced, log->baseCurrent);
+     } // end if log was moved aside
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     writeLogBase
+// DESCRIPTION:  Writes sorted integers as a balanced snapshot to a temporary
+//               file, syncs it, and renames it over the base snapshot, so the
+//               base is always either the old or the new one whole.
+// INPUT:
+//     Parameters:  keys - The integers in ascending order.
+//                  balanced - Boolean value of whether the tree is AVL balanced.
+//                  fileName - The name of the base snapshot.
+// OUTPUT:
+//     Return Val:  written - Boolean value of whether the new base is in place.
+// CALLS TO:     createTree
+//               buildBalanced
+//               saveSnapshot
+//               releaseTree
+//               syncPath
+//               replaceFile
+//------------------------------------------------------------------------------
+
+bool writeLogBase(const vector<int>& keys, bool balanced, const string& fileName)
+{
+     binarySearchTree *baseTree;
+     bool written = false,
+          memoryFail = false;
+     
+     baseTree = createTree();
+     
+     if (baseTree)
+     {
+         baseTree->balanced = balanced;
+         if (!keys.empty())
+         {
+             buildBalanced(baseTree->root, &keys[0], 0, static_cast<int>(keys.size()) - 1,
+                           baseTree, memoryFail);
+         }
+         
+         written = !memoryFail && saveSnapshot(baseTree, fileName + LOG_TEMPORARY_SUFFIX)
+                   && syncPath(fileName + LOG_TEMPORARY_SUFFIX)
+                   && replaceFile(fileName + LOG_TEMPORARY_SUFFIX, fileName);
+         releaseTree(baseTree);
+     } // end if memory correctly allocated for baseTree
+     
+     return written;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     foldLog
+// DESCRIPTION:  Compaction step: writes the keys as the new base snapshot and
+//               deletes the log that was moved aside, whose changes the keys
+//               already hold. If the base cannot be written the old log is
+//               kept and compaction stays off, so no change is lost.
+// INPUT:
+//     Parameters:  log - A pointer to the mutation log.
+//                  keys - The integers of the tree when the log was moved aside,
+//                         empty when they are rebuilt.
+//                  balanced - Boolean value of whether the tree is AVL balanced.
+//                  replay - Boolean value of whether the keys are rebuilt from
+//                           the base snapshot and the log moved aside.
+// OUTPUT:
+//     Parameters:  log - Same as input, passed by reference.
+// CALLS TO:     replayBase
+//               writeLogBase
+//------------------------------------------------------------------------------
+
+void foldLog(mutationLog *log, vector<int> keys, bool balanced, bool replay)
+{
+     if ((!replay || replayBase(log->fileName, keys))
+         && writeLogBase(keys, balanced, log->fileName + LOG_BASE_SUFFIX))
+     {
+         remove((log->fileName + LOG_OLD_SUFFIX).c_str());
+         log->baseCurrent = true;
+         log->compacting = false;
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     replayBase
+// DESCRIPTION:  Rebuilds the integers of the tree from the base snapshot of the
+//               mutation log and the changes in the log moved aside by
+//               compaction, which together hold every change up to the move.
+// INPUT:
+//     Parameters:  fileName - The name of the mutation log.
+// OUTPUT:
+//     Parameters:  keys - The integers in ascending order, appended.
+//     Return Val:  rebuilt - Boolean value of whether both files could be used.
+// CALLS TO:     createTree
+//               loadSnapshot
+//               replayLog
+//               applyChanges
+//               startIterator
+//               nextNode
+//               releaseTree
+//------------------------------------------------------------------------------
+
+bool replayBase(const string& fileName, vector<int>& keys)
+{
+     binarySearchTree *baseTree;
+     vector< pair<int, char> > changes;
+     treeIterator iterator;
+     treeNode *node;
+     bool rebuilt = false,
+          memoryFail = false;
+     
+     baseTree = createTree();
+     
+     if (baseTree)
+     {
+         rebuilt = loadSnapshot(fileName + LOG_BASE_SUFFIX, baseTree, memoryFail) && !memoryFail;
+         if (rebuilt)
+         {
+             replayLog(fileName + LOG_OLD_SUFFIX, changes);
+             applyChanges(baseTree, changes, memoryFail);
+             rebuilt = !memoryFail;
+         }
+         
+         if (rebuilt)
+         {
+             keys.reserve(baseTree->count);
+             startIterator(iterator, baseTree->root);
+             while ((node = nextNode(iterator)) != NULL)
+             {
+                   keys.push_back(node->number);
+             }
+         } // end if the tree was rebuilt
+         
+         releaseTree(baseTree);
+     } // end if memory correctly allocated for baseTree
+     
+     return rebuilt;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     replaceFile
+// DESCRIPTION:  Renames a file, replacing any file with the new name, and syncs
+//               the directory so the rename survives a crash.
+// INPUT:
+//     Parameters:  source - The name of the file.
+//                  target - The new name of the file.
+// OUTPUT:
+//     Return Val:  moved - Boolean value of whether the file was renamed.
+// CALLS TO:     syncPath
+//------------------------------------------------------------------------------
+
+bool replaceFile(const string& source, const string& target)
+{
+     bool moved;
+     
+#if defined(_WIN32)
+     moved = (MoveFileExA(source.c_str(), target.c_str(),
+                          MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0);
+#else
+     size_t slash = target.find_last_of("/\\");
+     
+     moved = (rename(source.c_str(), target.c_str()) == 0);
+     if (moved)
+     {
+         syncPath((slash == string::npos) ? string(".") : target.substr(0, slash + 1));
+     }
+#endif
+     
+     return moved;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     syncPath
+// DESCRIPTION:  Forces the contents of a file, or the entries of a directory
+//               where the system allows it, to disk.
+// INPUT:
+//     Parameters:  path - The name of the file or directory.
+// OUTPUT:
+//     Return Val:  synced - Boolean value of whether it was synced.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+bool syncPath(const string& path)
+{
+     bool synced = false;
+     
+#if defined(_WIN32)
+     int file = _open(path.c_str(), _O_RDWR | _O_BINARY);
+     
+     if (file >= 0)
+     {
+         synced = (_commit(file) == 0);
+         _close(file);
+     }
+#elif defined(__unix__) || defined(__APPLE__)
+     int file = open(path.c_str(), O_RDONLY);
+     
+     if (file >= 0)
+     {
+         synced = (fsync(file) == 0);
+         close(file);
+     }
+#else
+     // there is no portable way to force a file to disk, so trust the close
+     synced = !path.empty();
+#endif
+     
+     return synced;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     closeLog
+// DESCRIPTION:  Stops the commit thread, commits the last records, waits for
+//               any compaction and closes the mutation log.
+// INPUT:
+//     Parameters:  log - A pointer to the mutation log, NULL when there is none.
+// OUTPUT:
+//     Parameters:  log - Set to NULL, passed by reference.
+// CALLS TO:     commitLog
+//               reportLogFailure
+//------------------------------------------------------------------------------
+
+void closeLog(mutationLog *&log)
+{
+     if (log != NULL)
+     {
+         log->pendingLock.lock();
+         log->stopping = true;
+         log->pendingLock.unlock();
+         log->wake.notify_one();
+         
+         if (log->committer.joinable())
+         {
+             log->committer.join();
+         }
+         commitLog(log);
+         
+         if (log->compactor.joinable())
+         {
+             log->compactor.join();
+         }
+         if (log->file != NULL)
+         {
+             fclose(log->file);
+         }
+         
+         reportLogFailure(log);
+         
+         delete log;
+         log = NULL;
+     } // end if there is a mutation log
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     reportLogFailure
+// DESCRIPTION:  Reports that a change could not be written to the mutation log,
+//               the first time the main thread finds a write has failed. The
+//               writes that fail run on the commit and compaction threads, so
+//               the report waits for the next change or for the log to close.
+// INPUT:
+//     Parameters:  log - A pointer to the mutation log.
+// OUTPUT:
+//     Parameters:  log - Same as input, passed by reference.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void reportLogFailure(mutationLog *log)
+{
+     if (log->failed && !log->reported)
+     {
+         cout << "ERROR - Changes could not be written to the mutation log " << log->fileName << "." << endl;
+         log->reported = true;
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     getFile
+// DESCRIPTION:  Opens the input file named on the command line, or prompts the
+//               user for an input file and opens it for testing by fileExists
+//               function. The prompt stops once standard input has no more
+//               names to give.
+// INPUT:
+//     Parameters:  dataIn - Reading input stream variable.
+//                  inputFile - The file named with -input, empty to prompt.
+// OUTPUT:
+//     Parameters:  dataIn - Same as input, passed by reference.
+//                  fileName - The name of the file that was opened.
+//     Return Val:  opened - Boolean value of whether a file was opened.
+// CALLS TO:     fileExists
+//------------------------------------------------------------------------------
+
+
+bool getFile(ifstream& dataIn, string& fileName, const string& inputFile)
+{
+     bool opened;
+     
+     if (!inputFile.empty())
+     {
+         fileName = inputFile;
+         dataIn.open(fileName.c_str());
+         
+         if (!fileExists(dataIn))
+         {
+             cout << "ERROR - Input file " << fileName << " does not exist." << endl;
+         }
+     } // end if file is named on the command line
+     else
+     {
+         do
+         {
+             if (!fileExists(dataIn))
+             {
+                 cout << "File does not exist, enter  a file that does exist." << endl;
+                 dataIn.clear();
+             }
+             cout << "Enter a file name for integer data: ";
+             cin >> fileName;
+             
+             dataIn.open (fileName.c_str());
+         } while (!fileExists(dataIn) && cin);
+         
+         if (!cin)
+         {
+             cout << endl << "ERROR - No input file name could be read." << endl;
+         }
+     } // end if user is prompted for the file
+     opened = fileExists(dataIn);
+     
+     return opened;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     openMappedInput
+// DESCRIPTION:  Maps the input file into memory so integers can be parsed from
+//               it directly. When the file cannot be mapped it is read into a
+//               single block of memory instead.
+// INPUT:
+//     Parameters:  fileName - The name of the input file.
+// OUTPUT:
+//     Parameters:  scanner - Positioned at the start of the file contents.
+//     Return Val:  opened - Boolean value of whether the contents are available.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+bool openMappedInput(const string& fileName, integerScanner& scanner)
+{
+     ifstream wholeFile;
+     char *buffer;
+     bool opened = false;
+     
+     scanner.data = NULL;
+     scanner.size = 0;
+     scanner.mapped = false;
+     
+#if defined(_WIN32)
+     HANDLE file,
+            mapping;
+     LARGE_INTEGER fileSize;
+     
+     file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                        FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+     if (file != INVALID_HANDLE_VALUE)
+     {
+         if (GetFileSizeEx(file, &fileSize) && (fileSize.QuadPart > 0))
+         {
+             mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+             if (mapping != NULL)
+             {
+                 scanner.data = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                 scanner.size = static_cast<size_t>(fileSize.QuadPart);
+                 CloseHandle(mapping);
+             }
+         }
+         CloseHandle(file);
+     } // end if file could be opened for mapping
+#elif defined(__unix__) || defined(__APPLE__)
+     int file;
+     struct stat fileStatus;
+     void *memory;
+     
+     file = open(fileName.c_str(), O_RDONLY);
+     if (file >= 0)
+     {
+         if ((fstat(file, &fileStatus) == 0) && (fileStatus.st_size > 0))
+         {
+             memory = mmap(NULL, fileStatus.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+             if (memory != MAP_FAILED)
+             {
+                 madvise(memory, fileStatus.st_size, MADV_SEQUENTIAL);
+                 scanner.data = static_cast<const char *>(memory);
+                 scanner.size = fileStatus.st_size;
+             }
+         }
+         close(file);
+     } // end if file could be opened for mapping
+#endif
+     
+     if (scanner.data != NULL)
+     {
+         scanner.mapped = true;
+         opened = true;
+     } // end if file is mapped
+     else
+     {
+         wholeFile.open(fileName.c_str(), ios::binary);
+         wholeFile.seekg(0, ios::end);
+         scanner.size = static_cast<size_t>(wholeFile.tellg());
+         wholeFile.seekg(0, ios::beg);
+         buffer = new (nothrow) char[scanner.size + 1];
+         
+         if (wholeFile && buffer)
+         {
+             wholeFile.read(buffer, scanner.size);
+             scanner.data = buffer;
+             opened = true;
+         }
+         else
+         {
+             delete [] buffer;
+         }
+     } // end if file is read into memory instead
+     
+     if (opened)
+     {
+         scanner.current = scanner.data;
+         scanner.end = scanner.data + scanner.size;
+     }
+     
+     return opened;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     readInteger
+// DESCRIPTION:  Reads the next integer from the input stream.
+// INPUT:
+//     Parameters:  dataIn - Reading input stream variable.
+// OUTPUT:
+//     Parameters:  dataIn - Same as input, passed by reference.
+//                  number - The integer that was read.
+//     Return Val:  Boolean value of whether an integer was read.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+bool readInteger(ifstream& dataIn, int& number)
+{
+     dataIn >> number;
+     
+     return static_cast<bool>(dataIn);
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     readInteger
+// DESCRIPTION:  Parses the next integer from a file in memory, accepting the
+//               same text as reading an int from a stream: leading whitespace,
+//               an optional sign and decimal digits. Reading stops at text that
+//               is not an integer or a value too large for an int, as it does
+//               for a stream.
+// INPUT:
+//     Parameters:  scanner - Position of the next integer in the file.
+// OUTPUT:
+//     Parameters:  scanner - Same as input, moved past the integer.
+//                  number - The integer that was read.
+//     Return Val:  valid - Boolean value of whether an integer was read.
+// CALLS TO:     scanDigits
+//------------------------------------------------------------------------------
+
+bool readInteger(integerScanner& scanner, int& number)
+{
+     const char *position = scanner.current,
+                *end = scanner.end;
+     unsigned long long value = 0,
+                        chunk,
+                        limit = 2147483647ULL;
+     unsigned digit;
+     int digitCount,
+         totalDigits = 0;
+     bool negative = false,
+          valid = false;
+     
+     while ((position != end) && ((*position == ' ') || ((*position >= '\t') && (*position <= '\r'))))
+     {
+           position++;
+     }
+     
+     if ((position != end) && ((*position == '-') || (*position == '+')))
+     {
+         negative = (*position == '-');
+         position++;
+     }
+     
+     if (negative)
+     {
+         limit++;
+     }
+     
+     // convert 8 bytes at a time while they remain, then one digit at a time
+     digitCount = 8;
+     while ((digitCount == 8) && (end - position >= 8) && (value <= limit))
+     {
+           digitCount = scanDigits(position, chunk);
+           value = value * POWERS_OF_TEN[digitCount] + chunk;
+           position += digitCount;
+           totalDigits += digitCount;
+     } // end while whole blocks of 8 digits are found
+     
+     while ((digitCount == 8) && (position != end) && (value <= limit))
+     {
+           digit = static_cast<unsigned>(*position - '0');
+           if (digit < 10)
+           {
+               value = value * 10 + digit;
+               position++;
+               totalDigits++;
+           }
+           else
+           {
+               digitCount = 0;
+           }
+     } // end while digits remain near the end of the file
+     
+     if ((totalDigits > 0) && (value <= limit))
+     {
+         if (negative)
+         {
+             number = static_cast<int>(0 - static_cast<long long>(value));
+         }
+         else
+         {
+             number = static_cast<int>(value);
+         }
+         valid = true;
+     } // end if an integer in range was read
+     
+     scanner.current = position;
+     
+     return valid;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     scanDigits
+// DESCRIPTION:  Looks at 8 bytes at once and converts the digits at the front
+//               of them. All 8 bytes are tested as one word without branching
+//               per byte, and the digits are converted with three multiplications.
+// INPUT:
+//     Parameters:  position - Start of 8 readable bytes.
+// OUTPUT:
+//     Parameters:  value - The value of the digits at the front of the bytes.
+//     Return Val:  digitCount - The number of digits at the front of the bytes.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+int scanDigits(const char *position, unsigned long long& value)
+{
+    int digitCount = 0;
+    
+#if defined(SCAN_WIDE_DIGITS)
+    const unsigned long long HIGH_NIBBLES = 0xF0F0F0F0F0F0F0F0ULL,
+                             ZEROES = 0x3030303030303030ULL,
+                             SIXES = 0x0606060606060606ULL;
+    unsigned long long word,
+                       notDigit;
+    
+    memcpy(&word, position, sizeof(word));
+    
+    // a digit byte is 0x30-0x39, so both it and the byte plus 6 have a high
+    // nibble of 3; any other byte leaves a nonzero high nibble in notDigit
+    notDigit = ((word & HIGH_NIBBLES) ^ ZEROES) | (((word + SIXES) & HIGH_NIBBLES) ^ ZEROES);
+    
+    if (notDigit == 0)
+    {
+        digitCount = 8;
+    }
+    else
+    {
+#if defined(__GNUC__)
+        digitCount = __builtin_ctzll(notDigit) / 8;
+#elif defined(_MSC_VER) && defined(_WIN64)
+        unsigned long bit;
+        
+        _BitScanForward64(&bit, notDigit);
+        digitCount = static_cast<int>(bit) / 8;
+#else
+        while (!(notDigit & 0xFF))
+        {
+              notDigit >>= 8;
+              digitCount++;
+        }
+#endif
+    } // end if digits stop inside the 8 bytes
+    
+    value = 0;
+    if (digitCount > 0)
+    {
+        // line the digits up as the low end of an 8 digit number with leading zeroes
+        if (digitCount < 8)
+        {
+            word = (word << (64 - 8 * digitCount)) | (ZEROES >> (8 * digitCount));
+        }
+        word -= ZEROES;
+        word = (word * 10) + (word >> 8);
+        value = (((word & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32)))
+                 + (((word >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+    } // end if there are digits to convert
+#else
+    value = 0;
+    while ((digitCount < 8) && (position[digitCount] >= '0') && (position[digitCount] <= '9'))
+    {
+          value = value * 10 + static_cast<unsigned>(position[digitCount] - '0');
+          digitCount++;
+    }
+#endif
+    
+    return digitCount;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     closeInput
+// DESCRIPTION:  Closes the input stream.
+// INPUT:
+//     Parameters:  dataIn - Reading input stream variable.
+// OUTPUT:
+//     Parameters:  dataIn - Same as input, passed by reference.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void closeInput(ifstream& dataIn)
+{
+     dataIn.close();
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     closeInput
+// DESCRIPTION:  Unmaps, or deallocates, the file contents held by a scanner.
+// INPUT:
+//     Parameters:  scanner - The scanner holding the file contents.
+// OUTPUT:
+//     Parameters:  scanner - Same as input, passed by reference.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void closeInput(integerScanner& scanner)
+{
+     if (scanner.mapped)
+     {
+#if defined(_WIN32)
+         UnmapViewOfFile(scanner.data);
+#elif defined(__unix__) || defined(__APPLE__)
+         munmap(const_cast<char *>(scanner.data), scanner.size);
+#endif
+     } // end if contents were mapped
+     else
+     {
+         delete [] scanner.data;
+     }
+     
+     scanner.data = NULL;
+     scanner.current = NULL;
+     scanner.end = NULL;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     fileExists
+// DESCRIPTION:  Tests that a file exists.
+// INPUT:
+//     Parameters:  dataIn - Reading input stream variable.
+// OUTPUT:
+//     Parameters:  dataIn - Same as input, passed by reference.
+//     Return Val:  exists - Boolean value of whether or not the file exists.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+
+bool fileExists(ifstream& dataIn)
+{
+     bool exists;
+     
+     if (dataIn)
+     {
+         exists = true;
+     }
+     else
+     {
+         exists = false;
+     }
+     
+     return exists;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     isEmptyFile
+// DESCRIPTION:  Tests if there is any data in the input file.
+// INPUT:
+//     Parameters:  dataIn - Reading input stream variable.
+// OUTPUT:
+//     Parameters:  dataIn - Same as input, passed by reference.
+//     Return Val:  empty - Boolean value of whether or not the file contains data.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+
+bool isEmptyFile(ifstream& dataIn)
+{
+     bool empty;
+
+     if (dataIn.peek() != EOF)
+     {
+         empty = false;
+     }
+     else
+     {
+         empty = true;
+     }
+     
+     return empty;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     getData
+// DESCRIPTION:  Reads data from the input file into a BST.
+// INPUT:
+//     Parameters:  dataIn - Reading input stream or in memory scanner.
+//                  mainTree - A pointer to the BST structure.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  dataIn - Same as input, passed by reference.
+//                  mainTree - Same as input, passed by reference.
+//                  memoryFail - Same as input, passed by reference.
+// CALLS TO:     readInteger
+//               fingerInsert
+//               finishFinger
+//               closeInput
+//------------------------------------------------------------------------------
+
+template <typename InputType>
+void getData(InputType& dataIn, binarySearchTree *&mainTree, bool& memoryFail)
+{
+     basicFinger<treeNode> finger;
+     int number;
+     bool flag,
+          valid;
+
+     finger.above = 0;
+     valid = readInteger(dataIn, number);
+     
+     // each number is added, or found to be a repeat, starting from the last one
+     while (valid && !memoryFail)
+     {
+         fingerInsert(mainTree, finger, number, flag, memoryFail);
+         
+         if (flag)
+         {
+             cout << endl << number << " already exists in tree and will be ignored." << endl;
+         }
+         
+         valid = readInteger(dataIn, number);
+     } // read data from input file until last number
+     
+     finishFinger(mainTree, finger);
+     closeInput(dataIn);
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     bulkLoad
+// DESCRIPTION:  Reads every integer from the input file, sorts them and builds
+//               a height optimal BST in one pass over the sorted values. Repeated
+//               values get the same notices getData would display.
+// INPUT:
+//     Parameters:  dataIn - Reading input stream or in memory scanner.
+//                  mainTree - A pointer to the BST structure.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  dataIn - Same as input, passed by reference.
+//                  mainTree - Same as input, passed by reference.
+//                  memoryFail - Same as input, passed by reference.
+// CALLS TO:     collectIntegers
+//               closeInput
+//               sortUnique
+//               reportDuplicates
+//               buildBalanced
+//------------------------------------------------------------------------------
+
+template <typename InputType>
+void bulkLoad(InputType& dataIn, binarySearchTree *&mainTree, bool& memoryFail)
+{
+     vector<int> values,
+                 keys,
+                 duplicates;
+     
+     collectIntegers(dataIn, values);
+     closeInput(dataIn);
+     
+     keys = values;
+     sortUnique(keys, duplicates);
+     reportDuplicates(values, duplicates);
+     
+     if (!keys.empty())
+     {
+         buildBalanced(mainTree->root, &keys[0], 0, static_cast<int>(keys.size()) - 1,
+                       mainTree, memoryFail);
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     collectIntegers
+// DESCRIPTION:  Reads integers from the input file until the end of the data,
+//               the same way getData does.
+// INPUT:
+//     Parameters:  dataIn - Reading input stream or in memory scanner.
+// OUTPUT:
+//     Parameters:  dataIn - Same as input, passed by reference.
+//                  values - The integers in the order they were read.
+// CALLS TO:     readInteger
+//------------------------------------------------------------------------------
+
+template <typename InputType>
+void collectIntegers(InputType& dataIn, vector<int>& values)
+{
+     int number;
+     
+     while (readInteger(dataIn, number))
+     {
+         values.push_back(number);
+     } // read data from input file until last number
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     sortUnique
+// DESCRIPTION:  Sorts an array of integers and removes repeated values.
+// INPUT:
+//     Parameters:  keys - The integers to sort.
+// OUTPUT:
+//     Parameters:  keys - Same as input, sorted with one copy of each value.
+//                  duplicates - The sorted values that appeared more than once.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void sortUnique(vector<int>& keys, vector<int>& duplicates)
+{
+     size_t index,
+            last = 0;
+     
+     sort(keys.begin(), keys.end());
+     
+     for (index = 1; index < keys.size(); index++)
+     {
+         if (keys[index] != keys[last])
+         {
+             last++;
+             keys[last] = keys[index];
+         } // end if value differs from the last one kept
+         else if (duplicates.empty() || (duplicates.back() != keys[index]))
+         {
+             duplicates.push_back(keys[index]);
+         } // end if first repeat of this value
+     }
+     
+     if (!keys.empty())
+     {
+         keys.resize(last + 1);
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     reportDuplicates
+// DESCRIPTION:  Displays a notice for every repeat of a value, in the order the
+//               values were read, matching the notices displayed by getData.
+// INPUT:
+//     Parameters:  values - The integers in the order they were read.
+//                  duplicates - The sorted values that appeared more than once.
+// OUTPUT:       N/A
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void reportDuplicates(const vector<int>& values, const vector<int>& duplicates)
+{
+     vector<bool> seen(duplicates.size(), false);
+     vector<int>::const_iterator position;
+     size_t index,
+            slot;
+     
+     for (index = 0; (index < values.size()) && !duplicates.empty(); index++)
+     {
+         position = lower_bound(duplicates.begin(), duplicates.end(), values[index]);
+         
+         if ((position != duplicates.end()) && (*position == values[index]))
+         {
+             slot = position - duplicates.begin();
+             
+             if (seen[slot])
+             {
+                 cout << endl << values[index] << " already exists in tree and will be ignored." << endl;
+             }
+             else
+             {
+                 seen[slot] = true;
+             }
+         } // end if value is repeated somewhere in the input
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     buildBalanced
+// DESCRIPTION:  Builds a height optimal subtree from a range of sorted values by
+//               making the middle value the root of each subtree.
+// INPUT:
+//     Parameters:  link - The link that will hold the subtree.
+//                  keys - Sorted values with no repeats.
+//                  first - Index of the first value in the range.
+//                  last - Index of the last value in the range.
+//                  mainTree - A pointer to the main BST structure.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  link - Same as input, passed by reference.
+//                  memoryFail - Same as input, passed by reference.
+// CALLS TO:     createNode
+//               buildBalanced
+//               updateNode
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+void buildBalanced(typename Tree::nodeType *&link, const typename Tree::keyType keys[], int first,
+                   int last, Tree *mainTree, bool& memoryFail)
+{
+     int middle;
+     
+     if ((first <= last) && !memoryFail)
+     {
+         middle = first + (last - first) / 2;
+         link = createNode<typename Tree::nodeType>(keys[middle], mainTree->arena);
+         
+         if (link)
+         {
+             mainTree->count++;
+             buildBalanced(link->leftPtr, keys, first, middle - 1, mainTree, memoryFail);
+             buildBalanced(link->rightPtr, keys, middle + 1, last, mainTree, memoryFail);
+             updateNode(link);
+         } // end if memory allocated for new node
+         else
+         {
+             memoryFail = true;
+         } // end memory not allocated
+     } // end if range holds values
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     parallelLoad
+// DESCRIPTION:  Builds a height optimal BST from the input file using several
+//               threads. The file is split into chunks at whitespace, each
+//               thread reads and sorts its own chunk, the sorted chunks are
+//               merged in pairs and the subtrees below the root are built at
+//               the same time. The tree and the notices for repeated values
+//               are the same as bulkLoad gives. Any chunk or merge whose
+//               thread cannot be started, or runs out of memory, is done again
+//               on the calling thread after the other threads finish, and so
+//               is the whole tree if building it on threads runs out of memory.
+// INPUT:
+//     Parameters:  scanner - The file contents in memory.
+//                  mainTree - A pointer to the BST structure.
+//                  threadCount - The number of threads to use.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  scanner - Same as input, passed by reference.
+//                  mainTree - Same as input, passed by reference.
+//                  memoryFail - Same as input, passed by reference.
+// CALLS TO:     splitInput
+//               parseChunk
+//               mergeRuns
+//               closeInput
+//               reportDuplicates
+//               buildParallel
+//               destroyArena
+//               createArena
+//               freeNodes
+//               buildBalanced
+//------------------------------------------------------------------------------
+
+void parallelLoad(integerScanner& scanner, binarySearchTree *&mainTree, int threadCount, bool& memoryFail)
+{
+     vector<integerScanner> chunks;
+     vector< vector<int> > values,
+                           runs,
+                           duplicates,
+                           merged,
+                           repeats;
+     vector<int> allValues,
+                 allDuplicates;
+     vector<thread> workers;
+     vector<char> complete,
+                  failed;
+     size_t chunkCount,
+            index;
+     int levels = 0;
+     bool hugePages;
+     
+     splitInput(scanner, threadCount, chunks);
+     chunkCount = chunks.size();
+     values.resize(chunkCount);
+     runs.resize(chunkCount);
+     duplicates.resize(chunkCount);
+     complete.resize(chunkCount);
+     
+     workers.reserve(chunkCount);
+     failed.assign(chunkCount, false);
+     for (index = 0; index < chunkCount; index++)
+     {
+         try
+         {
+             workers.push_back(thread([&, index]()
+             {
+                 try
+                 {
+                     parseChunk(chunks[index], values[index], runs[index], duplicates[index],
+                                complete[index]);
+                 }
+                 catch (const bad_alloc&)
+                 {
+                     failed[index] = true;
+                 }
+             }));
+         }
+         catch (const system_error&)
+         {
+             failed[index] = true;
+         }
+         catch (const bad_alloc&)
+         {
+             failed[index] = true;
+         }
+     } // end for each chunk
+     for (index = 0; index < workers.size(); index++)
+     {
+         workers[index].join();
+     }
+     workers.clear();
+     
+     // a chunk whose thread could not be started, or ran out of memory, is
+     // read again here once the other threads have finished with theirs
+     for (index = 0; index < chunkCount; index++)
+     {
+         if (failed[index])
+         {
+             vector<int>().swap(values[index]);
+             vector<int>().swap(runs[index]);
+             vector<int>().swap(duplicates[index]);
+             parseChunk(chunks[index], values[index], runs[index], duplicates[index], complete[index]);
+         }
+     } // end for each chunk
+     closeInput(scanner);
+     
+     // reading stops at the first text that is not an integer, so chunks past it are dropped
+     index = 0;
+     while ((index + 1 < chunkCount) && complete[index])
+     {
+           index++;
+     }
+     chunkCount = index + 1;
+     runs.resize(chunkCount);
+     duplicates.resize(chunkCount);
+     
+     // merge the sorted chunks in pairs until one remains
+     while (runs.size() > 1)
+     {
+           merged.assign((runs.size() + 1) / 2, vector<int>());
+           repeats.assign(merged.size(), vector<int>());
+           
+           workers.reserve(merged.size());
+           failed.assign(merged.size(), false);
+           for (index = 0; index + 1 < runs.size(); index += 2)
+           {
+               try
+               {
+                   workers.push_back(thread([&, index]()
+                   {
+                       try
+                       {
+                           mergeRuns(runs[index], runs[index + 1], merged[index / 2], repeats[index / 2]);
+                       }
+                       catch (const bad_alloc&)
+                       {
+                           failed[index / 2] = true;
+                       }
+                   }));
+               }
+               catch (const system_error&)
+               {
+                   failed[index / 2] = true;
+               }
+               catch (const bad_alloc&)
+               {
+                   failed[index / 2] = true;
+               }
+           } // end for each pair of sorted chunks
+           if (runs.size() % 2 == 1)
+           {
+               merged.back().swap(runs.back());
+           }
+           for (index = 0; index < workers.size(); index++)
+           {
+               workers[index].join();
+           }
+           workers.clear();
+           
+           for (index = 0; index + 1 < runs.size(); index += 2)
+           {
+               if (failed[index / 2])
+               {
+                   vector<int>().swap(merged[index / 2]);
+                   vector<int>().swap(repeats[index / 2]);
+                   mergeRuns(runs[index], runs[index + 1], merged[index / 2], repeats[index / 2]);
+               }
+           } // end for each pair of sorted chunks
+           
+           runs.swap(merged);
+           duplicates.insert(duplicates.end(), repeats.begin(), repeats.end());
+     } // end while more than one sorted chunk remains
+     
+     for (index = 0; index < duplicates.size(); index++)
+     {
+         allDuplicates.insert(allDuplicates.end(), duplicates[index].begin(), duplicates[index].end());
+     }
+     
+     if (!allDuplicates.empty())
+     {
+         sort(allDuplicates.begin(), allDuplicates.end());
+         allDuplicates.erase(unique(allDuplicates.begin(), allDuplicates.end()), allDuplicates.end());
+         
+         for (index = 0; index < chunkCount; index++)
+         {
+             allValues.insert(allValues.end(), values[index].begin(), values[index].end());
+         }
+         reportDuplicates(allValues, allDuplicates);
+     } // end if any value is repeated
+     
+     // only the sorted keys are needed to build the tree
+     vector< vector<int> >().swap(values);
+     vector< vector<int> >().swap(duplicates);
+     vector<int>().swap(allValues);
+     vector<int>().swap(allDuplicates);
+     
+     while ((1 << levels) < threadCount)
+     {
+           levels++;
+     }
+     
+     if (!runs.empty() && !runs[0].empty())
+     {
+         buildParallel(mainTree->root, &runs[0][0], 0, static_cast<int>(runs[0].size()) - 1,
+                       mainTree, levels, memoryFail);
+         
+         // threads side by side can run out of memory where one alone does
+         // not, so a failed build is done again here once they have all ended
+         if (memoryFail)
+         {
+             if (mainTree->arena != NULL)
+             {
+                 hugePages = mainTree->arena->hugePages;
+                 destroyArena(mainTree->arena);
+                 mainTree->root = NULL;
+                 mainTree->arena = createArena(hugePages);
+                 memoryFail = (mainTree->arena == NULL);
+             } // end if nodes came from an arena
+             else
+             {
+                 freeNodes(mainTree->root);
+                 memoryFail = false;
+             }
+             mainTree->count = 0;
+             
+             if (!memoryFail)
+             {
+                 buildBalanced(mainTree->root, &runs[0][0], 0, static_cast<int>(runs[0].size()) - 1,
+                               mainTree, memoryFail);
+             }
+         } // end if threaded build ran out of memory
+     } // end if any integers were read
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     splitInput
+// DESCRIPTION:  Splits the file contents into about equal chunks that each end
+//               at whitespace, so no integer is split between two chunks.
+// INPUT:
+//     Parameters:  scanner - The file contents in memory.
+//                  chunkCount - The number of chunks wanted.
+// OUTPUT:
+//     Parameters:  chunks - A scanner for each chunk, in file order.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void splitInput(const integerScanner& scanner, int chunkCount, vector<integerScanner>& chunks)
+{
+     integerScanner chunk = scanner;
+     const char *boundary;
+     int index;
+     
+     chunk.mapped = false;
+     
+     for (index = 1; index <= chunkCount; index++)
+     {
+         boundary = scanner.current + (scanner.end - scanner.current) / chunkCount * index;
+         if (index == chunkCount)
+         {
+             boundary = scanner.end;
+         }
+         if (boundary < chunk.current)
+         {
+             boundary = chunk.current;
+         }
+         
+         while ((boundary != scanner.end) && !isspace(static_cast<unsigned char>(*boundary)))
+         {
+               boundary++;
+         }
+         
+         chunk.end = boundary;
+         chunks.push_back(chunk);
+         chunk.current = boundary;
+     } // end for each chunk
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     parseChunk
+// DESCRIPTION:  Reads every integer in one chunk of the file, then sorts them
+//               and removes repeats. Runs on its own thread.
+// INPUT:
+//     Parameters:  chunk - The part of the file to read.
+// OUTPUT:
+//     Parameters:  values - The integers in the order they were read.
+//                  keys - The integers sorted with one copy of each value.
+//                  duplicates - The values repeated within the chunk.
+//                  complete - Whether the whole chunk held integers.
+// CALLS TO:     readInteger
+//               sortUnique
+//------------------------------------------------------------------------------
+
+void parseChunk(integerScanner chunk, vector<int>& values, vector<int>& keys,
+                vector<int>& duplicates, char& complete)
+{
+     const char *start = chunk.current;
+     int number;
+     
+     while (readInteger(chunk, number))
+     {
+           values.push_back(number);
+           start = chunk.current;
+     } // read data from chunk until last number
+     
+     while ((start != chunk.end) && isspace(static_cast<unsigned char>(*start)))
+     {
+           start++;
+     }
+     complete = (start == chunk.end);
+     
+     keys = values;
+     sortUnique(keys, duplicates);
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     mergeRuns
+// DESCRIPTION:  Merges two sorted arrays without repeats into one, noting the
+//               values found in both. Runs on its own thread.
+// INPUT:
+//     Parameters:  first - Sorted values with no repeats.
+//                  second - Sorted values with no repeats.
+// OUTPUT:
+//     Parameters:  keys - The sorted values of both arrays with no repeats.
+//                  duplicates - The sorted values found in both arrays.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void mergeRuns(const vector<int>& first, const vector<int>& second, vector<int>& keys,
+               vector<int>& duplicates)
+{
+     size_t firstIndex = 0,
+            secondIndex = 0;
+     
+     keys.reserve(first.size() + second.size());
+     
+     while ((firstIndex < first.size()) && (secondIndex < second.size()))
+     {
+           if (first[firstIndex] < second[secondIndex])
+           {
+               keys.push_back(first[firstIndex++]);
+           }
+           else if (second[secondIndex] < first[firstIndex])
+           {
+               keys.push_back(second[secondIndex++]);
+           }
+           else
+           {
+               duplicates.push_back(first[firstIndex]);
+               keys.push_back(first[firstIndex++]);
+               secondIndex++;
+           }
+     } // end while both arrays have values left
+     
+     keys.insert(keys.end(), first.begin() + firstIndex, first.end());
+     keys.insert(keys.end(), second.begin() + secondIndex, second.end());
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     buildParallel
+// DESCRIPTION:  Builds the same subtree as buildBalanced, handing the left half
+//               of each of the top levels to a new thread. Each thread counts
+//               its nodes in its own tree structure and takes nodes from its
+//               own arena, which are added to the main tree when it finishes.
+//               A left half whose thread cannot be started, or that runs out
+//               of memory, is freed and built again with buildBalanced on the
+//               calling thread once the right half is done.
+// INPUT:
+//     Parameters:  link - The link that will hold the subtree.
+//                  keys - Sorted values with no repeats.
+//                  first - Index of the first value in the range.
+//                  last - Index of the last value in the range.
+//                  mainTree - A pointer to the BST structure the nodes belong to.
+//                  levels - The number of levels that still start new threads.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  link - Same as input, passed by reference.
+//                  memoryFail - Same as input, passed by reference.
+// CALLS TO:     buildBalanced
+//               createNode
+//               createArena
+//               buildParallel
+//               destroyArena
+//               freeNodes
+//               joinArena
+//               updateNode
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+void buildParallel(typename Tree::nodeType *&link, const typename Tree::keyType keys[], int first,
+                   int last, Tree *mainTree, int levels, bool& memoryFail)
+{
+     Tree leftTree;
+     thread leftBuilder;
+     bool leftFail = false;
+     int middle;
+     
+     if ((levels == 0) || (last - first < PARALLEL_MIN_KEYS))
+     {
+         buildBalanced(link, keys, first, last, mainTree, memoryFail);
+     } // end if subtree is built on this thread
+     else if (!memoryFail)
+     {
+         middle = first + (last - first) / 2;
+         link = createNode<typename Tree::nodeType>(keys[middle], mainTree->arena);
+         
+         if (link)
+         {
+             mainTree->count++;
+             
+             leftTree.count = 0;
+             leftTree.root = NULL;
+             leftTree.balanced = mainTree->balanced;
+             leftTree.arena = NULL;
+             if (mainTree->arena != NULL)
+             {
+                 leftTree.arena = createArena<typename Tree::nodeType>(mainTree->arena->hugePages);
+                 leftFail = (leftTree.arena == NULL);
+             }
+             
+             if (!leftFail)
+             {
+                 try
+                 {
+                     leftBuilder = thread(buildParallel<Tree>, ref(link->leftPtr), keys, first, middle - 1,
+                                          &leftTree, levels - 1, ref(leftFail));
+                 }
+                 catch (const system_error&)
+                 {
+                     leftFail = true;
+                 }
+                 catch (const bad_alloc&)
+                 {
+                     leftFail = true;
+                 }
+             } // end if left tree has its arena
+             buildParallel(link->rightPtr, keys, middle + 1, last, mainTree, levels - 1, memoryFail);
+             
+             if (leftBuilder.joinable())
+             {
+                 leftBuilder.join();
+             }
+             
+             // a left half without a thread or an arena, or that ran out of
+             // memory beside the others, is built again here on its own
+             if (leftFail && !memoryFail)
+             {
+                 if (leftTree.arena != NULL)
+                 {
+                     destroyArena(leftTree.arena);
+                     link->leftPtr = NULL;
+                 }
+                 else
+                 {
+                     freeNodes(link->leftPtr);
+                 }
+                 leftTree.count = 0;
+                 leftFail = false;
+                 buildBalanced(link->leftPtr, keys, first, middle - 1, mainTree, memoryFail);
+             } // end if left half is built on this thread
+             
+             mainTree->count += leftTree.count;
+             if (leftTree.arena != NULL)
+             {
+                 joinArena(mainTree->arena, leftTree.arena);
+             }
+             memoryFail = memoryFail || leftFail;
+             updateNode(link);
+         } // end if memory allocated for new node
+         else
+         {
+             memoryFail = true;
+         } // end memory not allocated
+     } // end if subtree is split between threads
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     saveSnapshot
+// DESCRIPTION:  Writes the BST to a binary snapshot file: a header, the keys in
+//               preorder, and the children each node has. Nodes are visited
+//               with an explicit stack so any tree shape can be written.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  fileName - The name of the snapshot file.
+// OUTPUT:
+//     Return Val:  written - Boolean value of whether the whole file was written.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+bool saveSnapshot(binarySearchTree *mainTree, const string& fileName)
+{
+     ofstream dataOut;
+     snapshotHeader header;
+     vector<treeNode *> pending;
+     vector<int> keys;
+     vector<unsigned char> shape;
+     treeNode *node;
+     unsigned int children;
+     size_t index = 0;
+     
+     keys.reserve(mainTree->count);
+     shape.assign((mainTree->count + 3) / 4, 0);
+     
+     if (mainTree->root != NULL)
+     {
+         pending.push_back(mainTree->root);
+     }
+     
+     while (!pending.empty())
+     {
+           node = pending.back();
+           pending.pop_back();
+           keys.push_back(node->number);
+           children = 0;
+           
+           if (node->rightPtr != NULL)
+           {
+               children |= SHAPE_RIGHT;
+               pending.push_back(node->rightPtr);
+           }
+           if (node->leftPtr != NULL)
+           {
+               children |= SHAPE_LEFT;
+               pending.push_back(node->leftPtr);
+           }
+           
+           shape[index / 4] |= children << (2 * (index % 4));
+           index++;
+     } // end while nodes remain to be written
+     
+     memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+     header.version = SNAPSHOT_VERSION;
+     header.flags = mainTree->balanced ? SNAPSHOT_BALANCED : 0;
+     header.reserved = 0;
+     header.count = keys.size();
+     
+     dataOut.open(fileName.c_str(), ios::binary | ios::trunc);
+     dataOut.write(reinterpret_cast<const char *>(&header), sizeof(header));
+     if (!keys.empty())
+     {
+         dataOut.write(reinterpret_cast<const char *>(&keys[0]), keys.size() * sizeof(int));
+         dataOut.write(reinterpret_cast<const char *>(&shape[0]), shape.size());
+     }
+     dataOut.close();
+     
+     return !dataOut.fail();
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     loadSnapshot
+// DESCRIPTION:  Rebuilds the BST from a binary snapshot file with the exact
+//               shape it was saved in, without comparing any keys. A snapshot
+//               of an unbalanced tree is rebalanced when the tree is balanced.
+// INPUT:
+//     Parameters:  fileName - The name of the snapshot file.
+//                  mainTree - A pointer to the empty BST structure.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+//                  memoryFail - Same as input, passed by reference.
+//     Return Val:  loaded - Boolean value of whether the snapshot was valid.
+// CALLS TO:     openMappedInput
+//               closeInput
+//               createNode
+//               recalculateNodes
+//               balanceTree
+//------------------------------------------------------------------------------
+
+bool loadSnapshot(const string& fileName, binarySearchTree *&mainTree, bool& memoryFail)
+{
+     integerScanner snapshot;
+     snapshotHeader header;
+     vector<treeNode **> pending;
+     const unsigned char *shape = NULL;
+     unsigned long long index,
+                        open = 1;
+     unsigned int children;
+     int number;
+     bool loaded = false;
+     
+     if (openMappedInput(fileName, snapshot) && (snapshot.size >= sizeof(header)))
+     {
+         memcpy(&header, snapshot.data, sizeof(header));
+         
+         // the count is bounded by the file before it is multiplied, so a
+         // corrupt count cannot wrap the size it is checked against
+         if ((memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) == 0)
+             && (header.version == SNAPSHOT_VERSION)
+             && (header.count <= (snapshot.size - sizeof(header)) / sizeof(int))
+             && (snapshot.size == sizeof(header) + header.count * sizeof(int) + (header.count + 3) / 4))
+         {
+             shape = reinterpret_cast<const unsigned char *>(snapshot.data + sizeof(header)
+                                                             + header.count * sizeof(int));
+             
+             // every node must fill exactly one link left open by its parent
+             for (index = 0; (index < header.count) && (open > 0); index++)
+             {
+                 children = (shape[index / 4] >> (2 * (index % 4))) & 3;
+                 open += ((children & SHAPE_LEFT) != 0) + ((children & SHAPE_RIGHT) != 0) - 1;
+             }
+             
+             loaded = (index == header.count) && (open == (header.count == 0 ? 1U : 0U));
+         } // end if header describes this file
+     } // end if snapshot file could be opened
+     
+     if (loaded)
+     {
+         pending.push_back(&mainTree->root);
+         
+         for (index = 0; (index < header.count) && !memoryFail; index++)
+         {
+             memcpy(&number, snapshot.data + sizeof(header) + index * sizeof(int), sizeof(int));
+             treeNode *&link = *pending.back();
+             pending.pop_back();
+             link = createNode(number, mainTree->arena);
+             
+             if (link)
+             {
+                 mainTree->count++;
+                 children = (shape[index / 4] >> (2 * (index % 4))) & 3;
+                 
+                 if (children & SHAPE_RIGHT)
+                 {
+                     pending.push_back(&link->rightPtr);
+                 }
+                 if (children & SHAPE_LEFT)
+                 {
+                     pending.push_back(&link->leftPtr);
+                 }
+             } // end if memory allocated for new node
+             else
+             {
+                 memoryFail = true;
+             } // end memory not allocated
+         } // end for each node in preorder
+         
+         if (!recalculateNodes(mainTree->root) && mainTree->balanced)
+         {
+             balanceTree(mainTree);
+         }
+     } // end if snapshot is valid
+     else
+     {
+         cout << "ERROR - " << fileName << " is not a valid snapshot file." << endl;
+     }
+     
+     if (snapshot.data != NULL)
+     {
+         closeInput(snapshot);
+     }
+     
+     return loaded;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     recalculateNodes
+// DESCRIPTION:  Sets the height and size of every node using a postorder
+//               traversal with an explicit stack, and checks whether the tree is
+//               AVL balanced.
+// INPUT:
+//     Parameters:  root - A pointer to the root of the tree.
+// OUTPUT:
+//     Return Val:  balanced - Boolean value of whether every node is balanced.
+// CALLS TO:     updateNode
+//               nodeHeight
+//------------------------------------------------------------------------------
+
+bool recalculateNodes(treeNode *root)
+{
+     vector<treeNode *> pending;
+     treeNode *node = root,
+              *lastDone = NULL;
+     int balance;
+     bool balanced = true;
+     
+     while ((node != NULL) || !pending.empty())
+     {
+           if (node != NULL)
+           {
+               pending.push_back(node);
+               node = node->leftPtr;
+           } // end if moving down the left side
+           else if ((pending.back()->rightPtr != NULL) && (pending.back()->rightPtr != lastDone))
+           {
+               node = pending.back()->rightPtr;
+           } // end if right subtree is not done yet
+           else
+           {
+               lastDone = pending.back();
+               pending.pop_back();
+               updateNode(lastDone);
+               balance = nodeHeight(lastDone->leftPtr) - nodeHeight(lastDone->rightPtr);
+               if ((balance > 1) || (balance < -1))
+               {
+                   balanced = false;
+               }
+           } // end if both subtrees are done
+     } // end while nodes remain
+     
+     return balanced;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     balanceTree
+// DESCRIPTION:  Rebalances a whole tree in place with the Day-Stout-Warren
+//               algorithm: the tree is rotated into a sorted vine, and the vine
+//               is then folded into a complete tree. No keys are compared and
+//               no memory is allocated.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+// OUTPUT:       N/A
+// CALLS TO:     compressVine
+//               recalculateNodes
+//------------------------------------------------------------------------------
+
+void balanceTree(binarySearchTree *mainTree)
+{
+     treeNode pseudoRoot,
+              *tail,
+              *rest,
+              *child;
+     int size = 0,
+         leaves = 1;
+     
+     pseudoRoot.leftPtr = NULL;
+     pseudoRoot.rightPtr = mainTree->root;
+     tail = &pseudoRoot;
+     rest = tail->rightPtr;
+     
+     // rotate every left child up until the tree is a vine of right children
+     while (rest != NULL)
+     {
+           if (rest->leftPtr == NULL)
+           {
+               tail = rest;
+               rest = rest->rightPtr;
+               size++;
+           }
+           else
+           {
+               child = rest->leftPtr;
+               rest->leftPtr = child->rightPtr;
+               child->rightPtr = rest;
+               rest = child;
+               tail->rightPtr = child;
+           }
+     } // end while vine is not finished
+     
+     while (leaves <= size + 1)
+     {
+           leaves *= 2;
+     }
+     leaves = size + 1 - leaves / 2;
+     
+     compressVine(&pseudoRoot, leaves);
+     size -= leaves;
+     
+     while (size > 1)
+     {
+           compressVine(&pseudoRoot, size / 2);
+           size /= 2;
+     }
+     
+     mainTree->root = pseudoRoot.rightPtr;
+     recalculateNodes(mainTree->root);
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     compressVine
+// DESCRIPTION:  Rotates every other node along the right vine to the left of
+//               the node after it.
+// INPUT:
+//     Parameters:  pseudoRoot - A node whose right child is the top of the vine.
+//                  rotations - The number of rotations to make.
+// OUTPUT:       N/A
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void compressVine(treeNode *pseudoRoot, int rotations)
+{
+     treeNode *scanner = pseudoRoot,
+              *child;
+     int index;
+     
+     for (index = 0; index < rotations; index++)
+     {
+         child = scanner->rightPtr;
+         scanner->rightPtr = child->rightPtr;
+         scanner = scanner->rightPtr;
+         child->rightPtr = scanner->leftPtr;
+         scanner->leftPtr = child;
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     createTree
+// DESCRIPTION:  Allocated memory for the main BST structure and initializes its
+//               variables.
+// INPUT:        N/A
+// OUTPUT:
+//     Return Val:  newTree - A pointer to main BST structure.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+
+template <typename Tree>
+Tree *createTree()
+{
+    Tree *newTree;
+    
+    newTree = new (nothrow) Tree;
+    
+    if (newTree)
+    {
+        newTree->count = 0;
+        newTree->root = NULL;
+        newTree->balanced = false;
+        newTree->arena = NULL;
+        newTree->frozen = NULL;
+        newTree->cache = NULL;
+#if defined(BST_STATS)
+        memset(&newTree->stats, 0, sizeof(newTree->stats));
+#endif
+    }
+    
+    return newTree;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     isEmptyTree
+// DESCRIPTION:  Tests the root pointer of BST structure to see if its NULL.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the BST structure.
+// OUTPUT:
+//     Return Val:  empty - Boolean value of whether the tree is empty or not
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+
+template <typename Tree>
+bool isEmptyTree(Tree *mainTree)
+{
+     bool empty;
+     
+     if (mainTree->root == NULL)
+     {
+         empty = true;
+     }
+     else
+     {
+         empty = false;
+     }
+     
+     return empty;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     createNode
+// DESCRIPTION:  Allocates memory for a node within the BST and initializes the
+//               variables in the nodes structure. Nodes are taken from the arena
+//               when one is given, otherwise from the heap. The value of a map
+//               node is default constructed for the caller to set.
+// INPUT:
+//     Paramaters:  num - The key that will be in the node.
+//                  arena - The node arena to allocate from, NULL for the heap.
+// OUTPUT:
+//     Return Val:  newNode - A pointer to the newly created node, NULL on failure.
+// CALLS TO:     growArena
+//------------------------------------------------------------------------------
+
+template <typename Node>
+Node *createNode(const typename Node::keyType& num, typename Node::arenaType *arena)
+{
+   Node *newNode = NULL;
+   
+   if (arena == NULL)
+   {
+       newNode = new (nothrow) Node;
+   } // end if node comes from the heap
+   else if (arena->freeList != NULL)
+   {
+       newNode = arena->freeList;
+       arena->freeList = newNode->leftPtr;
+   } // end if a deleted node can be reused
+   else if ((arena->nextNode != arena->slabEnd) || growArena(arena))
+   {
+       newNode = arena->nextNode;
+       arena->nextNode++;
+   } // end if the current slab has room
+   
+   if (newNode)
+   {
+       newNode->number = num;
+       newNode->leftPtr = NULL;
+       newNode->rightPtr = NULL;
+       newNode->height = 1;
+       newNode->size = 1;
+   }
+   
+   return newNode;      
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     createArena
+// DESCRIPTION:  Allocates an empty node arena. Slabs are added as nodes are
+//               needed. Nodes are never destroyed one by one, so only nodes
+//               without destructors can come from an arena.
+// INPUT:
+//     Parameters:  hugePages - Boolean value of whether slabs use huge pages.
+// OUTPUT:
+//     Return Val:  newArena - A pointer to the new arena, NULL on failure.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+template <typename Node>
+basicArena<Node> *createArena(bool hugePages)
+{
+    basicArena<Node> *newArena;
+    
+    static_assert(is_trivially_destructible<Node>::value,
+                  "arena nodes are released with their slab without being destroyed");
+    
+    newArena = new (nothrow) basicArena<Node>;
+    
+    if (newArena)
+    {
+        newArena->slabs = NULL;
+        newArena->freeList = NULL;
+        newArena->nextNode = NULL;
+        newArena->slabEnd = NULL;
+        newArena->hugePages = hugePages;
+    }
+    
+    return newArena;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     growArena
+// DESCRIPTION:  Adds a new slab to an arena and makes it the slab that nodes
+//               are handed out from.
+// INPUT:
+//     Parameters:  arena - A pointer to the node arena.
+// OUTPUT:
+//     Return Val:  grown - Boolean value of whether a slab could be allocated.
+// CALLS TO:     allocateSlab
+//------------------------------------------------------------------------------
+
+template <typename Node>
+bool growArena(basicArena<Node> *arena)
+{
+     arenaSlab *slab;
+     bool grown = false;
+     
+     slab = allocateSlab(arena->hugePages);
+     
+     if (slab)
+     {
+         slab->next = arena->slabs;
+         arena->slabs = slab;
+         arena->nextNode = reinterpret_cast<Node *>(slab + 1);
+         arena->slabEnd = arena->nextNode
+                          + (ARENA_SLAB_BYTES - sizeof(arenaSlab)) / sizeof(Node);
+         grown = true;
+     }
+     
+     return grown;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     allocateSlab
+// DESCRIPTION:  Allocates one slab of memory. When huge pages are asked for they
+//               are tried first, and ordinary pages are used if the system has
+//               none to give.
+// INPUT:
+//     Parameters:  hugePages - Boolean value of whether to try huge pages.
+// OUTPUT:
+//     Return Val:  slab - A pointer to the slab, NULL on failure.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+arenaSlab *allocateSlab(bool hugePages)
+{
+    void *memory = NULL;
+    arenaSlab *slab = NULL;
+    
+#if defined(_WIN32)
+    if (hugePages && (GetLargePageMinimum() != 0))
+    {
+        memory = VirtualAlloc(NULL, ARENA_SLAB_BYTES, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES,
+                              PAGE_READWRITE);
+    }
+    if (hugePages && (memory == NULL))
+    {
+        memory = VirtualAlloc(NULL, ARENA_SLAB_BYTES, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    }
+#elif defined(__unix__) || defined(__APPLE__)
+#if defined(MAP_HUGETLB)
+    if (hugePages)
+    {
+        memory = mmap(NULL, ARENA_SLAB_BYTES, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory == MAP_FAILED)
+        {
+            memory = NULL;
+        }
+    } // end if huge pages can be mapped directly
+#endif
+    if (hugePages && (memory == NULL))
+    {
+        memory = mmap(NULL, ARENA_SLAB_BYTES, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+        {
+            memory = NULL;
+        }
+#if defined(MADV_HUGEPAGE)
+        else
+        {
+            madvise(memory, ARENA_SLAB_BYTES, MADV_HUGEPAGE);
+        }
+#endif
+    } // end if huge pages must come from the kernel's transparent huge pages
+#endif
+    
+    if (memory != NULL)
+    {
+        slab = static_cast<arenaSlab *>(memory);
+        slab->mapped = true;
+    } // end if slab was mapped from the operating system
+    else
+    {
+        slab = reinterpret_cast<arenaSlab *>(new (nothrow) char[ARENA_SLAB_BYTES]);
+        if (slab)
+        {
+            slab->mapped = false;
+        }
+    } // end if slab comes from the heap
+    
+    return slab;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     releaseSlab
+// DESCRIPTION:  Returns the memory of one slab the way it was allocated.
+// INPUT:
+//     Parameters:  slab - A pointer to the slab.
+// OUTPUT:       N/A
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void releaseSlab(arenaSlab *slab)
+{
+     if (slab->mapped)
+     {
+#if defined(_WIN32)
+         VirtualFree(slab, 0, MEM_RELEASE);
+#elif defined(__unix__) || defined(__APPLE__)
+         munmap(slab, ARENA_SLAB_BYTES);
+#endif
+     } // end if slab was mapped from the operating system
+     else
+     {
+         delete [] reinterpret_cast<char *>(slab);
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     releaseNode
+// DESCRIPTION:  Puts a deleted node on the arena free list so the next
+//               createNode can reuse it, or deletes it when there is no arena.
+// INPUT:
+//     Parameters:  node - A pointer to the node being released.
+//                  arena - The node arena the node came from, NULL for the heap.
+// OUTPUT:       N/A
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+template <typename Node>
+void releaseNode(Node *node, typename Node::arenaType *arena)
+{
+     if (arena == NULL)
+     {
+         delete node;
+     }
+     else
+     {
+         node->leftPtr = arena->freeList;
+         arena->freeList = node;
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     joinArena
+// DESCRIPTION:  Moves the slabs and free nodes of one arena into another so the
+//               nodes of both are released together, then deallocates the
+//               emptied arena. Unused room at the end of its slab is not reused.
+// INPUT:
+//     Parameters:  target - The arena that takes over the slabs.
+//                  source - The arena to empty.
+// OUTPUT:
+//     Parameters:  source - Set to NULL, passed by reference.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+template <typename Node>
+void joinArena(basicArena<Node> *target, basicArena<Node> *&source)
+{
+     arenaSlab *lastSlab = source->slabs;
+     Node *lastFree = source->freeList;
+     
+     if (lastSlab != NULL)
+     {
+         while (lastSlab->next != NULL)
+         {
+               lastSlab = lastSlab->next;
+         }
+         lastSlab->next = target->slabs;
+         target->slabs = source->slabs;
+     } // end if source holds slabs
+     
+     if (lastFree != NULL)
+     {
+         while (lastFree->leftPtr != NULL)
+         {
+               lastFree = lastFree->leftPtr;
+         }
+         lastFree->leftPtr = target->freeList;
+         target->freeList = source->freeList;
+     } // end if source holds free nodes
+     
+     delete source;
+     source = NULL;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     destroyArena
+// DESCRIPTION:  Releases every slab of an arena, which deallocates all of the
+//               nodes created from it without visiting them.
+// INPUT:
+//     Parameters:  arena - A pointer to the node arena.
+// OUTPUT:
+//     Parameters:  arena - Same as input, passed by reference and set to NULL.
+// CALLS TO:     releaseSlab
+//------------------------------------------------------------------------------
+
+template <typename Node>
+void destroyArena(basicArena<Node> *&arena)
+{
+     arenaSlab *slab,
+               *nextSlab;
+     
+     slab = arena->slabs;
+     
+     while (slab != NULL)
+     {
+           nextSlab = slab->next;
+           releaseSlab(slab);
+           slab = nextSlab;
+     }
+     
+     delete arena;
+     arena = NULL;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     insertNode
+// DESCRIPTION:  Adds a node into the BST in ascending order, counting it in the
+//               size of every node passed. When the tree is balanced, the links
+//               walked are recorded and the AVL balance is restored on the way
+//               back up.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  newNode - A pointer to the new node being inserted.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+// CALLS TO:     forgetKey
+//               rebalancePath
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+void insertNode(Tree *&mainTree, typename Tree::nodeType *newNode)
+{
+     typename Tree::nodeType **link;
+     basicPath<typename Tree::nodeType> path;
+     
+     path.length = 0;
+     mainTree->count++;
+     link = &mainTree->root;
+     
+     if (mainTree->frozen != NULL)
+     {
+         mainTree->frozen->stale = true;
+     }
+     
+     // a cached search may have found the key missing
+     if (mainTree->cache != NULL)
+     {
+         forgetKey(mainTree->cache, newNode->number);
+     }
+     
+     // walk down to the empty link where the new node belongs
+     STATS_ADD(mainTree, searches[STATS_INSERT], 1);
+     while (*link != NULL)
+     {
+           STATS_ADD(mainTree, comparisons[STATS_INSERT], 1);
+           if (mainTree->balanced)
+           {
+               path.link[path.length++] = link;
+           }
+           
+           (*link)->size++;
+           
+           if (mainTree->compare(newNode->number, (*link)->number))
+           {
+               link = &(*link)->leftPtr;
+           } // end if new number is less than current node number
+           else
+           {
+               link = &(*link)->rightPtr;
+           } // end if new number is greater than current node number
+     } // end while link points to a node
+     
+     *link = newNode;
+     
+     if (mainTree->balanced)
+     {
+         rebalancePath(path);
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     fingerInsert
+// DESCRIPTION:  Adds a key starting from the last place the finger reached
+//               instead of the root. The finger climbs only until the key falls
+//               between the bounds of a subtree and walks down from there, so
+//               nearly sorted keys cost time in the distance from the previous
+//               key rather than the height of the tree. The same walk finds a
+//               key already in the tree, so no separate search is needed. Sizes
+//               of the nodes the finger keeps are brought up to date as it
+//               leaves them, or by finishFinger. An AVL tree is never as tall as
+//               FINGER_MAX_LEVELS; in a tree that is not balanced the finger
+//               drops its levels nearest the root when it reaches that many, and
+//               starts again from the root if the key is outside what is left.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  finger - The finger, empty before the first key.
+//                  num - The key to add.
+//                  found - Boolean value of whether the key was already in the tree.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  finger - Same as input, passed by reference.
+//                  found - Same as input, passed by reference.
+//                  memoryFail - Same as input, passed by reference.
+//     Return Val:  node - A pointer to the node holding the key, NULL if memory
+//                         allocation failed.
+// CALLS TO:     forgetKey
+//               settleLevel
+//               settleAbove
+//               sameKey
+//               dropLevels
+//               createNode
+//               rebalanceNode
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+typename Tree::nodeType *fingerInsert(Tree *mainTree, basicFinger<typename Tree::nodeType>& finger,
+                                      const typename Tree::keyType& num, bool& found, bool& memoryFail)
+{
+     typedef typename Tree::nodeType Node;
+     fingerLevel<Node> level,
+                       child;
+     Node *node = NULL,
+          *oldNode;
+     int index,
+         oldHeight;
+     bool changed = true;
+     
+     found = false;
+     
+     if (mainTree->frozen != NULL)
+     {
+         mainTree->frozen->stale = true;
+     }
+     
+     if (mainTree->cache != NULL)
+     {
+         forgetKey(mainTree->cache, num);
+     }
+     
+     // climb until the key is within the bounds of the subtree, the root has no
+     // bounds; leaving the first level kept pays what is owed to the nodes above
+     while (!finger.levels.empty()
+            && (((finger.levels.back().low != NULL) && !mainTree->compare(finger.levels.back().low->number, num))
+                || ((finger.levels.back().high != NULL) && !mainTree->compare(num, finger.levels.back().high->number))))
+     {
+           settleLevel(finger, static_cast<int>(finger.levels.size()) - 1);
+           
+           if (finger.levels.size() == 1)
+           {
+               settleAbove(mainTree, finger);
+           }
+           finger.levels.pop_back();
+     }
+     
+     if (finger.levels.empty() && (mainTree->root != NULL))
+     {
+         level.link = &mainTree->root;
+         level.low = NULL;
+         level.high = NULL;
+         level.pending = 0;
+         finger.levels.push_back(level);
+     } // end if finger starts at the root
+     
+     // walk down from there to the key or the empty link where it belongs
+     STATS_ADD(mainTree, searches[STATS_INSERT], 1);
+     if (!finger.levels.empty())
+     {
+         node = *finger.levels.back().link;
+     }
+     
+     while ((node != NULL) && !found)
+     {
+           STATS_ADD(mainTree, comparisons[STATS_INSERT], 1);
+           level = finger.levels.back();
+           
+           if (sameKey(mainTree->compare, num, node->number))
+           {
+               found = true;
+           } // end if key is already in the tree
+           else
+           {
+               if (mainTree->compare(num, node->number))
+               {
+                   child.link = &node->leftPtr;
+                   child.low = level.low;
+                   child.high = node;
+               } // end if key is less than current node key
+               else
+               {
+                   child.link = &node->rightPtr;
+                   child.low = node;
+                   child.high = level.high;
+               } // end if key is greater than current node key
+               child.pending = 0;
+               
+               node = *child.link;
+               if (node != NULL)
+               {
+                   if (!mainTree->balanced && (finger.levels.size() >= FINGER_MAX_LEVELS))
+                   {
+                       dropLevels(finger);
+                   }
+                   finger.levels.push_back(child);
+               } // end if walk goes on to a child
+           } // end if key is not at this node
+     } // end while link points to a node
+     
+     if (!found)
+     {
+         node = createNode<Node>(num, mainTree->arena);
+         
+         if (node)
+         {
+             mainTree->count++;
+             
+             if (finger.levels.empty())
+             {
+                 mainTree->root = node;
+                 child.link = &mainTree->root;
+                 child.low = NULL;
+                 child.high = NULL;
+                 child.pending = 0;
+             } // end if tree was empty
+             else
+             {
+                 *child.link = node;
+                 finger.levels.back().pending++;
+                 
+                 if (!mainTree->balanced && (finger.levels.size() >= FINGER_MAX_LEVELS))
+                 {
+                     dropLevels(finger);
+                 }
+             } // end if node is linked below the finger
+             finger.levels.push_back(child);
+             
+             // restore the AVL balance upward while heights change; a rotation
+             // moves the nodes below it, so the finger is cut back to its link
+             index = static_cast<int>(finger.levels.size()) - 2;
+             while (mainTree->balanced && (index >= 0) && changed)
+             {
+                   settleLevel(finger, index + 1);
+                   settleLevel(finger, index);
+                   oldNode = *finger.levels[index].link;
+                   oldHeight = oldNode->height;
+                   rebalanceNode(*finger.levels[index].link);
+                   changed = ((*finger.levels[index].link)->height != oldHeight);
+                   
+                   if (*finger.levels[index].link != oldNode)
+                   {
+                       finger.levels.resize(index + 1);
+                   }
+                   index--;
+             } // end while heights above may have changed
+         } // end if memory allocated for new node
+         else
+         {
+             memoryFail = true;
+         } // end memory not allocated
+     } // end if key is added
+     
+     return node;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     settleLevel
+// DESCRIPTION:  Adds the inserts counted at one level of a finger to the size of
+//               its node and passes them on to the level above, or to the count
+//               owed to the nodes above the finger from its first level.
+// INPUT:
+//     Parameters:  finger - The finger.
+//                  index - The level to settle.
+// OUTPUT:
+//     Parameters:  finger - Same as input, passed by reference.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+template <typename Node>
+void settleLevel(basicFinger<Node>& finger, int index)
+{
+     (*finger.levels[index].link)->size += finger.levels[index].pending;
+     
+     if (index > 0)
+     {
+         finger.levels[index - 1].pending += finger.levels[index].pending;
+     }
+     else
+     {
+         finger.above += finger.levels[index].pending;
+     }
+     finger.levels[index].pending = 0;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     dropLevels
+// DESCRIPTION:  Drops the half of a full finger nearest the root. Every level is
+//               settled first, then the dropped nodes are lowered by the count
+//               still owed above the finger, so that one count again covers
+//               every node above the first level kept.
+// INPUT:
+//     Parameters:  finger - The finger, holding FINGER_MAX_LEVELS levels.
+// OUTPUT:
+//     Parameters:  finger - Same as input, passed by reference.
+// CALLS TO:     settleLevel
+//------------------------------------------------------------------------------
+
+template <typename Node>
+void dropLevels(basicFinger<Node>& finger)
+{
+     int index,
+         dropped = static_cast<int>(FINGER_MAX_LEVELS / 2);
+     
+     for (index = static_cast<int>(finger.levels.size()) - 1; index >= 0; index--)
+     {
+         settleLevel(finger, index);
+     }
+     
+     for (index = 0; index < dropped; index++)
+     {
+         (*finger.levels[index].link)->size -= finger.above;
+     }
+     finger.levels.erase(finger.levels.begin(), finger.levels.begin() + dropped);
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     settleAbove
+// DESCRIPTION:  Adds the inserts owed to the nodes above the first level of a
+//               finger to each of them, walking down from the root. Nothing is
+//               owed while the first level is the root link.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the BST structure.
+//                  finger - The finger, not empty.
+// OUTPUT:
+//     Parameters:  finger - Same as input, passed by reference.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+void settleAbove(Tree *mainTree, basicFinger<typename Tree::nodeType>& finger)
+{
+     typename Tree::nodeType *first = *finger.levels.front().link,
+                             *node = mainTree->root;
+     
+     if (finger.above != 0)
+     {
+         while (node != first)
+         {
+               node->size += finger.above;
+               
+               if (mainTree->compare(first->number, node->number))
+               {
+                   node = node->leftPtr;
+               }
+               else
+               {
+                   node = node->rightPtr;
+               }
+         } // end while first level is below the node
+     } // end if inserts are owed above the finger
+     finger.above = 0;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     finishFinger
+// DESCRIPTION:  Brings the sizes of the nodes a finger kept, and of the nodes
+//               above the levels it dropped, up to date and empties it. Must be
+//               called before the tree is used any other way.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the BST structure.
+//                  finger - The finger.
+// OUTPUT:
+//     Parameters:  finger - Left empty, passed by reference.
+// CALLS TO:     settleLevel
+//               settleAbove
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+void finishFinger(Tree *mainTree, basicFinger<typename Tree::nodeType>& finger)
+{
+     int index;
+     
+     for (index = static_cast<int>(finger.levels.size()) - 1; index >= 0; index--)
+     {
+         settleLevel(finger, index);
+     }
+     
+     if (!finger.levels.empty())
+     {
+         settleAbove(mainTree, finger);
+     }
+     finger.levels.clear();
+     finger.above = 0;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     nodeHeight
+// DESCRIPTION:  Returns the height of a subtree, 0 for an empty subtree.
+// INPUT:
+//     Parameters:  node - A pointer to the root of the subtree.
+// OUTPUT:
+//     Return Val:  height - An integer of the subtree height.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+template <typename Node>
+int nodeHeight(Node *node)
+{
+    int height = 0;
+    
+    if (node != NULL)
+    {
+        height = node->height;
+    }
+    
+    return height;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     updateNode
+// DESCRIPTION:  Recalculates the height and size of a node from its children.
+// INPUT:
+//     Parameters:  node - A pointer to a node within the BST.
+// OUTPUT:       N/A
+// CALLS TO:     nodeHeight
+//               nodeSize
+//------------------------------------------------------------------------------
+
+template <typename Node>
+void updateNode(Node *node)
+{
+     int leftHeight = nodeHeight(node->leftPtr),
+         rightHeight = nodeHeight(node->rightPtr);
+     
+     if (leftHeight > rightHeight)
+     {
+         node->height = leftHeight + 1;
+     }
+     else
+     {
+         node->height = rightHeight + 1;
+     }
+     
+     node->size = nodeSize(node->leftPtr) + nodeSize(node->rightPtr) + 1;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     nodeSize
+// DESCRIPTION:  Returns the number of nodes in a subtree, 0 for an empty subtree.
+// INPUT:
+//     Parameters:  node - A pointer to the root of the subtree.
+// OUTPUT:
+//     Return Val:  size - An integer of the subtree size.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+template <typename Node>
+int nodeSize(Node *node)
+{
+    int size = 0;
+    
+    if (node != NULL)
+    {
+        size = node->size;
+    }
+    
+    return size;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     rotateLeft
+// DESCRIPTION:  Rotates a subtree to the left so its right child becomes the root.
+// INPUT:
+//     Parameters:  node - The link holding the root of the subtree.
+// OUTPUT:
+//     Parameters:  node - Same as input, passed by reference.
+// CALLS TO:     updateNode
+//------------------------------------------------------------------------------
+
+template <typename Node>
+void rotateLeft(Node *&node)
+{
+     Node *pivot = node->rightPtr;
+     
+     node->rightPtr = pivot->leftPtr;
+     pivot->leftPtr = node;
+     updateNode(node);
+     updateNode(pivot);
+     node = pivot;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     rotateRight
+// DESCRIPTION:  Rotates a subtree to the right so its left child becomes the root.
+// INPUT:
+//     Parameters:  node - The link holding the root of the subtree.
+// OUTPUT:
+//     Parameters:  node - Same as input, passed by reference.
+// CALLS TO:     updateNode
+//------------------------------------------------------------------------------
+
+template <typename Node>
+void rotateRight(Node *&node)
+{
+     Node *pivot = node->leftPtr;
+     
+     node->leftPtr = pivot->rightPtr;
+     pivot->rightPtr = node;
+     updateNode(node);
+     updateNode(pivot);
+     node = pivot;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     rebalanceNode
+// DESCRIPTION:  Updates the height of a subtree root and rotates it when the
+//               heights of its children differ by more than one.
+// INPUT:
+//     Parameters:  node - The link holding the root of the subtree.
+// OUTPUT:
+//     Parameters:  node - Same as input, passed by reference.
+// CALLS TO:     nodeHeight
+//               updateNode
+//               rotateLeft
+//               rotateRight
+//------------------------------------------------------------------------------
+
+template <typename Node>
+void rebalanceNode(Node *&node)
+{
+     int balance = nodeHeight(node->leftPtr) - nodeHeight(node->rightPtr);
+     
+     if (balance > 1)
+     {
+         if (nodeHeight(node->leftPtr->leftPtr) < nodeHeight(node->leftPtr->rightPtr))
+         {
+             rotateLeft(node->leftPtr);
+         } // end if left subtree is right heavy
+         rotateRight(node);
+     } // end if left side is too tall
+     else if (balance < -1)
+     {
+         if (nodeHeight(node->rightPtr->rightPtr) < nodeHeight(node->rightPtr->leftPtr))
+         {
+             rotateRight(node->rightPtr);
+         } // end if right subtree is left heavy
+         rotateLeft(node);
+     } // end if right side is too tall
+     else
+     {
+         updateNode(node);
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     rebalancePath
+// DESCRIPTION:  Rebalances the nodes along a recorded path from the bottom up,
+//               stopping once a subtree keeps its previous height.
+// INPUT:
+//     Parameters:  path - The links walked from the root.
+// OUTPUT:
+//     Parameters:  path - Same as input, passed by reference.
+// CALLS TO:     rebalanceNode
+//------------------------------------------------------------------------------
+
+template <typename Node>
+void rebalancePath(basicPath<Node>& path)
+{
+     int level = path.length - 1,
+         oldHeight;
+     bool changed = true;
+     
+     while ((level >= 0) && changed)
+     {
+           if (*path.link[level] != NULL)
+           {
+               oldHeight = (*path.link[level])->height;
+               rebalanceNode(*path.link[level]);
+               changed = ((*path.link[level])->height != oldHeight);
+           } // end if link still holds a node
+           level--;
+     } // end while heights above may have changed
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     sameKey
+// DESCRIPTION:  Tests whether two keys are equal, meaning neither is ordered
+//               before the other.
+// INPUT:
+//     Parameters:  compare - The key comparison of the tree.
+//                  first - The first key.
+//                  second - The second key.
+// OUTPUT:
+//     Return Val:  Boolean value of whether the keys are equal.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+template <typename Key, typename Compare>
+bool sameKey(const Compare& compare, const Key& first, const Key& second)
+{
+     return !compare(first, second) && !compare(second, first);
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     sameKey
+// DESCRIPTION:  Tests keys ordered by less for equality with ==. The compiler
+//               can then choose the next child of an int search with a
+//               conditional move, which two calls to less prevent.
+// INPUT:
+//     Parameters:  first - The first key.
+//                  second - The second key.
+// OUTPUT:
+//     Return Val:  Boolean value of whether the keys are equal.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+template <typename Key>
+bool sameKey(const less<Key>&, const Key& first, const Key& second)
+{
+     return first == second;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     copyEntry
+// DESCRIPTION:  Copies the key and value of one node into another, used when a
+//               node with two children takes the place of its predecessor.
+// INPUT:
+//     Parameters:  target - A pointer to the node being overwritten.
+//                  source - A pointer to the node being copied.
+// OUTPUT:       N/A
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+template <typename Key, typename Mapped>
+void copyEntry(basicNode<Key, Mapped> *target, const basicNode<Key, Mapped> *source)
+{
+     target->number = source->number;
+     target->value = source->value;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     copyEntry
+// DESCRIPTION:  Copies the key of one set node into another.
+// INPUT:
+//     Parameters:  target - A pointer to the node being overwritten.
+//                  source - A pointer to the node being copied.
+// OUTPUT:       N/A
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+template <typename Key>
+void copyEntry(basicNode<Key, noPayload> *target, const basicNode<Key, noPayload> *source)
+{
+     target->number = source->number;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     findNode
+// DESCRIPTION:  Traverses the BST until a target node is found, or all elements
+//               have been inspected. The hot key cache is checked first when the
+//               tree has one, then a current frozen index is searched instead
+//               of the tree when there is one. Results of walks are kept in the
+//               cache.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  num - The key that is the target value.
+//                  flag - Boolean value of whether the value was found or not.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference. 
+//                  flag - Same as input, passed by reference.
+//     Return Val:  testNode - A pointer to the node if found, NULL if not.
+// CALLS TO:     isEmptyTree
+//               cachedFind
+//               indexedFind
+//               sameKey
+//               storeCache
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+typename Tree::nodeType *findNode(Tree *&mainTree, const typename Tree::keyType& num, bool& flag)
+{
+    typename Tree::nodeType *testNode,
+                            *indexNode;
+    int depth = 0;
+    bool found = false;
+    
+    testNode = mainTree->root;
+    
+    if (isEmptyTree(mainTree))
+    {
+        found = false;
+    } // end if tree is empty
+    else if ((mainTree->cache != NULL) && cachedFind(mainTree, num, indexNode))
+    {
+        testNode = indexNode;
+        found = (testNode != NULL);
+    } // end if the key was searched for recently
+    else if (indexedFind(mainTree, num, indexNode))
+    {
+        testNode = indexNode;
+        found = (testNode != NULL);
+    } // end if an index answered the search
+    else
+    {
+        // the walk keeps its place and result in locals so they stay in registers
+        STATS_ADD(mainTree, searches[STATS_FIND], 1);
+        while ((testNode != NULL) && !found)
+        {
+              STATS_ADD(mainTree, comparisons[STATS_FIND], 1);
+              depth++;
+              if (sameKey(mainTree->compare, num, testNode->number))
+              {
+                  found = true;
+              } // end if target number is found
+              else if (mainTree->compare(num, testNode->number))
+              {
+                  testNode = testNode->leftPtr;
+              } // end if node number is greater than target number
+              else
+              {
+                  testNode = testNode->rightPtr;
+              } // end if node number is less than target number
+        } // end while pointer contains a value and is not the number searched for
+        
+        if (mainTree->cache != NULL)
+        {
+            storeCache(mainTree->cache, num, testNode, depth);
+        }
+    } // end if tree is not empty
+    
+    flag = found;
+    
+    return testNode;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     findBatch
+// DESCRIPTION:  Searches the BST for a batch of keys with up to
+//               FIND_BATCH_STREAMS searches in flight. The searches take turns
+//               moving one level down, and each fetches the node it will look
+//               at next before giving up its turn, so the memory waits of the
+//               searches overlap instead of following one another. Each search
+//               that ends starts the next key in its place.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  queries - The keys to search for.
+//                  count - The number of keys.
+// OUTPUT:
+//     Parameters:  results - The node holding each key, NULL if it is not in
+//                            the tree.
+//     Return Val:  foundCount - The number of keys in the tree.
+// CALLS TO:     sameKey
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+int findBatch(Tree *mainTree, const typename Tree::keyType queries[], int count,
+              typename Tree::nodeType *results[])
+{
+     findCursor<typename Tree::nodeType> cursors[FIND_BATCH_STREAMS];
+     typename Tree::nodeType *node;
+     int index,
+         active = 0,
+         next = 0,
+         slot = 0,
+         foundCount = 0;
+     bool done;
+     
+     for (index = 0; index < count; index++)
+     {
+         results[index] = NULL;
+     }
+     
+     STATS_ADD(mainTree, searches[STATS_FIND], count);
+     
+     // every search starts at the root, so nothing is in flight for an empty tree
+     while ((mainTree->root != NULL) && (active < FIND_BATCH_STREAMS) && (next < count))
+     {
+           cursors[active].query = next;
+           cursors[active].node = mainTree->root;
+           active++;
+           next++;
+     }
+     
+     while (active > 0)
+     {
+           node = cursors[slot].node;
+           index = cursors[slot].query;
+           done = false;
+           
+           STATS_ADD(mainTree, comparisons[STATS_FIND], 1);
+           if (sameKey(mainTree->compare, queries[index], node->number))
+           {
+               results[index] = node;
+               foundCount++;
+               done = true;
+           } // end if target key is found
+           else
+           {
+               if (mainTree->compare(queries[index], node->number))
+               {
+                   node = node->leftPtr;
+               }
+               else
+               {
+                   node = node->rightPtr;
+               }
+               
+               if (node != NULL)
+               {
+                   PREFETCH(node);
+                   cursors[slot].node = node;
+               }
+               else
+               {
+                   done = true;
+               }
+           } // end if search moves down a level
+           
+           if (done && (next < count))
+           {
+               cursors[slot].query = next;
+               cursors[slot].node = mainTree->root;
+               next++;
+               slot++;
+           } // end if the next key takes over the finished search
+           else if (done)
+           {
+               // the last search in flight moves into this slot and goes next
+               active--;
+               cursors[slot] = cursors[active];
+           }
+           else
+           {
+               slot++;
+           }
+           
+           if (slot >= active)
+           {
+               slot = 0;
+           }
+     } // end while searches are in flight
+     
+     return foundCount;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     createCache
+// DESCRIPTION:  Allocates an empty hot key cache of HOT_CACHE_ENTRIES entries.
+// INPUT:        N/A
+// OUTPUT:
+//     Return Val:  cache - A pointer to the new cache, NULL on failure.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+template <typename Node>
+basicCache<Node> *createCache()
+{
+     basicCache<Node> *cache;
+     int index;
+     
+     cache = new (nothrow) basicCache<Node>;
+     
+     if (cache)
+     {
+         cache->entries = new (nothrow) cacheEntry<Node>[HOT_CACHE_ENTRIES];
+         if (cache->entries)
+         {
+             for (index = 0; index < HOT_CACHE_ENTRIES; index++)
+             {
+                 cache->entries[index].generation = 0;
+             }
+             cache->generation = 1;
+             cache->lookups = 0;
+             cache->hits = 0;
+             cache->depth = 0;
+         }
+         else
+         {
+             delete cache;
+             cache = NULL;
+         }
+     } // end if memory allocated for the cache
+     
+     return cache;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     cacheSlot
+// DESCRIPTION:  Returns the cache entry a key is kept in. The key's hash is
+//               mixed so nearby keys land in entries far apart.
+// INPUT:
+//     Parameters:  cache - A pointer to the hot key cache.
+//                  num - The key.
+// OUTPUT:
+//     Return Val:  entry - A pointer to the entry for the key.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+template <typename Node>
+cacheEntry<Node> *cacheSlot(basicCache<Node> *cache, const typename Node::keyType& num)
+{
+     unsigned long long mixed;
+     
+     mixed = static_cast<unsigned long long>(hash<typename Node::keyType>()(num)) * 0x9E3779B97F4A7C15ULL;
+     
+     return cache->entries + (mixed >> (64 - HOT_CACHE_BITS));
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     cachedFind
+// DESCRIPTION:  Looks a key up in the hot key cache of a tree and counts the
+//               lookup, and the hit when the cache holds a current result.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  num - The key that is the target value.
+//                  node - The node holding the key, NULL when the key was not in the tree.
+// OUTPUT:
+//     Parameters:  node - Same as input, passed by reference, set on a hit.
+//     Return Val:  hit - Boolean value of whether the cache held the result.
+// CALLS TO:     cacheSlot
+//               sameKey
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+bool cachedFind(Tree *mainTree, const typename Tree::keyType& num, typename Tree::nodeType *&node)
+{
+     basicCache<typename Tree::nodeType> *cache = mainTree->cache;
+     cacheEntry<typename Tree::nodeType> *entry = cacheSlot(cache, num);
+     bool hit = false;
+     
+     cache->lookups++;
+     
+     if ((entry->generation == cache->generation) && sameKey(mainTree->compare, num, entry->key))
+     {
+         node = entry->node;
+         cache->hits++;
+         hit = true;
+     }
+     
+     return hit;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     storeCache
+// DESCRIPTION:  Keeps the result of a search in the hot key cache, replacing
+//               whatever key shared its entry, and adds the depth the search
+//               walked to the cache totals.
+// INPUT:
+//     Parameters:  cache - A pointer to the hot key cache.
+//                  num - The key searched for.
+//                  node - The node holding the key, NULL if it is not in the tree.
+//                  depth - The number of nodes the search looked at.
+// OUTPUT:
+//     Parameters:  cache - Same as input, passed by reference.
+// CALLS TO:     cacheSlot
+//------------------------------------------------------------------------------
+
+template <typename Node>
+void storeCache(basicCache<Node> *cache, const typename Node::keyType& num, Node *node, int depth)
+{
+     cacheEntry<Node> *entry = cacheSlot(cache, num);
+     
+     entry->key = num;
+     entry->node = node;
+     entry->generation = cache->generation;
+     cache->depth += depth;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     forgetKey
+// DESCRIPTION:  Drops whatever the hot key cache holds in the entry for a key,
+//               for a key that was just added, deleted or moved to another node.
+// INPUT:
+//     Parameters:  cache - A pointer to the hot key cache.
+//                  num - The key.
+// OUTPUT:
+//     Parameters:  cache - Same as input, passed by reference.
+// CALLS TO:     cacheSlot
+//------------------------------------------------------------------------------
+
+template <typename Node>
+void forgetKey(basicCache<Node> *cache, const typename Node::keyType& num)
+{
+     cacheSlot(cache, num)->generation = 0;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     clearCache
+// DESCRIPTION:  Drops every entry of the hot key cache at once by starting a
+//               new generation. The entries are only cleared when the
+//               generation number wraps around.
+// INPUT:
+//     Parameters:  cache - A pointer to the hot key cache.
+// OUTPUT:
+//     Parameters:  cache - Same as input, passed by reference.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+template <typename Node>
+void clearCache(basicCache<Node> *cache)
+{
+     int index;
+     
+     cache->generation++;
+     
+     if (cache->generation == 0)
+     {
+         for (index = 0; index < HOT_CACHE_ENTRIES; index++)
+         {
+             cache->entries[index].generation = 0;
+         }
+         cache->generation = 1;
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     destroyCache
+// DESCRIPTION:  Deallocates a hot key cache.
+// INPUT:
+//     Parameters:  cache - A pointer to the hot key cache, may be NULL.
+// OUTPUT:
+//     Parameters:  cache - Same as input, passed by reference.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+template <typename Node>
+void destroyCache(basicCache<Node> *&cache)
+{
+     if (cache != NULL)
+     {
+         delete [] cache->entries;
+         delete cache;
+         cache = NULL;
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     indexedFind
+// DESCRIPTION:  Trees other than the int set have no index, so their searches
+//               always walk the tree.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  num - The key that is the target value.
+//                  node - The node found, unchanged.
+// OUTPUT:
+//     Return Val:  searched - Always false.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+bool indexedFind(Tree *, const typename Tree::keyType&, typename Tree::nodeType *&)
+{
+     return false;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     indexedFind
+// DESCRIPTION:  Searches the frozen index of the int set when it is current. A
+//               stale index is rebuilt once enough lookups have gone to the
+//               tree since it changed.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  num - The integer that is the target value.
+//                  node - The node found.
+// OUTPUT:
+//     Parameters:  node - A pointer to the node if found, NULL if not.
+//     Return Val:  searched - Boolean value of whether the index was searched.
+// CALLS TO:     nodeSize
+//               freezeTree
+//               frozenFind
+//------------------------------------------------------------------------------
+
+bool indexedFind(binarySearchTree *mainTree, int num, treeNode *&node)
+{
+     bool searched = false;
+     
+     if (mainTree->frozen != NULL)
+     {
+         if (mainTree->frozen->stale)
+         {
+             mainTree->frozen->staleLookups++;
+             if (mainTree->frozen->staleLookups * FROZEN_REBUILD_DIVISOR >= nodeSize(mainTree->root))
+             {
+                 freezeTree(mainTree);
+             }
+         } // end if tree changed since the index was built
+         
+         if (!mainTree->frozen->stale)
+         {
+             node = frozenFind(mainTree->frozen, num);
+             searched = true;
+             STATS_ADD(mainTree, frozenSearches, 1);
+         } // end if frozen index is current
+     } // end if tree has a frozen index
+     
+     return searched;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     freezeTree
+// DESCRIPTION:  Builds the frozen index of the BST: its integers stored in one
+//               array in Eytzinger (breadth first) order, so the first four
+//               levels share a cache line and a search moves through the
+//               array without following pointers. The node of each integer is
+//               kept alongside so a search still returns the node. The wide
+//               node index for membership tests is built at the same time.
+//               When there is not the memory for it the index is left stale,
+//               so the tree is searched instead.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, with a current frozen index.
+//     Return Val:  built - Boolean value of whether memory was available.
+// CALLS TO:     nodeSize
+//               startIterator
+//               nextNode
+//               buildKary
+//------------------------------------------------------------------------------
+
+bool freezeTree(binarySearchTree *mainTree)
+{
+     frozenIndex *frozen = mainTree->frozen;
+     treeIterator iterator;
+     treeNode *node;
+     vector<int> sortedKeys;
+     size_t position,
+            offset;
+     int size = nodeSize(mainTree->root);
+     bool built = true;
+     
+     if (frozen == NULL)
+     {
+         frozen = new (nothrow) frozenIndex;
+         mainTree->frozen = frozen;
+         built = (frozen != NULL);
+     }
+     
+     if (built)
+     {
+         // the vectors of the index throw when they cannot grow
+         try
+         {
+             frozen->storage.resize(size + 1 + FROZEN_LINE_KEYS);
+             frozen->nodes.resize(size + 1);
+             
+             // start the array on a cache line so each line holds whole levels
+             offset = reinterpret_cast<uintptr_t>(&frozen->storage[0]) % (FROZEN_LINE_KEYS * sizeof(int));
+             offset = (offset == 0) ? 0 : FROZEN_LINE_KEYS - offset / sizeof(int);
+             frozen->keys = &frozen->storage[offset];
+             frozen->size = size;
+             
+             // visit the array positions in the same order as the integers
+             position = 1;
+             while (2 * position <= static_cast<size_t>(size))
+             {
+                   position *= 2;
+             }
+             
+             startIterator(iterator, mainTree->root);
+             for (node = nextNode(iterator); node != NULL; node = nextNode(iterator))
+             {
+                 frozen->keys[position] = node->number;
+                 frozen->nodes[position] = node;
+                 sortedKeys.push_back(node->number);
+             
+                 if (2 * position + 1 <= static_cast<size_t>(size))
+                 {
+                     position = 2 * position + 1;
+                     while (2 * position <= static_cast<size_t>(size))
+                     {
+                           position *= 2;
+                     }
+                 } // end if next position is in the right subtree
+                 else
+                 {
+                     while (position & 1)
+                     {
+                           position >>= 1;
+                     }
+                     position >>= 1;
+                 } // end if next position is an ancestor
+             } // end for each integer in ascending order
+             
+             buildKary(frozen->wide, sortedKeys);
+             frozen->stale = false;
+             frozen->staleLookups = 0;
+         }
+         catch (const bad_alloc&)
+         {
+             frozen->stale = true;
+             frozen->staleLookups = 0;
+             built = false;
+         }
+     } // end if memory allocated for the index
+     
+     return built;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     frozenFind
+// DESCRIPTION:  Searches a current frozen index. Each step picks the child from
+//               a comparison instead of a branch, and the line holding the
+//               position four levels down is fetched ahead of time.
+// INPUT:
+//     Parameters:  frozen - A pointer to the frozen index.
+//                  num - The integer that is the target value.
+// OUTPUT:
+//     Return Val:  found - A pointer to the node if found, NULL if not.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+treeNode *frozenFind(const frozenIndex *frozen, int num)
+{
+     const int *keys = frozen->keys;
+     size_t position = 1,
+            size = static_cast<size_t>(frozen->size);
+     treeNode *found = NULL;
+     
+     while (position <= size)
+     {
+           if (position * FROZEN_LINE_KEYS <= size)
+           {
+               PREFETCH(keys + position * FROZEN_LINE_KEYS);
+           }
+           position = 2 * position + (keys[position] < num);
+     }
+     
+     // the last step left of the path ended at the smallest integer not below num
+     while (position & 1)
+     {
+           position >>= 1;
+     }
+     position >>= 1;
+     
+     if ((position != 0) && (keys[position] == num))
+     {
+         found = frozen->nodes[position];
+     }
+     
+     return found;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     buildKary
+// DESCRIPTION:  Builds the wide node index from the sorted integers. Each block
+//               holds 16 sorted keys in one cache line and has 17 children, so
+//               a search reads one line per level and about a quarter as many
+//               levels as the binary tree has. Unused key slots hold the
+//               largest int.
+// INPUT:
+//     Parameters:  wide - The wide node index to fill.
+//                  keys - The integers in ascending order.
+// OUTPUT:
+//     Parameters:  wide - Same as input, passed by reference.
+// CALLS TO:     fillKary
+//               selectBlockRank
+//------------------------------------------------------------------------------
+
+void buildKary(karyIndex& wide, const vector<int>& keys)
+{
+     size_t offset,
+            next = 0;
+     
+     wide.size = static_cast<int>(keys.size());
+     wide.blockCount = (wide.size + KARY_WIDTH - 1) / KARY_WIDTH;
+     wide.largest = keys.empty() ? 0 : keys.back();
+     wide.storage.assign(static_cast<size_t>(wide.blockCount) * KARY_WIDTH + KARY_WIDTH, INT_MAX);
+     
+     offset = reinterpret_cast<uintptr_t>(&wide.storage[0]) % (KARY_WIDTH * sizeof(int));
+     offset = (offset == 0) ? 0 : KARY_WIDTH - offset / sizeof(int);
+     wide.blocks = &wide.storage[offset];
+     
+     fillKary(wide, 0, keys, next);
+     wide.blockRank = selectBlockRank();
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     fillKary
+// DESCRIPTION:  Places the next sorted integers in a block and its subtrees in
+//               ascending order: each child subtree before the key that follows
+//               it. The depth is the number of levels of the wide index.
+// INPUT:
+//     Parameters:  wide - The wide node index to fill.
+//                  block - The block to fill.
+//                  keys - The integers in ascending order.
+//                  next - Index of the next integer to place.
+// OUTPUT:
+//     Parameters:  wide - Same as input, passed by reference.
+//                  next - Same as input, moved past the integers placed.
+// CALLS TO:     fillKary
+//------------------------------------------------------------------------------
+
+void fillKary(karyIndex& wide, int block, const vector<int>& keys, size_t& next)
+{
+     int slot;
+     
+     if (block < wide.blockCount)
+     {
+         for (slot = 0; slot < KARY_WIDTH; slot++)
+         {
+             fillKary(wide, block * (KARY_WIDTH + 1) + slot + 1, keys, next);
+             if (next < keys.size())
+             {
+                 wide.blocks[block * KARY_WIDTH + slot] = keys[next++];
+             }
+         } // end for each key and the child before it
+         fillKary(wide, block * (KARY_WIDTH + 1) + KARY_WIDTH + 1, keys, next);
+     } // end if block is in the index
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     selectBlockRank
+// DESCRIPTION:  Picks the fastest block comparison the processor supports,
+//               checked when the program runs rather than when it is built.
+// INPUT:        N/A
+// OUTPUT:
+//     Return Val:  blockRank - The block comparison function to use.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+blockRankFunction selectBlockRank()
+{
+     blockRankFunction blockRank = scalarBlockRank;
+     
+#if defined(KARY_X86)
+     __builtin_cpu_init();
+     if (__builtin_cpu_supports("avx2"))
+     {
+         blockRank = avx2BlockRank;
+     }
+     else
+     {
+         blockRank = sse2BlockRank;
+     }
+#endif
+     
+     return blockRank;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     scalarBlockRank
+// DESCRIPTION:  Counts the keys of a block that are less than a value, one key
+//               at a time without branching.
+// INPUT:
+//     Parameters:  block - The 16 keys of a block.
+//                  num - The value to compare against.
+// OUTPUT:
+//     Return Val:  rank - The number of keys less than num.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+int scalarBlockRank(const int *block, int num)
+{
+    int rank = 0,
+        slot;
+    
+    for (slot = 0; slot < KARY_WIDTH; slot++)
+    {
+        rank += (block[slot] < num);
+    }
+    
+    return rank;
+}
+
+#if defined(KARY_X86)
+//------------------------------------------------------------------------------
+// FUNCTION:     sse2BlockRank
+// DESCRIPTION:  Counts the keys of a block that are less than a value, comparing
+//               4 keys per instruction.
+// INPUT:
+//     Parameters:  block - The 16 keys of a block, aligned to a cache line.
+//                  num - The value to compare against.
+// OUTPUT:
+//     Return Val:  rank - The number of keys less than num.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+__attribute__((target("sse2")))
+int sse2BlockRank(const int *block, int num)
+{
+    const __m128i *keys = reinterpret_cast<const __m128i *>(block);
+    __m128i target = _mm_set1_epi32(num),
+            lower;
+    
+    // each comparison gives -1 for a smaller key, so the sums count them
+    lower = _mm_add_epi32(_mm_add_epi32(_mm_cmpgt_epi32(target, _mm_load_si128(keys)),
+                                        _mm_cmpgt_epi32(target, _mm_load_si128(keys + 1))),
+                          _mm_add_epi32(_mm_cmpgt_epi32(target, _mm_load_si128(keys + 2)),
+                                        _mm_cmpgt_epi32(target, _mm_load_si128(keys + 3))));
+    lower = _mm_add_epi32(lower, _mm_shuffle_epi32(lower, _MM_SHUFFLE(1, 0, 3, 2)));
+    lower = _mm_add_epi32(lower, _mm_shuffle_epi32(lower, _MM_SHUFFLE(2, 3, 0, 1)));
+    
+    return -_mm_cvtsi128_si32(lower);
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     avx2BlockRank
+// DESCRIPTION:  Counts the keys of a block that are less than a value, comparing
+//               8 keys per instruction.
+// INPUT:
+//     Parameters:  block - The 16 keys of a block, aligned to a cache line.
+//                  num - The value to compare against.
+// OUTPUT:
+//     Return Val:  rank - The number of keys less than num.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+__attribute__((target("avx2,popcnt")))
+int avx2BlockRank(const int *block, int num)
+{
+    const __m256i *keys = reinterpret_cast<const __m256i *>(block);
+    __m256i target = _mm256_set1_epi32(num);
+    unsigned mask;
+    
+    mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(
+               _mm256_cmpgt_epi32(target, _mm256_load_si256(keys)))))
+         | (static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(
+               _mm256_cmpgt_epi32(target, _mm256_load_si256(keys + 1))))) << 8);
+    
+    return __builtin_popcount(mask);
+}
+#endif
+
+//------------------------------------------------------------------------------
+// FUNCTION:     karyContains
+// DESCRIPTION:  Tests whether an integer is in the wide node index. Each level
+//               ranks the value within one block and moves to the child after
+//               the smaller keys; the last key not below the value is kept.
+// INPUT:
+//     Parameters:  wide - The wide node index.
+//                  num - The integer that is the target value.
+// OUTPUT:
+//     Return Val:  found - Boolean value of whether the value was found.
+// CALLS TO:     blockRank
+//------------------------------------------------------------------------------
+
+bool karyContains(const karyIndex& wide, int num)
+{
+     int block = 0,
+         rank,
+         candidate = -1;
+     
+     while (block < wide.blockCount)
+     {
+           rank = wide.blockRank(wide.blocks + block * KARY_WIDTH, num);
+           if (rank < KARY_WIDTH)
+           {
+               candidate = block * KARY_WIDTH + rank;
+           }
+           block = block * (KARY_WIDTH + 1) + rank + 1;
+     }
+     
+     // unused slots hold the largest int, which only counts if it was stored
+     return (candidate >= 0) && (wide.blocks[candidate] == num)
+            && ((num != INT_MAX) || ((wide.size > 0) && (wide.largest == INT_MAX)));
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     containsBatch
+// DESCRIPTION:  Tests a batch of integers for membership. The wide node index is
+//               used while the frozen index is current, and a stale one is
+//               rebuilt by looking each value up with findNode. Without a frozen
+//               index the values are searched for together by findBatch.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  queries - The integers to test.
+//                  count - The number of integers to test.
+// OUTPUT:
+//     Parameters:  found - 1 for each integer in the tree, 0 for the others.
+//     Return Val:  foundCount - The number of integers in the tree.
+// CALLS TO:     karyContains
+//               findNode
+//               findBatch
+//------------------------------------------------------------------------------
+
+int containsBatch(binarySearchTree *mainTree, const int queries[], int count, char found[])
+{
+     vector<treeNode *> nodes;
+     int index,
+         foundCount = 0;
+     bool flag;
+     
+     if (mainTree->frozen == NULL)
+     {
+         nodes.resize(count);
+         foundCount = findBatch(mainTree, queries, count, &nodes[0]);
+         for (index = 0; index < count; index++)
+         {
+             found[index] = (nodes[index] != NULL);
+         }
+     } // end if the tree itself is searched
+     else
+     {
+         for (index = 0; index < count; index++)
+         {
+             if (!mainTree->frozen->stale)
+             {
+                 found[index] = karyContains(mainTree->frozen->wide, queries[index]);
+             }
+             else
+             {
+                 findNode(mainTree, queries[index], flag);
+                 found[index] = flag;
+             }
+             foundCount += found[index];
+         } // end for each integer tested
+     } // end if lookups use the frozen index
+     
+     return foundCount;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     membershipDisplay
+// DESCRIPTION:  Displays the tested integers that are in the tree, in the order
+//               they were given, 10 to a row.
+// INPUT:
+//     Parameters:  queries - The integers tested.
+//                  found - Whether each integer is in the tree.
+//                  currentColumn - An integer of the current column being output.
+//                  buffer - The display buffer the values are formatted into.
+//                  out - Output stream the values are written to.
+// OUTPUT:
+//     Parameters:  currentColumn - Same as input, passed by reference.
+//                  buffer - Same as input, passed by reference.
+// CALLS TO:     startDisplay
+//               formatDisplay
+//               flushDisplay
+//------------------------------------------------------------------------------
+
+void membershipDisplay(const vector<int>& queries, const vector<char>& found, int& currentColumn,
+                       displayBuffer& buffer, ostream& out)
+{
+     size_t index;
+     
+     startDisplay(buffer, out);
+     
+     for (index = 0; index < queries.size(); index++)
+     {
+         if (found[index])
+         {
+             formatDisplay(queries[index], currentColumn, buffer);
+         }
+     }
+     
+     flushDisplay(buffer);
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     displayMenu
+// DESCRIPTION:  Displays the actions available to the user and loops users input
+//               until a valid one is selected. The end of standard input selects
+//               exit.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the tree the commands act on.
+//                  choices - The commands the tree supports.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+//     Return Val:  menuChoice - A character of the users selected action.
+// CALLS TO:     isEmptyTree
+//               nodeCount
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+char displayMenu(Tree *&mainTree, const char choices[])
+{
+     size_t index;
+     char menuChoice;
+     
+     if (!isEmptyTree(mainTree))
+     {
+         cout << "\nThere are " << nodeCount(mainTree) << " integers in the binary search tree." << endl << endl;
+     }
+     else
+     {
+         cout << "\nBinary search tree is empty." << endl << endl;
+     }
+     
+     cout << "--------------------Menu Options--------------------" << endl;
+     for (index = 0; choices[index] != '\0'; index++)
+     {
+         cout << MENU_LINES[strchr(MENU_CHOICES, choices[index]) - MENU_CHOICES] << endl;
+     }
+     do
+     {
+          cout << "Enter a choice from the options above: ";
+          cin >> menuChoice;
+          if (!cin)
+          {
+              menuChoice = EXIT_CHAR;
+          } // end if standard input has ended
+          menuChoice = toupper(menuChoice);
+          if (strchr(choices, menuChoice) == NULL)
+          {
+              cout << "ERROR - Invalid character selection." << endl;
+          }
+     }while (strchr(choices, menuChoice) == NULL);
+     
+     return menuChoice;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     actionController
+// DESCRIPTION:  Makes calls to the functions selected by the user.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  catalog - The named trees, which the U command picks mainTree from.
+//                  treeAction - A character of what action will be taken.
+//                  commandIn - Stream the numbers and file names are read from.
+//                  out - Stream the results are written to.
+//                  interactive - Boolean value of whether a user is at the menu.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+//                  catalog - Same as input, passed by reference.
+//                  treeAction - Same as input, passed by reference.
+// CALLS TO:     showPrompt
+//               finishAction
+//               readNumber
+//               isEmptyTree
+//               displayTree
+//               addInteger
+//               reportAdd
+//               deleteInteger
+//               reportDelete
+//               displaySubtree
+//               containsBatch
+//               membershipDisplay
+//               insertBatch
+//               deleteBatch
+//               countLess
+//               selectNode
+//               countRange
+//               rangeDisplay
+//               appendLog
+//               saveSnapshot
+//               findTree
+//               addTree
+//               createNamedTree
+//               loadNamedTree
+//               freezeTree
+//               combineTrees
+//               combineParallel
+//               releaseTree
+//               displayStats
+//               recordLatency
+//------------------------------------------------------------------------------
+
+void actionController(binarySearchTree *&mainTree, treeCatalog& catalog, char& treeAction,
+                      istream& commandIn, ostream& out, bool interactive)
+{
+     treeNode *miscNode;
+     binarySearchTree *firstTree,
+                      *secondTree,
+                      *newTree;
+     string fileName,
+            treeName,
+            firstName,
+            secondName;
+     char operation,
+          status;
+     vector<int> queries;
+     vector<char> found;
+     int num,
+         low,
+         index,
+         initColumn = INIT_COLUMN;
+     bool flag;
+     STATS_TIMER(commandStart);
+     
+     switch(treeAction)
+     {
+         case 'S':
+              STATS_START(commandStart);
+              out << "\nValues stored in entire binary search tree are:" << endl;
+              if (!isEmptyTree(mainTree))
+              {
+                  displayTree(mainTree, catalog.display, out);
+                  out << endl << endl;
+              }
+              STATS_COMMAND(mainTree, 'S', commandStart);
+              break;
+              
+         case 'A':
+              if (!readNumber("Enter a number to add to the tree: ", true, commandIn, out, interactive, num))
+              {
+                  break;
+              }
+              STATS_START(commandStart);
+              status = addInteger(mainTree, num);
+              if (status == BATCH_INSERTED)
+              {
+                  appendLog(catalog.log, mainTree, LOG_INSERT, num);
+              }
+              else if (status == BATCH_FAILED)
+              {
+                  treeAction = EXIT_CHAR;
+              } // end memory not allocated
+              reportAdd(out, num, status);
+              STATS_COMMAND(mainTree, 'A', commandStart);
+              finishAction(interactive);
+              break;
+              
+         case 'D':
+              if (!readNumber("Enter a number to delete from the tree: ", false, commandIn, out, interactive, num))
+              {
+                  break;
+              }
+              STATS_START(commandStart);
+              flag = deleteInteger(mainTree, num);
+              if (flag)
+              {
+                  appendLog(catalog.log, mainTree, LOG_DELETE, num);
+              }
+              reportDelete(out, num, flag);
+              STATS_COMMAND(mainTree, 'D', commandStart);
+              finishAction(interactive);
+              break;
+              
+         case 'F':
+              if (!readNumber("Enter a number to find: ", false, commandIn, out, interactive, num))
+              {
+                  break;
+              }
+              STATS_START(commandStart);
+              displaySubtree(mainTree, num, catalog.display, out);
+              STATS_COMMAND(mainTree, 'F', commandStart);
+              finishAction(interactive);
+              break;
+              
+         case 'M':
+              showPrompt("Enter how many numbers to test, then the numbers: ", interactive);
+              commandIn >> num;
+              if (!commandIn || (num < 0))
+              {
+                  break;
+              }
+              queries.resize(num);
+              for (low = 0; (low < num) && commandIn; low++)
+              {
+                  commandIn >> queries[low];
+              }
+              if (!commandIn)
+              {
+                  break;
+              }
+              STATS_START(commandStart);
+              found.resize(num);
+              low = (num > 0) ? containsBatch(mainTree, &queries[0], num, &found[0]) : 0;
+              out << low << " of " << num << " integers exist in the binary search tree:" << endl;
+              membershipDisplay(queries, found, initColumn, catalog.display, out);
+              out << endl;
+              initColumn = INIT_COLUMN;
+              STATS_COMMAND(mainTree, 'M', commandStart);
+              finishAction(interactive);
+              break;
+              
+         case 'I':
+         case 'X':
+              if (treeAction == 'I')
+              {
+                  showPrompt("Enter how many numbers to add, then the numbers: ", interactive);
+              }
+              else
+              {
+                  showPrompt("Enter how many numbers to delete, then the numbers: ", interactive);
+              }
+              commandIn >> num;
+              if (!commandIn || (num < 0))
+              {
+                  break;
+              }
+              queries.resize(num);
+              for (low = 0; (low < num) && commandIn; low++)
+              {
+                  commandIn >> queries[low];
+              }
+              if (!commandIn)
+              {
+                  break;
+              }
+              STATS_START(commandStart);
+              if (treeAction == 'I')
+              {
+                  for (low = 0; low < num; low++)
+                  {
+                      if (queries[low] <= 0)
+                      {
+                          out << "ERROR - " << queries[low] << " is not a positive integer and cannot be added." << endl;
+                      }
+                  }
+                  queries.erase(remove_if(queries.begin(), queries.end(),
+                                          [](int value) { return value <= 0; }),
+                                queries.end());
+                  num = static_cast<int>(queries.size());
+                  found.resize(num);
+                  flag = false;
+                  low = (num > 0) ? insertBatch(mainTree, &queries[0], num, &found[0], flag) : 0;
+                  for (index = 0; index < num; index++)
+                  {
+                      if (found[index] == BATCH_INSERTED)
+                      {
+                          appendLog(catalog.log, mainTree, LOG_INSERT, queries[index]);
+                      }
+                  }
+                  out << low << " of " << num << " integers added to tree." << endl;
+                  if (flag)
+                  {
+                      out << "ERROR - A memory allocation failure has occurred." << endl;
+                      treeAction = EXIT_CHAR;
+                  } // end memory not allocated
+                  out << "Integers already in the tree:" << endl;
+                  replace(found.begin(), found.end(), BATCH_INSERTED, '\0');
+                  replace(found.begin(), found.end(), BATCH_FAILED, '\0');
+              } // end if integers are added
+              else
+              {
+                  found.resize(num);
+                  low = (num > 0) ? deleteBatch(mainTree, &queries[0], num, &found[0]) : 0;
+                  for (index = 0; index < num; index++)
+                  {
+                      if (found[index] == BATCH_DELETED)
+                      {
+                          appendLog(catalog.log, mainTree, LOG_DELETE, queries[index]);
+                      }
+                  }
+                  out << low << " of " << num << " integers deleted from tree." << endl;
+                  out << "Integers not in the tree:" << endl;
+                  replace(found.begin(), found.end(), BATCH_DELETED, '\0');
+              } // end if integers are deleted
+              membershipDisplay(queries, found, initColumn, catalog.display, out);
+              out << endl;
+              initColumn = INIT_COLUMN;
+              STATS_COMMAND(mainTree, (treeAction == 'X') ? 'X' : 'I', commandStart);
+              finishAction(interactive);
+              break;
+              
+         case 'R':
+              showPrompt("Enter a number to rank: ", interactive);
+              commandIn >> num;
+              if (!commandIn)
+              {
+                  break;
+              }
+              STATS_START(commandStart);
+              out << "There are " << countLess(mainTree, num, false) << " integers less than "
+                  << num << " in the binary search tree." << endl;
+              STATS_COMMAND(mainTree, 'R', commandStart);
+              finishAction(interactive);
+              break;
+              
+         case 'K':
+              showPrompt("Enter a position in ascending order: ", interactive);
+              commandIn >> num;
+              if (!commandIn)
+              {
+                  break;
+              }
+              STATS_START(commandStart);
+              miscNode = selectNode(mainTree, num);
+              if (miscNode != NULL)
+              {
+                  out << "Integer number " << num << " in ascending order is " << miscNode->number << "." << endl;
+              }
+              else
+              {
+                  out << "There is no integer number " << num << " in the binary search tree." << endl;
+              }
+              STATS_COMMAND(mainTree, 'K', commandStart);
+              finishAction(interactive);
+              break;
+              
+         case 'C':
+         case 'L':
+              showPrompt("Enter the lowest and highest numbers of the range: ", interactive);
+              commandIn >> low >> num;
+              if (!commandIn)
+              {
+                  break;
+              }
+              STATS_START(commandStart);
+              if (treeAction == 'C')
+              {
+                  out << "There are " << countRange(mainTree, low, num) << " integers from "
+                      << low << " to " << num << " in the binary search tree." << endl;
+              } // end if range is counted
+              else
+              {
+                  out << "Values stored from " << low << " to " << num << " are:" << endl;
+                  rangeDisplay(mainTree, low, num, initColumn, catalog.display, out);
+                  out << endl;
+                  initColumn = INIT_COLUMN;
+              } // end if range is listed
+              STATS_COMMAND(mainTree, treeAction, commandStart);
+              finishAction(interactive);
+              break;
+              
+         case 'W':
+              showPrompt("Enter a file name for the snapshot: ", interactive);
+              commandIn >> fileName;
+              if (!commandIn)
+              {
+                  break;
+              }
+              STATS_START(commandStart);
+              if (saveSnapshot(mainTree, fileName))
+              {
+                  out << "Snapshot of " << nodeCount(mainTree) << " integers written to " << fileName << "." << endl;
+              }
+              else
+              {
+                  out << "ERROR - Snapshot could not be written to " << fileName << "." << endl;
+              }
+              STATS_COMMAND(mainTree, 'W', commandStart);
+              finishAction(interactive);
+              break;
+              
+         case 'N':
+              showPrompt("Enter a name for the new tree and the file to load it from: ", interactive);
+              commandIn >> treeName >> fileName;
+              if (!commandIn)
+              {
+                  break;
+              }
+              STATS_START(commandStart);
+              if (findTree(catalog, treeName) != NULL)
+              {
+                  out << "ERROR - A tree named " << treeName << " already exists." << endl;
+              }
+              else
+              {
+                  // notices for repeated values go to cout, so earlier results are written first
+                  out.flush();
+                  flag = false;
+                  newTree = createNamedTree(catalog);
+                  if (newTree && !loadNamedTree(catalog, fileName, newTree, flag))
+                  {
+                      out << "ERROR - File " << fileName << " does not exist." << endl;
+                      releaseTree(newTree);
+                  } // end if file could not be read
+                  else if (newTree && !flag && (!catalog.frozenLookups || freezeTree(newTree)))
+                  {
+                      addTree(catalog, treeName, newTree);
+                      out << nodeCount(newTree) << " integers loaded into tree " << treeName << "." << endl;
+                  } // end if tree was built
+                  else
+                  {
+                      if (newTree)
+                      {
+                          releaseTree(newTree);
+                      }
+                      out << "ERROR - A memory allocation failure has occurred." << endl;
+                      treeAction = EXIT_CHAR;
+                  } // end memory not allocated
+              } // end if name is not in use
+              STATS_COMMAND(mainTree, 'N', commandStart);
+              finishAction(interactive);
+              break;
+              
+         case 'O':
+              showPrompt("Enter U (union), I (intersection) or D (first less second), two tree names\n"
+                         "and a name for the result: ", interactive);
+              commandIn >> operation >> firstName >> secondName >> treeName;
+              if (!commandIn)
+              {
+                  break;
+              }
+              STATS_START(commandStart);
+              operation = toupper(operation);
+              firstTree = findTree(catalog, firstName);
+              secondTree = findTree(catalog, secondName);
+              if ((operation != SET_UNION) && (operation != SET_INTERSECTION) && (operation != SET_DIFFERENCE))
+              {
+                  out << "ERROR - " << operation << " is not a set operation, use U, I or D." << endl;
+              }
+              else if ((firstTree == NULL) || (secondTree == NULL))
+              {
+                  out << "ERROR - There is no tree named " << ((firstTree == NULL) ? firstName : secondName)
+                      << "." << endl;
+              }
+              else if (findTree(catalog, treeName) != NULL)
+              {
+                  out << "ERROR - A tree named " << treeName << " already exists." << endl;
+              }
+              else
+              {
+                  flag = false;
+                  newTree = createNamedTree(catalog);
+                  if (newTree && (catalog.threads > 1)
+                      && (nodeCount(firstTree) + nodeCount(secondTree) >= PARALLEL_MIN_KEYS))
+                  {
+                      combineParallel(firstTree, secondTree, operation, newTree, catalog.threads, flag);
+                  } // end if large trees are merged and built on several threads
+                  else if (newTree)
+                  {
+                      combineTrees(firstTree, secondTree, operation, newTree, flag);
+                  }
+                  
+                  if (newTree && !flag && (!catalog.frozenLookups || freezeTree(newTree)))
+                  {
+                      addTree(catalog, treeName, newTree);
+                      out << "Tree " << treeName << " holds the " << nodeCount(newTree) << " integers of the "
+                          << ((operation == SET_UNION) ? "union" :
+                              (operation == SET_INTERSECTION) ? "intersection" : "difference")
+                          << " of " << firstName << " and " << secondName << "." << endl;
+                  } // end if tree was built
+                  else
+                  {
+                      if (newTree)
+                      {
+                          releaseTree(newTree);
+                      }
+                      out << "ERROR - A memory allocation failure has occurred." << endl;
+                      treeAction = EXIT_CHAR;
+                  } // end memory not allocated
+              } // end if operation and trees are valid
+              STATS_COMMAND(mainTree, 'O', commandStart);
+              finishAction(interactive);
+              break;
+              
+         case 'U':
+              showPrompt("Enter the name of the tree to use: ", interactive);
+              commandIn >> treeName;
+              if (!commandIn)
+              {
+                  break;
+              }
+              newTree = findTree(catalog, treeName);
+              if (newTree != NULL)
+              {
+                  mainTree = newTree;
+                  out << "Using tree " << treeName << " with " << nodeCount(mainTree) << " integers." << endl;
+              }
+              else
+              {
+                  out << "ERROR - There is no tree named " << treeName << "." << endl;
+              }
+              finishAction(interactive);
+              break;
+              
+         case 'T':
+              displayStats(mainTree, out);
+              finishAction(interactive);
+              break;
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     actionController
+// DESCRIPTION:  Makes calls to the functions selected by the user on a tree
+//               that supports only the S, A, D, F and E commands.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the tree the commands act on.
+//                  display - The display buffer for S and F.
+//                  treeAction - A character of what action will be taken.
+//                  commandIn - Stream the numbers are read from.
+//                  out - Stream the results are written to.
+//                  interactive - Boolean value of whether a user is at the menu.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+//                  display - Same as input, passed by reference.
+//                  treeAction - Same as input, passed by reference.
+// CALLS TO:     readNumber
+//               finishAction
+//               isEmptyTree
+//               displayTree
+//               addInteger
+//               reportAdd
+//               deleteInteger
+//               reportDelete
+//               displaySubtree
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+void actionController(Tree *&mainTree, displayBuffer& display, char& treeAction, istream& commandIn,
+                      ostream& out, bool interactive)
+{
+     char status;
+     int num;
+     
+     switch(treeAction)
+     {
+         case 'S':
+              out << "\nValues stored in entire binary search tree are:" << endl;
+              if (!isEmptyTree(mainTree))
+              {
+                  displayTree(mainTree, display, out);
+                  out << endl << endl;
+              }
+              break;
+              
+         case 'A':
+              if (!readNumber("Enter a number to add to the tree: ", true, commandIn, out, interactive, num))
+              {
+                  break;
+              }
+              status = addInteger(mainTree, num);
+              if (status == BATCH_FAILED)
+              {
+                  treeAction = EXIT_CHAR;
+              } // end memory not allocated
+              reportAdd(out, num, status);
+              finishAction(interactive);
+              break;
+              
+         case 'D':
+              if (!readNumber("Enter a number to delete from the tree: ", false, commandIn, out, interactive, num))
+              {
+                  break;
+              }
+              reportDelete(out, num, deleteInteger(mainTree, num));
+              finishAction(interactive);
+              break;
+              
+         case 'F':
+              if (!readNumber("Enter a number to find: ", false, commandIn, out, interactive, num))
+              {
+                  break;
+              }
+              displaySubtree(mainTree, num, display, out);
+              finishAction(interactive);
+              break;
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     readNumber
+// DESCRIPTION:  Prompts for and reads the number of an add, delete or find. The
+//               menu asks again for a number that cannot be added; a batch
+//               reports it and goes on to the next command.
+// INPUT:
+//     Parameters:  prompt - The text of the prompt.
+//                  adding - Boolean value of whether the number is to be added.
+//                  commandIn - Stream the number is read from.
+//                  out - Stream errors are written to.
+//                  interactive - Boolean value of whether a user is at the menu.
+//                  num - The number read.
+// OUTPUT:
+//     Parameters:  commandIn - Same as input, passed by reference.
+//                  num - Same as input, passed by reference.
+//     Return Val:  valid - Boolean value of whether a usable number was read.
+// CALLS TO:     showPrompt
+//               reportAdd
+//------------------------------------------------------------------------------
+
+bool readNumber(const char prompt[], bool adding, istream& commandIn, ostream& out, bool interactive, int& num)
+{
+     bool valid;
+     
+     do
+     {
+         showPrompt(prompt, interactive);
+         commandIn >> num;
+         if (adding && !interactive && commandIn && (num <= 0))
+         {
+             reportAdd(out, num, BATCH_FAILED);
+         }
+     }while (adding && interactive && commandIn && (num <= 0));
+     
+     valid = (commandIn && (!adding || (num > 0)));
+     
+     return valid;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     reportAdd
+// DESCRIPTION:  Writes the result of adding a number to the tree.
+// INPUT:
+//     Parameters:  out - Stream the result is written to.
+//                  num - The number.
+//                  status - BATCH_INSERTED, BATCH_DUPLICATE or BATCH_FAILED.
+// OUTPUT:       N/A
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void reportAdd(ostream& out, int num, char status)
+{
+     if (num <= 0)
+     {
+         out << "ERROR - " << num << " is not a positive integer and cannot be added." << endl;
+     }
+     else if (status == BATCH_INSERTED)
+     {
+         out << num << " added to tree." << endl;
+     }
+     else if (status == BATCH_DUPLICATE)
+     {
+         out << "Number already exists in tree and cannot be added." << endl;
+     }
+     else
+     {
+         out << "ERROR - A memory allocation failure has occurred." << endl;
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     reportDelete
+// DESCRIPTION:  Writes the result of deleting a number from the tree.
+// INPUT:
+//     Parameters:  out - Stream the result is written to.
+//                  num - The number.
+//                  deleted - Boolean value of whether the number was in the tree.
+// OUTPUT:       N/A
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void reportDelete(ostream& out, int num, bool deleted)
+{
+     if (deleted)
+     {
+         out << num << " deleted from tree." << endl;
+     }
+     else
+     {
+         out << num << " does not exist in the binary search tree." << endl;
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     reportFind
+// DESCRIPTION:  Writes the heading of a found subtree, or that the number is
+//               not in the tree.
+// INPUT:
+//     Parameters:  out - Stream the result is written to.
+//                  num - The number.
+//                  found - Boolean value of whether the number is in the tree.
+// OUTPUT:       N/A
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void reportFind(ostream& out, int num, bool found)
+{
+     if (found)
+     {
+         out << "Values stored subtree with root " << num << " are:" << endl;
+     }
+     else
+     {
+         out << num << " doen not exist in the binary search tree." << endl;
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     addInteger
+// DESCRIPTION:  Adds a number to the BST unless it is already there.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  num - The number to add.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+//     Return Val:  status - BATCH_INSERTED, BATCH_DUPLICATE or BATCH_FAILED when
+//                           memory allocation failed.
+// CALLS TO:     findNode
+//               createNode
+//               insertNode
+//------------------------------------------------------------------------------
+
+char addInteger(binarySearchTree *mainTree, int num)
+{
+     treeNode *newNode;
+     char status = BATCH_DUPLICATE;
+     bool flag;
+     
+     findNode(mainTree, num, flag);
+     if (!flag)
+     {
+         newNode = createNode(num, mainTree->arena);
+         if (newNode)
+         {
+             insertNode(mainTree, newNode);
+             status = BATCH_INSERTED;
+         } // end if memory allocated for new node
+         else
+         {
+             status = BATCH_FAILED;
+         } // end memory not allocated
+     }
+     
+     return status;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     deleteInteger
+// DESCRIPTION:  Deletes a number from the BST if it is there.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  num - The number to delete.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+//     Return Val:  deleted - Boolean value of whether the number was in the tree.
+// CALLS TO:     findNode
+//               deleteNode
+//------------------------------------------------------------------------------
+
+bool deleteInteger(binarySearchTree *mainTree, int num)
+{
+     treeNode *miscNode;
+     bool flag;
+     
+     miscNode = findNode(mainTree, num, flag);
+     if (miscNode != NULL)
+     {
+         deleteNode(mainTree, miscNode->number);
+         mainTree->count--;
+     }
+     
+     return (miscNode != NULL);
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     displayTree
+// DESCRIPTION:  Displays every integer of the BST in ascending order.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  buffer - The display buffer the numbers are formatted into.
+//                  out - Stream the numbers are written to.
+// OUTPUT:
+//     Parameters:  buffer - Same as input, passed by reference.
+// CALLS TO:     inOrderDisplay
+//------------------------------------------------------------------------------
+
+void displayTree(binarySearchTree *mainTree, displayBuffer& buffer, ostream& out)
+{
+     int initColumn = INIT_COLUMN;
+     
+     inOrderDisplay(mainTree->root, initColumn, buffer, out);
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     displaySubtree
+// DESCRIPTION:  Finds a number in the BST and displays the subtree below it.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  num - The number to find.
+//                  buffer - The display buffer the numbers are formatted into.
+//                  out - Stream the results are written to.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+//                  buffer - Same as input, passed by reference.
+//     Return Val:  found - Boolean value of whether the number is in the tree.
+// CALLS TO:     findNode
+//               reportFind
+//               inOrderDisplay
+//------------------------------------------------------------------------------
+
+bool displaySubtree(binarySearchTree *mainTree, int num, displayBuffer& buffer, ostream& out)
+{
+     treeNode *miscNode;
+     int initColumn = INIT_COLUMN;
+     bool flag;
+     
+     miscNode = findNode(mainTree, num, flag);
+     reportFind(out, num, miscNode != NULL);
+     if (miscNode != NULL)
+     {
+         inOrderDisplay(miscNode, initColumn, buffer, out);
+         out << endl;
+     }
+     
+     return (miscNode != NULL);
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     showPrompt
+// DESCRIPTION:  Displays a prompt for the user, batch commands get no prompts.
+// INPUT:
+//     Parameters:  prompt - The text of the prompt.
+//                  interactive - Boolean value of whether a user is at the menu.
+// OUTPUT:       N/A
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void showPrompt(const char prompt[], bool interactive)
+{
+     if (interactive)
+     {
+         cout << prompt;
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     finishAction
+// DESCRIPTION:  Waits for the user and clears the screen after an action, batch
+//               commands run straight on to the next one.
+// INPUT:
+//     Parameters:  interactive - Boolean value of whether a user is at the menu.
+// OUTPUT:       N/A
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void finishAction(bool interactive)
+{
+     if (interactive)
+     {
+         system("pause");
+         system("cls");
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     runBatch
+// DESCRIPTION:  Runs a stream of menu commands back to back, each followed by
+//               its number or file name, until E or the end of the stream.
+//               Results go to the output stream with no prompts or pauses.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the tree the commands act on.
+//                  context - The named trees of the main tree, or the display
+//                            buffer of a tree with only S, A, D, F and E.
+//                  choices - The commands the tree supports.
+//                  commandIn - Stream of commands to run.
+//                  out - Stream the results are written to.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+//                  context - Same as input, passed by reference.
+//     Return Val:  treeAction - The last command, 'E' when the batch finished.
+// CALLS TO:     actionController
+//------------------------------------------------------------------------------
+
+template <typename Tree, typename Context>
+char runBatch(Tree *&mainTree, Context& context, const char choices[], istream& commandIn, ostream& out)
+{
+     char treeAction = ' ';
+     
+     commandIn >> treeAction;
+     
+     while (commandIn && (toupper(treeAction) != EXIT_CHAR))
+     {
+           treeAction = toupper(treeAction);
+           
+           if (strchr(choices, treeAction) == NULL)
+           {
+               out << "ERROR - Invalid character selection " << treeAction << "." << endl;
+           }
+           else
+           {
+               actionController(mainTree, context, treeAction, commandIn, out, false);
+           }
+           
+           if (treeAction != EXIT_CHAR)
+           {
+               commandIn >> treeAction;
+           }
+     } // end while commands remain
+     
+     out.flush();
+     
+     return EXIT_CHAR;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     runCommands
+// DESCRIPTION:  Runs the commands of the batch file when one is given,
+//               otherwise loops through the menu and the user's selections
+//               until exit is selected.
+// INPUT:
+//     Parameters:  options - The command line options.
+//                  mainTree - A pointer to the tree the commands act on.
+//                  context - The named trees of the main tree, or the display
+//                            buffer of a tree with only S, A, D, F and E.
+//                  choices - The commands the tree supports.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+//                  context - Same as input, passed by reference.
+// CALLS TO:     runBatch
+//               displayMenu
+//               actionController
+//------------------------------------------------------------------------------
+
+template <typename Tree, typename Context>
+void runCommands(const programOptions& options, Tree *&mainTree, Context& context, const char choices[])
+{
+     char treeAction;
+     
+     if (!options.batchFile.empty())
+     {
+         batchOutput outputBuffer(stdout);
+         ostream batchOut(&outputBuffer);
+         ifstream commandFile;
+         
+         if (options.batchFile == "-")
+         {
+             runBatch(mainTree, context, choices, cin, batchOut);
+         } // end if commands come from standard input
+         else
+         {
+             commandFile.open(options.batchFile.c_str());
+             if (commandFile)
+             {
+                 runBatch(mainTree, context, choices, commandFile, batchOut);
+             }
+             else
+             {
+                 batchOut << "ERROR - Command file " << options.batchFile << " does not exist." << endl;
+             }
+         }
+     } // end if commands are run as a batch
+     else
+     {
+         treeAction = displayMenu(mainTree, choices);
+         
+         // loop through menu and user selection until exit is selected
+         while (treeAction != EXIT_CHAR)
+         {
+               actionController(mainTree, context, treeAction);
+               if (treeAction != EXIT_CHAR)
+               {
+                   treeAction = displayMenu(mainTree, choices);
+               }// end if treeAction defults to 'E' because of memory allocation failure
+         } // end while user doesn't exit program
+     } // end if commands come from the menu
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     batchOutput::batchOutput
+// DESCRIPTION:  Creates an output buffer that writes to a C stream in large
+//               blocks.
+// INPUT:
+//     Parameters:  destination - The C stream the output is written to.
+// OUTPUT:       N/A
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+batchOutput::batchOutput(FILE *destination) : buffer(BATCH_BUFFER_BYTES), file(destination)
+{
+     setp(&buffer[0], &buffer[0] + buffer.size());
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     batchOutput::~batchOutput
+// DESCRIPTION:  Writes whatever output is still buffered.
+// INPUT:        N/A
+// OUTPUT:       N/A
+// CALLS TO:     writeBuffer
+//------------------------------------------------------------------------------
+
+batchOutput::~batchOutput()
+{
+     writeBuffer();
+     fflush(file);
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     batchOutput::overflow
+// DESCRIPTION:  Writes the full buffer and stores the character that did not fit.
+// INPUT:
+//     Parameters:  character - The character that did not fit, or EOF.
+// OUTPUT:
+//     Return Val:  The character, or EOF if the buffer could not be written.
+// CALLS TO:     writeBuffer
+//------------------------------------------------------------------------------
+
+int batchOutput::overflow(int character)
+{
+    int result = character;
+    
+    if (!writeBuffer())
+    {
+        result = EOF;
+    }
+    else if (character != EOF)
+    {
+        *pptr() = static_cast<char>(character);
+        pbump(1);
+    }
+    
+    return result;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     batchOutput::sync
+// DESCRIPTION:  Ignores the flush requested by endl so output leaves in large
+//               blocks. The buffer is written when it fills and at the end.
+// INPUT:        N/A
+// OUTPUT:
+//     Return Val:  Returns 0.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+int batchOutput::sync()
+{
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     batchOutput::writeBuffer
+// DESCRIPTION:  Writes the buffered output to the C stream in one call.
+// INPUT:        N/A
+// OUTPUT:
+//     Return Val:  written - Boolean value of whether the write succeeded.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+bool batchOutput::writeBuffer()
+{
+     size_t length = pptr() - pbase();
+     bool written = true;
+     
+     if (length > 0)
+     {
+         written = (fwrite(pbase(), 1, length, file) == length);
+         setp(&buffer[0], &buffer[0] + buffer.size());
+     }
+     
+     return written;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     deleteNode
+// DESCRIPTION:  Traverses through the BST finding a target node that will be deleted,
+//               then walks the path again to take it out of the subtree sizes.
+//               When the tree is balanced, the links walked are recorded so the
+//               AVL balance can be restored after the removal.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  num - The key of the target value to be deleted
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+// CALLS TO:     sameKey
+//               forgetKey
+//               deleteFromTree
+//               rebalancePath
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+void deleteNode(Tree *&mainTree, const typename Tree::keyType& num)
+{
+     typename Tree::nodeType **link,
+                             *current;
+     basicPath<typename Tree::nodeType> path;
+     bool found = false;
+     
+     path.length = 0;
+     link = &mainTree->root;
+     
+     if (mainTree->frozen != NULL)
+     {
+         mainTree->frozen->stale = true;
+     }
+     
+     STATS_ADD(mainTree, searches[STATS_DELETE], 1);
+     while ((*link != NULL) && !found)
+     {
+           STATS_ADD(mainTree, comparisons[STATS_DELETE], 1);
+           if (sameKey(mainTree->compare, num, (*link)->number))
+           {
+               found = true;
+           }
+           else
+           {
+               if (mainTree->balanced)
+               {
+                   path.link[path.length++] = link;
+               }
+               
+               if (mainTree->compare(num, (*link)->number))
+               {
+                   link = &(*link)->leftPtr;
+               }
+               else
+               {
+                   link = &(*link)->rightPtr;
+               }
+           }
+     }
+     
+     if (found)
+     {
+         // a node with two children takes the key of its predecessor, so both
+         // keys are dropped from the cache
+         if (mainTree->cache != NULL)
+         {
+             forgetKey(mainTree->cache, num);
+             if (((*link)->leftPtr != NULL) && ((*link)->rightPtr != NULL))
+             {
+                 current = (*link)->leftPtr;
+                 while (current->rightPtr != NULL)
+                 {
+                       current = current->rightPtr;
+                 }
+                 forgetKey(mainTree->cache, current->number);
+             }
+         } // end if tree has a hot key cache
+         
+         // the target and every node above it lose one node from their subtree
+         current = mainTree->root;
+         while (current != *link)
+         {
+               current->size--;
+               if (mainTree->compare(num, current->number))
+               {
+                   current = current->leftPtr;
+               }
+               else
+               {
+                   current = current->rightPtr;
+               }
+         }
+         current->size--;
+         
+         if (mainTree->balanced)
+         {
+             deleteFromTree(*link, &path, mainTree->arena);
+             rebalancePath(path);
+         } // end if tree must be rebalanced
+         else
+         {
+             deleteFromTree(*link, NULL, mainTree->arena);
+         }
+     } // end if target number is in the tree
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     deleteFromTree
+// DESCRIPTION:  Deletes a node from the main BST structure. A node with two
+//               children takes the value of its inorder predecessor, the nodes
+//               passed on the way to the predecessor lose one from their size,
+//               and the node plus the links walked above the predecessor are
+//               added to the path.
+// INPUT:
+//     Parameters:  nodeToRemove - A pointer to the node that will be deleted.
+//                  path - The links walked so far, NULL when not rebalancing.
+//                  arena - The node arena of the tree, NULL for the heap.
+// OUTPUT:
+//     Parameters:  nodeToRemove - Same as input, passed by reference.
+//                  path - Same as input, passed by reference.
+// CALLS TO:     copyEntry
+//               releaseNode
+//------------------------------------------------------------------------------
+
+template <typename Node>
+void deleteFromTree(Node *&nodeToRemove, typename Node::pathType *path, typename Node::arenaType *arena)
+{
+     Node *tempPtr,
+          *current,
+          *trail,
+          **currentLink;
+     
+     if ((nodeToRemove->leftPtr == NULL) && (nodeToRemove->rightPtr == NULL))
+     {
+         tempPtr = nodeToRemove;
+         nodeToRemove = NULL;
+         releaseNode(tempPtr, arena);
+     }
+     else if (nodeToRemove->leftPtr == NULL)
+     {
+          tempPtr = nodeToRemove;
+          nodeToRemove = tempPtr->rightPtr;
+          releaseNode(tempPtr, arena);
+     }
+     else if (nodeToRemove->rightPtr == NULL)
+     {
+          tempPtr = nodeToRemove;
+          nodeToRemove = tempPtr->leftPtr;
+          releaseNode(tempPtr, arena);
+     }
+     else
+     {
+         current = nodeToRemove->leftPtr;
+         currentLink = &nodeToRemove->leftPtr;
+         trail = NULL;
+         
+         if (path != NULL)
+         {
+             path->link[path->length++] = &nodeToRemove;
+         }
+         
+         while (current->rightPtr != NULL)
+         {
+               if (path != NULL)
+               {
+                   path->link[path->length++] = currentLink;
+                   currentLink = &current->rightPtr;
+               }
+               
+               current->size--;
+               trail = current;
+               current = current->rightPtr;
+         }
+         
+         copyEntry(nodeToRemove, current);
+         
+         if (trail == NULL)
+         {
+             nodeToRemove->leftPtr = current->leftPtr;
+         }
+         else
+         {
+             trail->rightPtr = current->leftPtr;
+         }
+         releaseNode(current, arena);
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     insertBatch
+// DESCRIPTION:  Adds a batch of keys to the BST. The batch is sorted once and
+//               merged into the tree in a single pass, so each part of the tree
+//               is walked once however many keys pass through it. The status
+//               of each key, in the order given, is BATCH_INSERTED,
+//               BATCH_DUPLICATE when it is already in the tree or earlier in
+//               the batch, or BATCH_FAILED when memory ran out first.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  keys - The keys to add.
+//                  count - The number of keys.
+//                  status - Array of count characters for the results.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+//                  status - The result for each key.
+//                  memoryFail - Same as input, passed by reference.
+//     Return Val:  inserted - The number of keys added.
+// CALLS TO:     sortBatch
+//               clearCache
+//               mergeBatch
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+int insertBatch(Tree *&mainTree, const typename Tree::keyType keys[], int count, char status[],
+                bool& memoryFail)
+{
+    vector<typename Tree::keyType> sortedKeys;
+    vector<int> positions;
+    int before = mainTree->count;
+    
+    sortBatch(mainTree, keys, count, status, BATCH_FAILED, BATCH_DUPLICATE, sortedKeys, positions);
+    
+    if (!sortedKeys.empty())
+    {
+        if (mainTree->frozen != NULL)
+        {
+            mainTree->frozen->stale = true;
+        }
+        if (mainTree->cache != NULL)
+        {
+            clearCache(mainTree->cache);
+        }
+        mergeBatch(mainTree, sortedKeys, positions, status, false, memoryFail);
+    } // end if batch holds keys
+    
+    return mainTree->count - before;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     deleteBatch
+// DESCRIPTION:  Removes a batch of keys from the BST in a single sorted pass,
+//               the same way insertBatch adds them, and takes them out of the
+//               tree count. The status of each key, in the order given, is
+//               BATCH_DELETED or BATCH_MISSING when it is not in the tree or
+//               was deleted earlier in the batch.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  keys - The keys to delete.
+//                  count - The number of keys.
+//                  status - Array of count characters for the results.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+//                  status - The result for each key.
+//     Return Val:  deleted - The number of keys removed.
+// CALLS TO:     sortBatch
+//               clearCache
+//               mergeBatch
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+int deleteBatch(Tree *&mainTree, const typename Tree::keyType keys[], int count, char status[])
+{
+    vector<typename Tree::keyType> sortedKeys;
+    vector<int> positions;
+    int before = mainTree->count;
+    bool memoryFail = false;
+    
+    sortBatch(mainTree, keys, count, status, BATCH_MISSING, BATCH_MISSING, sortedKeys, positions);
+    
+    if (!sortedKeys.empty())
+    {
+        if (mainTree->frozen != NULL)
+        {
+            mainTree->frozen->stale = true;
+        }
+        if (mainTree->cache != NULL)
+        {
+            clearCache(mainTree->cache);
+        }
+        mergeBatch(mainTree, sortedKeys, positions, status, true, memoryFail);
+    } // end if batch holds keys
+    
+    return before - mainTree->count;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     sortBatch
+// DESCRIPTION:  Sorts the keys of a batch and keeps the first of each repeated
+//               key. The status of each kept key is set to the status it has
+//               until the merge reaches it, and repeats get their final status.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  keys - The keys of the batch.
+//                  count - The number of keys.
+//                  status - Array of count characters for the results.
+//                  keptStatus - Status of a key until the merge reaches it.
+//                  repeatStatus - Status of a key found earlier in the batch.
+// OUTPUT:
+//     Parameters:  status - The status of each key.
+//                  sortedKeys - The keys without repeats in ascending order.
+//                  positions - The position in the batch of each sorted key.
+// CALLS TO:     sameKey
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+void sortBatch(Tree *mainTree, const typename Tree::keyType keys[], int count, char status[],
+               char keptStatus, char repeatStatus, vector<typename Tree::keyType>& sortedKeys,
+               vector<int>& positions)
+{
+     typedef pair<typename Tree::keyType, int> batchEntry;
+     vector<batchEntry> entries(count);
+     int index;
+     
+     for (index = 0; index < count; index++)
+     {
+         entries[index].first = keys[index];
+         entries[index].second = index;
+     }
+     
+     // a stable sort keeps repeats in batch order so the first one is kept
+     stable_sort(entries.begin(), entries.end(),
+                 [mainTree](const batchEntry& first, const batchEntry& second)
+                 {
+                     return mainTree->compare(first.first, second.first);
+                 });
+     
+     sortedKeys.reserve(count);
+     positions.reserve(count);
+     
+     for (index = 0; index < count; index++)
+     {
+         if (!sortedKeys.empty() && sameKey(mainTree->compare, sortedKeys.back(), entries[index].first))
+         {
+             status[entries[index].second] = repeatStatus;
+         }
+         else
+         {
+             sortedKeys.push_back(entries[index].first);
+             positions.push_back(entries[index].second);
+             status[entries[index].second] = keptStatus;
+         }
+     } // end for each key in sorted order
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     mergeBatch
+// DESCRIPTION:  Merges sorted keys into the BST, or removes them from it, by
+//               splitting the keys at each node and handling the two parts in
+//               its subtrees. Keys that reach an empty subtree are added there
+//               as a height optimal subtree, and each node is then joined back
+//               with its new subtrees. An explicit stack takes the place of
+//               recursion, since an unbalanced tree can be very deep.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  sortedKeys - The keys in ascending order with no repeats.
+//                  positions - The position in the batch of each sorted key.
+//                  status - Array of results in batch order.
+//                  deleting - Boolean value of whether the keys are removed.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+//                  status - The result for each key the merge reached.
+//                  memoryFail - Same as input, passed by reference.
+// CALLS TO:     sameKey
+//               buildBalanced
+//               startIterator
+//               nextNode
+//               joinTrees
+//               removeLargest
+//               releaseNode
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+void mergeBatch(Tree *mainTree, const vector<typename Tree::keyType>& sortedKeys,
+                const vector<int>& positions, char status[], bool deleting, bool& memoryFail)
+{
+     typedef typename Tree::nodeType Node;
+     vector<batchFrame<Node> > frames;
+     batchFrame<Node> frame;
+     basicIterator<Node> iterator;
+     Node *result,
+          *built,
+          *largest;
+     int index;
+     
+     frame.node = mainTree->root;
+     frame.first = 0;
+     frame.last = static_cast<int>(sortedKeys.size()) - 1;
+     frame.stage = BATCH_SPLIT;
+     frames.push_back(frame);
+     result = NULL;
+     
+     while (!frames.empty())
+     {
+           batchFrame<Node>& current = frames.back();
+           
+           if ((current.stage == BATCH_SPLIT) && (current.first > current.last))
+           {
+               result = current.node;
+               frames.pop_back();
+           } // end if no keys fall in this subtree
+           else if ((current.stage == BATCH_SPLIT) && (current.node == NULL))
+           {
+               result = NULL;
+               if (!deleting && !memoryFail)
+               {
+                   buildBalanced(result, &sortedKeys[0], current.first, current.last, mainTree, memoryFail);
+                   
+                   // after a failure only the keys that reached the new subtree are in
+                   startIterator(iterator, result);
+                   built = nextNode(iterator);
+                   for (index = current.first; index <= current.last; index++)
+                   {
+                       if ((built != NULL) && sameKey(mainTree->compare, built->number, sortedKeys[index]))
+                       {
+                           status[positions[index]] = BATCH_INSERTED;
+                           built = nextNode(iterator);
+                       }
+                   }
+               } // end if keys are added in a new subtree
+               frames.pop_back();
+           } // end if keys reach an empty subtree
+           else if (current.stage == BATCH_SPLIT)
+           {
+               current.split = static_cast<int>(lower_bound(sortedKeys.begin() + current.first,
+                                                            sortedKeys.begin() + current.last + 1,
+                                                            current.node->number, mainTree->compare)
+                                                - sortedKeys.begin());
+               current.found = (current.split <= current.last)
+                               && sameKey(mainTree->compare, sortedKeys[current.split], current.node->number);
+               if (current.found)
+               {
+                   status[positions[current.split]] = deleting ? BATCH_DELETED : BATCH_DUPLICATE;
+               }
+               current.stage = BATCH_LEFT;
+               
+               frame.node = current.node->leftPtr;
+               frame.first = current.first;
+               frame.last = current.split - 1;
+               frame.stage = BATCH_SPLIT;
+               frames.push_back(frame);
+           } // end if keys are split at this node
+           else if (current.stage == BATCH_LEFT)
+           {
+               current.left = result;
+               current.stage = BATCH_JOIN;
+               
+               frame.node = current.node->rightPtr;
+               frame.first = current.split + (current.found ? 1 : 0);
+               frame.last = current.last;
+               frame.stage = BATCH_SPLIT;
+               frames.push_back(frame);
+           } // end if left subtree is done
+           else
+           {
+               if (deleting && current.found)
+               {
+                   if (result == NULL)
+                   {
+                       result = current.left;
+                   }
+                   else if (current.left != NULL)
+                   {
+                       largest = removeLargest(mainTree, current.left);
+                       result = joinTrees(mainTree, current.left, largest, result);
+                   } // end if the largest smaller key takes the place of the node
+                   releaseNode(current.node, mainTree->arena);
+                   mainTree->count--;
+               } // end if node is deleted
+               else
+               {
+                   result = joinTrees(mainTree, current.left, current.node, result);
+               }
+               frames.pop_back();
+           } // end if both subtrees are done
+     } // end while subtrees remain
+     
+     mainTree->root = result;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     joinTrees
+// DESCRIPTION:  Joins two subtrees with a node whose key lies between them.
+//               In a balanced tree the node is placed down the side of the
+//               taller subtree where the heights match, and the nodes above it
+//               are rebalanced; otherwise it simply becomes the new root.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  left - The subtree of smaller keys.
+//                  middle - The node to join them with.
+//                  right - The subtree of larger keys.
+// OUTPUT:
+//     Return Val:  root - The root of the joined subtree.
+// CALLS TO:     nodeHeight
+//               joinTrees
+//               rebalanceNode
+//               updateNode
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+typename Tree::nodeType *joinTrees(Tree *mainTree, typename Tree::nodeType *left,
+                                   typename Tree::nodeType *middle, typename Tree::nodeType *right)
+{
+    typename Tree::nodeType *root;
+    
+    if (mainTree->balanced && (nodeHeight(left) > nodeHeight(right) + 1))
+    {
+        root = left;
+        root->rightPtr = joinTrees(mainTree, root->rightPtr, middle, right);
+        rebalanceNode(root);
+    } // end if left subtree is taller
+    else if (mainTree->balanced && (nodeHeight(right) > nodeHeight(left) + 1))
+    {
+        root = right;
+        root->leftPtr = joinTrees(mainTree, left, middle, root->leftPtr);
+        rebalanceNode(root);
+    } // end if right subtree is taller
+    else
+    {
+        root = middle;
+        root->leftPtr = left;
+        root->rightPtr = right;
+        updateNode(root);
+    } // end if heights are close enough for the node to be the root
+    
+    return root;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     removeLargest
+// DESCRIPTION:  Takes the node with the largest key out of a subtree, taking
+//               it out of the sizes above and rebalancing them when the tree
+//               is balanced.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  subtree - The link holding the root of the subtree.
+// OUTPUT:
+//     Parameters:  subtree - Same as input, passed by reference.
+//     Return Val:  largest - A pointer to the node removed.
+// CALLS TO:     rebalancePath
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+typename Tree::nodeType *removeLargest(Tree *mainTree, typename Tree::nodeType *&subtree)
+{
+    typename Tree::nodeType **link = &subtree,
+                            *largest;
+    basicPath<typename Tree::nodeType> path;
+    
+    path.length = 0;
+    
+    while ((*link)->rightPtr != NULL)
+    {
+          if (mainTree->balanced)
+          {
+              path.link[path.length++] = link;
+          }
+          (*link)->size--;
+          link = &(*link)->rightPtr;
+    }
+    
+    largest = *link;
+    *link = largest->leftPtr;
+    
+    if (mainTree->balanced)
+    {
+        rebalancePath(path);
+    }
+    
+    return largest;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     nodeCount
+// DESCRIPTION:  Accesses the count variable in the main BST structure.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+// OUTPUT:
+//     Return Val:  num - An integer of the total nodes in the BST.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+int nodeCount(Tree *mainTree)
+{
+    int num = 0;
+    
+    num = mainTree->count;
+    
+    return num;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     inOrderDisplay
+// DESCRIPTION:  Displays all nodes of a subtree in ascending order using an
+//               inorder iterator, so no recursion is needed however deep the
+//               tree is. The numbers are formatted into a display buffer that
+//               is written to the output stream in large blocks.
+// INPUT:
+//     Parameters:  node - A pointer to a node within the BST.
+//                  currentColumn - An integers of how many columns have been displayed.
+//                  buffer - The display buffer the numbers are formatted into.
+//                  out - Stream the numbers are written to.
+// OUTPUT:
+//     Parameters:  currentColumn - Same as input, passed by reference.
+//                  buffer - Same as input, passed by reference.
+// CALLS TO:     startDisplay
+//               startIterator
+//               nextNode
+//               formatDisplay
+//               flushDisplay
+//------------------------------------------------------------------------------
+
+void inOrderDisplay(treeNode *node, int& currentColumn, displayBuffer& buffer, ostream& out)
+{
+     treeIterator iterator;
+     
+     startDisplay(buffer, out);
+     
+     startIterator(iterator, node);
+     node = nextNode(iterator);
+     
+     while (node != NULL)
+     {
+           formatDisplay(node->number, currentColumn, buffer);
+           node = nextNode(iterator);
+     }
+     
+     flushDisplay(buffer);
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     startIterator
+// DESCRIPTION:  Positions an inorder iterator before the smallest node of a
+//               subtree by stacking the nodes down its left side.
+// INPUT:
+//     Parameters:  iterator - The iterator to position.
+//                  node - A pointer to the root of the subtree.
+// OUTPUT:
+//     Parameters:  iterator - Same as input, passed by reference.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+template <typename Node>
+void startIterator(basicIterator<Node>& iterator, Node *node)
+{
+     iterator.pending.clear();
+     
+     while (node != NULL)
+     {
+           iterator.pending.push_back(node);
+           node = node->leftPtr;
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     nextNode
+// DESCRIPTION:  Returns the next node in ascending order. The iterator keeps its
+//               place between calls, so a traversal can stop early and resume
+//               later as long as the tree is not changed in between.
+// INPUT:
+//     Parameters:  iterator - The inorder iterator.
+// OUTPUT:
+//     Parameters:  iterator - Same as input, passed by reference.
+//     Return Val:  node - A pointer to the next node, NULL when there are no more.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+template <typename Node>
+Node *nextNode(basicIterator<Node>& iterator)
+{
+    Node *node = NULL,
+         *child;
+    
+    if (!iterator.pending.empty())
+    {
+        node = iterator.pending.back();
+        iterator.pending.pop_back();
+        child = node->rightPtr;
+        
+        while (child != NULL)
+        {
+              iterator.pending.push_back(child);
+              child = child->leftPtr;
+        }
+    } // end if nodes remain
+    
+    return node;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     seekIterator
+// DESCRIPTION:  Positions an inorder iterator so the next node it returns is the
+//               smallest one not less than a value. Only the nodes on one path
+//               from the root are stacked.
+// INPUT:
+//     Parameters:  iterator - The iterator to position.
+//                  mainTree - A pointer to the main BST structure.
+//                  low - The value to start from.
+// OUTPUT:
+//     Parameters:  iterator - Same as input, passed by reference.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+void seekIterator(basicIterator<typename Tree::nodeType>& iterator, Tree *mainTree,
+                  const typename Tree::keyType& low)
+{
+     typename Tree::nodeType *node = mainTree->root;
+     
+     iterator.pending.clear();
+     
+     while (node != NULL)
+     {
+           if (!mainTree->compare(node->number, low))
+           {
+               iterator.pending.push_back(node);
+               node = node->leftPtr;
+           } // end if node is returned after its left subtree
+           else
+           {
+               node = node->rightPtr;
+           } // end if node and its left subtree are skipped
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     countLess
+// DESCRIPTION:  Counts the integers in the BST less than a value, or less than
+//               or equal to it, using the subtree sizes along one path.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  num - The value to compare with.
+//                  inclusive - Boolean value of whether the value itself counts.
+// OUTPUT:
+//     Return Val:  total - An integer of how many integers were counted.
+// CALLS TO:     nodeSize
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+int countLess(Tree *mainTree, const typename Tree::keyType& num, bool inclusive)
+{
+    typename Tree::nodeType *node = mainTree->root;
+    int total = 0;
+    
+    while (node != NULL)
+    {
+          if (inclusive ? !mainTree->compare(num, node->number) : mainTree->compare(node->number, num))
+          {
+              total += nodeSize(node->leftPtr) + 1;
+              node = node->rightPtr;
+          } // end if node and its left subtree are counted
+          else
+          {
+              node = node->leftPtr;
+          }
+    }
+    
+    return total;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     selectNode
+// DESCRIPTION:  Finds the node at a position in ascending order, starting from
+//               1, using the subtree sizes along one path.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  position - The position of the integer wanted.
+// OUTPUT:
+//     Return Val:  node - A pointer to the node, NULL if the position is not in the tree.
+// CALLS TO:     nodeSize
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+typename Tree::nodeType *selectNode(Tree *mainTree, int position)
+{
+    typename Tree::nodeType *node = NULL;
+    int leftSize;
+    
+    if ((position >= 1) && (position <= nodeSize(mainTree->root)))
+    {
+        node = mainTree->root;
+        leftSize = nodeSize(node->leftPtr);
+        
+        while (position != leftSize + 1)
+        {
+              if (position <= leftSize)
+              {
+                  node = node->leftPtr;
+              }
+              else
+              {
+                  position -= leftSize + 1;
+                  node = node->rightPtr;
+              }
+              leftSize = nodeSize(node->leftPtr);
+        } // end while node is not at the position
+    } // end if position is in the tree
+    
+    return node;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     countRange
+// DESCRIPTION:  Counts the integers from low to high, inclusive, as the
+//               difference of two ranks.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  low - The lowest value of the range.
+//                  high - The highest value of the range.
+// OUTPUT:
+//     Return Val:  total - An integer of how many integers are in the range.
+// CALLS TO:     countLess
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+int countRange(Tree *mainTree, const typename Tree::keyType& low, const typename Tree::keyType& high)
+{
+    int total = 0;
+    
+    if (!mainTree->compare(high, low))
+    {
+        total = countLess(mainTree, high, true) - countLess(mainTree, low, false);
+    }
+    
+    return total;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     rangeDisplay
+// DESCRIPTION:  Displays the integers from low to high in ascending order,
+//               starting the iterator at low instead of the smallest integer.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  low - The lowest value of the range.
+//                  high - The highest value of the range.
+//                  currentColumn - An integers of how many columns have been displayed.
+//                  buffer - The display buffer the numbers are formatted into.
+//                  out - Stream the numbers are written to.
+// OUTPUT:
+//     Parameters:  currentColumn - Same as input, passed by reference.
+//                  buffer - Same as input, passed by reference.
+// CALLS TO:     startDisplay
+//               seekIterator
+//               nextNode
+//               formatDisplay
+//               flushDisplay
+//------------------------------------------------------------------------------
+
+void rangeDisplay(binarySearchTree *mainTree, int low, int high, int& currentColumn, displayBuffer& buffer,
+                  ostream& out)
+{
+     treeIterator iterator;
+     treeNode *node;
+     
+     startDisplay(buffer, out);
+     
+     seekIterator(iterator, mainTree, low);
+     node = nextNode(iterator);
+     
+     while ((node != NULL) && (node->number <= high))
+     {
+           formatDisplay(node->number, currentColumn, buffer);
+           node = nextNode(iterator);
+     }
+     
+     flushDisplay(buffer);
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     combineTrees
+// DESCRIPTION:  Builds the union, intersection or difference (keys of the first
+//               tree not in the second) of two trees in linear time by merging
+//               their keys in ascending order into a sorted array and building
+//               a height optimal tree from it. Only keys are combined, mapped
+//               values are not carried into the result.
+// INPUT:
+//     Parameters:  first - A pointer to the first BST structure.
+//                  second - A pointer to the second BST structure.
+//                  operation - SET_UNION, SET_INTERSECTION or SET_DIFFERENCE.
+//                  result - A pointer to an empty BST structure for the result.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  result - Same as input, passed by reference.
+//                  memoryFail - Same as input, passed by reference.
+// CALLS TO:     nodeSize
+//               mergeKeys
+//               buildBalanced
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+void combineTrees(Tree *first, Tree *second, char operation, Tree *result, bool& memoryFail)
+{
+     vector<typename Tree::keyType> keys;
+     
+     keys.reserve(nodeSize(first->root) + ((operation == SET_UNION) ? nodeSize(second->root) : 0));
+     mergeKeys(first, second, operation, NULL, NULL, keys);
+     
+     if (!keys.empty())
+     {
+         buildBalanced(result->root, &keys[0], 0, static_cast<int>(keys.size()) - 1, result, memoryFail);
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     combineParallel
+// DESCRIPTION:  Builds the same tree as combineTrees on several threads. Keys of
+//               the larger tree at evenly spaced positions split the key range
+//               into one part per thread, each thread merges its part of both
+//               trees, and the parts are joined in order and built with
+//               buildParallel. A part whose thread cannot be started, or runs
+//               out of memory, is merged on the calling thread afterwards.
+// INPUT:
+//     Parameters:  first - A pointer to the first BST structure.
+//                  second - A pointer to the second BST structure.
+//                  operation - SET_UNION, SET_INTERSECTION or SET_DIFFERENCE.
+//                  result - A pointer to an empty BST structure for the result.
+//                  threadCount - The number of threads to use.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  result - Same as input, passed by reference.
+//                  memoryFail - Same as input, passed by reference.
+// CALLS TO:     nodeSize
+//               selectNode
+//               mergeKeys
+//               buildParallel
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+void combineParallel(Tree *first, Tree *second, char operation, Tree *result, int threadCount,
+                     bool& memoryFail)
+{
+     Tree *larger = (nodeSize(first->root) >= nodeSize(second->root)) ? first : second;
+     vector<typename Tree::keyType> splitters,
+                                    keys;
+     vector< vector<typename Tree::keyType> > parts;
+     vector<thread> workers;
+     vector<char> failed;
+     long long largerSize = nodeSize(larger->root);
+     size_t total = 0;
+     int partCount,
+         part,
+         levels = 0;
+     
+     partCount = static_cast<int>(min(static_cast<long long>(threadCount), max(largerSize, 1LL)));
+     
+     for (part = 1; part < partCount; part++)
+     {
+         splitters.push_back(selectNode(larger, static_cast<int>(part * largerSize / partCount) + 1)->number);
+     }
+     
+     // part i holds the keys from splitter i - 1 up to, but not including, splitter i
+     parts.resize(partCount);
+     workers.reserve(partCount);
+     failed.assign(partCount, false);
+     for (part = 0; part < partCount; part++)
+     {
+         try
+         {
+             workers.push_back(thread([&, part]()
+             {
+                 try
+                 {
+                     mergeKeys(first, second, operation, (part > 0) ? &splitters[part - 1] : NULL,
+                               (part < partCount - 1) ? &splitters[part] : NULL, parts[part]);
+                 }
+                 catch (const bad_alloc&)
+                 {
+                     failed[part] = true;
+                 }
+             }));
+         }
+         catch (const system_error&)
+         {
+             failed[part] = true;
+         }
+         catch (const bad_alloc&)
+         {
+             failed[part] = true;
+         }
+     } // end for each part
+     for (part = 0; part < static_cast<int>(workers.size()); part++)
+     {
+         workers[part].join();
+     }
+     
+     // a part whose thread could not be started, or ran out of memory, is
+     // merged again here once the other threads have finished with theirs
+     for (part = 0; part < partCount; part++)
+     {
+         if (failed[part])
+         {
+             vector<typename Tree::keyType>().swap(parts[part]);
+             mergeKeys(first, second, operation, (part > 0) ? &splitters[part - 1] : NULL,
+                       (part < partCount - 1) ? &splitters[part] : NULL, parts[part]);
+         }
+         total += parts[part].size();
+     } // end for each part
+     
+     keys.reserve(total);
+     for (part = 0; part < partCount; part++)
+     {
+         keys.insert(keys.end(), parts[part].begin(), parts[part].end());
+         vector<typename Tree::keyType>().swap(parts[part]);
+     }
+     
+     while ((1 << levels) < threadCount)
+     {
+           levels++;
+     }
+     
+     if (!keys.empty())
+     {
+         buildParallel(result->root, &keys[0], 0, static_cast<int>(keys.size()) - 1, result, levels,
+                       memoryFail);
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     mergeKeys
+// DESCRIPTION:  Walks two trees in ascending order at the same time and appends
+//               the keys the set operation keeps. The walk can be limited to the
+//               keys from low up to, but not including, high.
+// INPUT:
+//     Parameters:  first - A pointer to the first BST structure.
+//                  second - A pointer to the second BST structure.
+//                  operation - SET_UNION, SET_INTERSECTION or SET_DIFFERENCE.
+//                  low - The lowest key to merge, NULL to start at the smallest.
+//                  high - The key to stop before, NULL to run to the largest.
+// OUTPUT:
+//     Parameters:  keys - The kept keys appended in ascending order.
+// CALLS TO:     seekIterator
+//               startIterator
+//               nextBefore
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+void mergeKeys(Tree *first, Tree *second, char operation, const typename Tree::keyType *low,
+               const typename Tree::keyType *high, vector<typename Tree::keyType>& keys)
+{
+     basicIterator<typename Tree::nodeType> firstIterator,
+                                            secondIterator;
+     typename Tree::nodeType *firstNode,
+                             *secondNode;
+     
+     if (low != NULL)
+     {
+         seekIterator(firstIterator, first, *low);
+         seekIterator(secondIterator, second, *low);
+     }
+     else
+     {
+         startIterator(firstIterator, first->root);
+         startIterator(secondIterator, second->root);
+     }
+     firstNode = nextBefore(firstIterator, first, high);
+     secondNode = nextBefore(secondIterator, second, high);
+     
+     // once one side runs out only a union, or a difference with keys left in the first, continues
+     while (((firstNode != NULL) && ((secondNode != NULL) || (operation != SET_INTERSECTION)))
+            || ((secondNode != NULL) && (operation == SET_UNION)))
+     {
+           if ((secondNode == NULL)
+               || ((firstNode != NULL) && first->compare(firstNode->number, secondNode->number)))
+           {
+               if (operation != SET_INTERSECTION)
+               {
+                   keys.push_back(firstNode->number);
+               }
+               firstNode = nextBefore(firstIterator, first, high);
+           } // end if key is only in the first tree
+           else if ((firstNode == NULL) || first->compare(secondNode->number, firstNode->number))
+           {
+               if (operation == SET_UNION)
+               {
+                   keys.push_back(secondNode->number);
+               }
+               secondNode = nextBefore(secondIterator, second, high);
+           } // end if key is only in the second tree
+           else
+           {
+               if (operation != SET_DIFFERENCE)
+               {
+                   keys.push_back(firstNode->number);
+               }
+               firstNode = nextBefore(firstIterator, first, high);
+               secondNode = nextBefore(secondIterator, second, high);
+           } // end if key is in both trees
+     } // end while keys that can be kept remain
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     nextBefore
+// DESCRIPTION:  Returns the next node of an inorder iterator as long as its key
+//               is less than a limit.
+// INPUT:
+//     Parameters:  iterator - The inorder iterator.
+//                  mainTree - A pointer to the BST structure being walked.
+//                  high - The key to stop before, NULL for no limit.
+// OUTPUT:
+//     Parameters:  iterator - Same as input, passed by reference.
+//     Return Val:  node - A pointer to the next node, NULL when the limit or the end is reached.
+// CALLS TO:     nextNode
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+typename Tree::nodeType *nextBefore(basicIterator<typename Tree::nodeType>& iterator, Tree *mainTree,
+                                    const typename Tree::keyType *high)
+{
+    typename Tree::nodeType *node;
+    
+    node = nextNode(iterator);
+    
+    if ((node != NULL) && (high != NULL) && !mainTree->compare(node->number, *high))
+    {
+        node = NULL;
+    }
+    
+    return node;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     formatDisplay
+// DESCRIPTION:  Formats an integer right aligned in 6 columns ensuring that
+//               there are 10 per row, the same text setw(6) would produce. The
+//               digits are written two at a time straight into the buffer.
+// INPUT:
+//     Parameters:  num - An integer from the BST to be displayed.
+//                  currentColumn - An integer of how many columns have been displayed.
+//                  buffer - The display buffer the number is formatted into.
+// OUTPUT:
+//     Parameters:  currentColumn - Same as input, passed by reference.
+//                  buffer - Same as input, passed by reference.
+// CALLS TO:     flushDisplay
+//------------------------------------------------------------------------------
+
+void formatDisplay(int num, int& currentColumn, displayBuffer& buffer)
+{
+     char digits[12];
+     char *first = digits + sizeof(digits);
+     unsigned int value,
+                  pair;
+     int length,
+         padding;
+     
+     if (buffer.used + DISPLAY_ENTRY_BYTES > buffer.text.size())
+     {
+         flushDisplay(buffer);
+     }
+     
+     if (currentColumn >= MAX_COLUMNS)
+     {
+         currentColumn = INIT_COLUMN;
+         buffer.text[buffer.used++] = '\n';
+     }
+     
+     value = (num < 0) ? 0U - static_cast<unsigned int>(num) : static_cast<unsigned int>(num);
+     
+     while (value >= 100)
+     {
+           pair = (value % 100) * 2;
+           value /= 100;
+           *--first = DIGIT_PAIRS[pair + 1];
+           *--first = DIGIT_PAIRS[pair];
+     }
+     if (value >= 10)
+     {
+         *--first = DIGIT_PAIRS[value * 2 + 1];
+         *--first = DIGIT_PAIRS[value * 2];
+     }
+     else
+     {
+         *--first = static_cast<char>('0' + value);
+     }
+     if (num < 0)
+     {
+         *--first = '-';
+     }
+     
+     length = static_cast<int>(digits + sizeof(digits) - first);
+     for (padding = length; padding < DISPLAY_WIDTH; padding++)
+     {
+         buffer.text[buffer.used++] = ' ';
+     }
+     memcpy(&buffer.text[buffer.used], first, length);
+     buffer.used += length;
+     currentColumn++;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     startDisplay
+// DESCRIPTION:  Readies a display buffer to format numbers for an output
+//               stream. The text is allocated the first time the buffer is
+//               used and kept for every display after it.
+// INPUT:
+//     Parameters:  buffer - The display buffer.
+//                  out - Stream the numbers will be written to.
+// OUTPUT:
+//     Parameters:  buffer - Same as input, passed by reference.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void startDisplay(displayBuffer& buffer, ostream& out)
+{
+     if (buffer.text.size() < DISPLAY_BUFFER_BYTES)
+     {
+         buffer.text.resize(DISPLAY_BUFFER_BYTES);
+     }
+     
+     buffer.used = 0;
+     buffer.out = &out;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     flushDisplay
+// DESCRIPTION:  Writes the formatted text in the display buffer to its output
+//               stream in one call and empties the buffer.
+// INPUT:
+//     Parameters:  buffer - The display buffer.
+// OUTPUT:
+//     Parameters:  buffer - Same as input, passed by reference.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void flushDisplay(displayBuffer& buffer)
+{
+     if (buffer.used > 0)
+     {
+         buffer.out->write(&buffer.text[0], buffer.used);
+         buffer.used = 0;
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     depthHistogram
+// DESCRIPTION:  Counts the nodes at each depth of a tree, visiting every node
+//               with an explicit stack so any tree shape can be measured.
+// INPUT:
+//     Parameters:  node - A pointer to the root of the tree.
+// OUTPUT:
+//     Parameters:  counts - The number of nodes at each depth, the root at 1.
+//     Return Val:  height - The number of nodes on the longest path down.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+int depthHistogram(treeNode *node, vector<int>& counts)
+{
+    vector< pair<treeNode *, int> > pending;
+    int depth;
+    
+    counts.assign(1, 0);
+    if (node != NULL)
+    {
+        pending.push_back(make_pair(node, 1));
+    }
+    
+    while (!pending.empty())
+    {
+          node = pending.back().first;
+          depth = pending.back().second;
+          pending.pop_back();
+          
+          if (depth >= static_cast<int>(counts.size()))
+          {
+              counts.resize(depth + 1, 0);
+          }
+          counts[depth]++;
+          
+          if (node->leftPtr != NULL)
+          {
+              pending.push_back(make_pair(node->leftPtr, depth + 1));
+          }
+          if (node->rightPtr != NULL)
+          {
+              pending.push_back(make_pair(node->rightPtr, depth + 1));
+          }
+    } // end while nodes remain to visit
+    
+    return static_cast<int>(counts.size()) - 1;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     displayStats
+// DESCRIPTION:  Displays the shape of the tree, the hit rate and average
+//               search depth of its hot key cache and, when the program is
+//               built with BST_STATS, the comparisons made by each kind of
+//               search and the latency of each menu command. A height well
+//               above the minimum shows the tree has degenerated.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  out - Output stream the statistics are written to.
+// OUTPUT:       N/A
+// CALLS TO:     depthHistogram
+//               latencyPercentile
+//------------------------------------------------------------------------------
+
+void displayStats(binarySearchTree *mainTree, ostream& out)
+{
+     vector<int> counts;
+     const basicCache<treeNode> *cache = mainTree->cache;
+     int height = depthHistogram(mainTree->root, counts),
+         minimum = 0,
+         rowDepths,
+         depth,
+         rowCount;
+     double depthTotal = 0;
+     
+     while ((1LL << minimum) <= nodeSize(mainTree->root))
+     {
+           minimum++;
+     }
+     
+     for (depth = 1; depth <= height; depth++)
+     {
+         depthTotal += static_cast<double>(depth) * counts[depth];
+     }
+     
+     out << "\nTree statistics:" << endl
+         << "  Integers: " << nodeSize(mainTree->root) << endl
+         << "  Height: " << height << " (at least " << minimum << " for this many integers)" << endl
+         << fixed << setprecision(1)
+         << "  Average node depth: " << ((height > 0) ? depthTotal / nodeSize(mainTree->root) : 0.0) << endl;
+     
+     // hits cost no walk, so they bring the average search depth down
+     if (cache != NULL)
+     {
+         out << "  Hot key cache: " << cache->lookups << " searches, " << cache->hits << " hits";
+         if (cache->lookups > 0)
+         {
+             out << " (" << 100.0 * cache->hits / cache->lookups << "%), average search depth "
+                 << static_cast<double>(cache->depth) / cache->lookups;
+         }
+         out << endl;
+     } // end if searches go through a hot key cache
+     out.unsetf(ios::floatfield);
+     
+     out << "  Nodes at each depth:" << endl;
+     
+     // group depths so a degenerate tree still fits on one screen
+     rowDepths = (height + STATS_DEPTH_ROWS - 1) / STATS_DEPTH_ROWS;
+     for (depth = 1; depth <= height; depth += rowDepths)
+     {
+         rowCount = 0;
+         for (int row = depth; (row < depth + rowDepths) && (row <= height); row++)
+         {
+             rowCount += counts[row];
+         }
+         out << "    " << setw(6) << depth;
+         if (rowDepths > 1)
+         {
+             out << " -" << setw(6) << min(depth + rowDepths - 1, height);
+         }
+         out << ": " << rowCount << endl;
+     } // end for each row of depths
+     
+#if defined(BST_STATS)
+     const char *OPERATION_NAMES[STATS_OPERATIONS] = {"find", "insert", "delete"};
+     const treeStats& stats = mainTree->stats;
+     unsigned long long total;
+     size_t command;
+     int operation,
+         bucket;
+     
+     out << "  Comparisons per search:" << endl;
+     for (operation = 0; operation < STATS_OPERATIONS; operation++)
+     {
+         out << "    " << setw(6) << OPERATION_NAMES[operation] << ": " << stats.searches[operation]
+             << " searches, " << stats.comparisons[operation] << " comparisons";
+         if (stats.searches[operation] > 0)
+         {
+             out << ", " << fixed << setprecision(1)
+                 << static_cast<double>(stats.comparisons[operation]) / stats.searches[operation]
+                 << " average";
+             out.unsetf(ios::floatfield);
+         }
+         out << endl;
+     } // end for each kind of search
+     out << "    frozen index searches: " << stats.frozenSearches << endl;
+     
+     out << "  Command latency (nanoseconds, rounded up to a power of two):" << endl;
+     for (command = 0; command < MENU_COMMANDS; command++)
+     {
+         total = 0;
+         for (bucket = 0; bucket < STATS_LATENCY_BUCKETS; bucket++)
+         {
+             total += stats.latency[command][bucket];
+         }
+         
+         if (total > 0)
+         {
+             out << "    " << MENU_CHOICES[command] << ": " << total << " commands, median "
+                 << latencyPercentile(stats.latency[command], total, 0.50) << ", 99% "
+                 << latencyPercentile(stats.latency[command], total, 0.99) << ", max "
+                 << latencyPercentile(stats.latency[command], total, 1.0) << endl;
+         }
+     } // end for each menu command
+#else
+     out << "  Search and latency counters are not built in; rebuild with -DBST_STATS." << endl;
+#endif
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     writeStatsJson
+// DESCRIPTION:  Writes the statistics shown by displayStats as a JSON object,
+//               with the whole depth histogram and latency histograms, for
+//               other tools to read. Latency bucket i counts commands that took
+//               less than 2 to the power i nanoseconds. The hot key cache gives
+//               its searches, hits and the total depth walked by the searches
+//               it did not answer.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  out - Output stream the JSON is written to.
+// OUTPUT:       N/A
+// CALLS TO:     depthHistogram
+//------------------------------------------------------------------------------
+
+void writeStatsJson(binarySearchTree *mainTree, ostream& out)
+{
+     vector<int> counts;
+     const basicCache<treeNode> *cache = mainTree->cache;
+     int height = depthHistogram(mainTree->root, counts),
+         depth;
+     
+     out << "{\n  \"integers\": " << nodeSize(mainTree->root) << ",\n  \"height\": " << height
+         << ",\n  \"balanced\": " << (mainTree->balanced ? "true" : "false")
+         << ",\n  \"depthHistogram\": [";
+     for (depth = 1; depth <= height; depth++)
+     {
+         out << ((depth > 1) ? ", " : "") << counts[depth];
+     }
+     out << "]";
+     
+     if (cache != NULL)
+     {
+         out << ",\n  \"hotCache\": {\"searches\": " << cache->lookups << ", \"hits\": " << cache->hits
+             << ", \"walkDepth\": " << cache->depth << "}";
+     }
+     else
+     {
+         out << ",\n  \"hotCache\": null";
+     }
+     
+#if defined(BST_STATS)
+     const char *OPERATION_NAMES[STATS_OPERATIONS] = {"find", "insert", "delete"};
+     const treeStats& stats = mainTree->stats;
+     size_t command;
+     int operation,
+         bucket;
+     
+     out << ",\n  \"countersBuiltIn\": true,\n  \"searches\": {";
+     for (operation = 0; operation < STATS_OPERATIONS; operation++)
+     {
+         out << ((operation > 0) ? ", " : "") << "\"" << OPERATION_NAMES[operation]
+             << "\": {\"calls\": " << stats.searches[operation] << ", \"comparisons\": "
+             << stats.comparisons[operation] << "}";
+     }
+     out << "},\n  \"frozenSearches\": " << stats.frozenSearches << ",\n  \"commandLatency\": {";
+     for (command = 0; command < MENU_COMMANDS; command++)
+     {
+         out << ((command > 0) ? ",\n    " : "\n    ") << "\"" << MENU_CHOICES[command] << "\": [";
+         for (bucket = 0; bucket < STATS_LATENCY_BUCKETS; bucket++)
+         {
+             out << ((bucket > 0) ? ", " : "") << stats.latency[command][bucket];
+         }
+         out << "]";
+     }
+     out << "\n  }";
+#else
+     out << ",\n  \"countersBuiltIn\": false";
+#endif
+     
+     out << "\n}" << endl;
+     
+     return;
+}
+
+#if defined(BST_STATS)
+//------------------------------------------------------------------------------
+// FUNCTION:     recordLatency
+// DESCRIPTION:  Adds the time a menu command took to its latency histogram.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+//                  command - The menu command.
+//                  start - When the command started its work.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void recordLatency(binarySearchTree *mainTree, char command, chrono::steady_clock::time_point start)
+{
+     const char *position = strchr(MENU_CHOICES, command);
+     unsigned long long elapsed = chrono::duration_cast<chrono::nanoseconds>(
+                                      chrono::steady_clock::now() - start).count();
+     int bucket = 0;
+     
+     while ((elapsed > 0) && (bucket < STATS_LATENCY_BUCKETS - 1))
+     {
+           elapsed >>= 1;
+           bucket++;
+     }
+     
+     if (position != NULL)
+     {
+         mainTree->stats.latency[position - MENU_CHOICES][bucket]++;
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     latencyPercentile
+// DESCRIPTION:  Finds the latency bucket a fraction of the commands fall within.
+// INPUT:
+//     Parameters:  buckets - The latency histogram of a command.
+//                  total - The number of commands in the histogram.
+//                  fraction - The fraction of commands, 0.5 for the median.
+// OUTPUT:
+//     Return Val:  limit - The upper limit of the bucket in nanoseconds.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+unsigned long long latencyPercentile(const unsigned long long buckets[], unsigned long long total,
+                                     double fraction)
+{
+     unsigned long long seen = 0;
+     int bucket = 0;
+     
+     seen = buckets[0];
+     while ((seen < fraction * total) && (bucket < STATS_LATENCY_BUCKETS - 1))
+     {
+           bucket++;
+           seen += buckets[bucket];
+     }
+     
+     return 1ULL << bucket;
+}
+#endif
+
+//------------------------------------------------------------------------------
+// FUNCTION:     freeNodes
+// DESCRIPTION:  Deallocates nodes from BST without recursion or a stack. While
+//               the current node has a left child it is rotated right, and a
+//               node with no left child is deleted before moving to its right.
+// INPUT:
+//     Parameters:  node - A pointer to a node in the BST.
+// OUTPUT:
+//     Parameters:  node - Same as input, passed by reference and set to NULL.
+// CALLS TO:     releaseNode
+//------------------------------------------------------------------------------
+
+template <typename Node>
+void freeNodes(Node *&node)
+{
+     Node *child;
+     
+     while (node != NULL)
+     {
+           if (node->leftPtr != NULL)
+           {
+               child = node->leftPtr;
+               node->leftPtr = child->rightPtr;
+               child->rightPtr = node;
+               node = child;
+           } // end if left child is rotated up
+           else
+           {
+               child = node->rightPtr;
+               releaseNode(node, NULL);
+               node = child;
+           } // end if node has no left child to free first
+     } // end while nodes remain
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     destroyTree
+// DESCRIPTION:  Deallocates main BST structure, its frozen index and its hot key
+//               cache from memory.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the main BST structure.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+// CALLS TO:     destroyCache
+//------------------------------------------------------------------------------
+
+template <typename Tree>
+void destroyTree(Tree *&mainTree)
+{
+     delete mainTree->frozen;
+     destroyCache(mainTree->cache);
+     delete mainTree;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     getOptions
+// DESCRIPTION:  Reads the command line options that select how the tree is
+//               maintained. Unknown options are reported and ignored.
+//                  -balanced  Keep the tree AVL balanced on insert and delete.
+//                  -bulk      Build the tree from the sorted file in one pass.
+//                  -arena     Allocate nodes from slabs instead of one at a time.
+//                  -hugepages Back the node slabs with huge pages (implies -arena).
+//                  -mmap      Map the input file into memory and parse it directly.
+//                  -frozen    Search a cache friendly copy of the tree, rebuilt
+//                             after adds and deletes once it is used enough.
+//                  -cache     Keep recent search results in a small hot key
+//                             cache in front of the tree, for skewed lookups.
+//                  -compact   Keep the integers in the compact node store, 12
+//                             bytes a node, with only the S, A, D, F and E
+//                             commands. Only -bulk, -mmap, -parallel (a sorted
+//                             build), -input and -batch apply to it; the other
+//                             options are reported as errors.
+//                  -parallel N    Read the file and build a balanced tree on N
+//                                 threads, or one per core when N is 0. Named
+//                                 trees and large set operations use them too.
+//                  -shards N      Split the tree by key range over N shards, or
+//                                 one per core when N is 0, each with its own
+//                                 worker thread, with only the S, A, D, F and E
+//                                 commands. Only -balanced, -arena, -hugepages,
+//                                 -cache, the load options and -batch apply to it;
+//                                 the other options are reported as errors.
+//                  -restore FILE  Rebuild the tree from a snapshot instead of a text file.
+//                  -save FILE     Write a snapshot of the tree on exit.
+//                  -batch FILE    Run the menu commands in FILE, or standard input
+//                                 when FILE is -, instead of displaying the menu.
+//                  -input FILE    Load the integers from FILE instead of asking
+//                                 for a file name, so a batch run reads nothing
+//                                 else from standard input.
+//                  -stats FILE    Write the tree statistics to FILE as JSON on exit.
+//                  -log FILE      Log the adds and deletes made to the main tree in
+//                                 FILE and replay them on the next start. The log
+//                                 is compacted into FILE.base, which is loaded in
+//                                 place of the input file or -restore snapshot.
+// INPUT:
+//     Parameters:  argc - Number of command line arguments.
+//                  argv - The command line arguments.
+// OUTPUT:
+//     Parameters:  options - The selected options, passed by reference.
+//     Return Val:  valid - Boolean value of whether the options can be used together.
+// CALLS TO:     allowOption
+//------------------------------------------------------------------------------
+
+bool getOptions(int argc, char *argv[], programOptions& options)
+{
+     int index;
+     bool valid = true;
+     
+     options.balanced = false;
+     options.bulkLoad = false;
+     options.arena = false;
+     options.hugePages = false;
+     options.mappedInput = false;
+     options.loadThreads = 1;
+     options.frozenLookups = false;
+     options.hotCache = false;
+     options.compactNodes = false;
+     options.shards = 0;
+     
+     for (index = 1; index < argc; index++)
+     {
+         if (strcmp(argv[index], "-balanced") == 0)
+         {
+             options.balanced = true;
+         }
+         else if (strcmp(argv[index], "-bulk") == 0)
+         {
+             options.bulkLoad = true;
+         }
+         else if (strcmp(argv[index], "-arena") == 0)
+         {
+             options.arena = true;
+         }
+         else if (strcmp(argv[index], "-hugepages") == 0)
+         {
+             options.arena = true;
+             options.hugePages = true;
+         }
+         else if (strcmp(argv[index], "-mmap") == 0)
+         {
+             options.mappedInput = true;
+         }
+         else if (strcmp(argv[index], "-frozen") == 0)
+         {
+             options.frozenLookups = true;
+         }
+         else if (strcmp(argv[index], "-cache") == 0)
+         {
+             options.hotCache = true;
+         }
+         else if (strcmp(argv[index], "-compact") == 0)
+         {
+             options.compactNodes = true;
+         }
+         else if ((strcmp(argv[index], "-parallel") == 0) && (index + 1 < argc))
+         {
+             index++;
+             options.loadThreads = atoi(argv[index]);
+             if (options.loadThreads < 1)
+             {
+                 options.loadThreads = static_cast<int>(thread::hardware_concurrency());
+             }
+             if (options.loadThreads < 1)
+             {
+                 options.loadThreads = 1;
+             }
+         }
+         else if ((strcmp(argv[index], "-shards") == 0) && (index + 1 < argc))
+         {
+             index++;
+             options.shards = atoi(argv[index]);
+             if (options.shards < 1)
+             {
+                 options.shards = static_cast<int>(thread::hardware_concurrency());
+             }
+             if (options.shards < 1)
+             {
+                 options.shards = 1;
+             }
+             else if (options.shards > MAX_SHARDS)
+             {
+                 options.shards = MAX_SHARDS;
+             }
+         }
+         else if ((strcmp(argv[index], "-restore") == 0) && (index + 1 < argc))
+         {
+             index++;
+             options.restoreFile = argv[index];
+         }
+         else if ((strcmp(argv[index], "-save") == 0) && (index + 1 < argc))
+         {
+             index++;
+             options.saveFile = argv[index];
+         }
+         else if ((strcmp(argv[index], "-batch") == 0) && (index + 1 < argc))
+         {
+             index++;
+             options.batchFile = argv[index];
+         }
+         else if ((strcmp(argv[index], "-input") == 0) && (index + 1 < argc))
+         {
+             index++;
+             options.inputFile = argv[index];
+         }
+         else if ((strcmp(argv[index], "-stats") == 0) && (index + 1 < argc))
+         {
+             index++;
+             options.statsFile = argv[index];
+         }
+         else if ((strcmp(argv[index], "-log") == 0) && (index + 1 < argc))
+         {
+             index++;
+             options.logFile = argv[index];
+         }
+         else
+         {
+             cout << "Unknown option " << argv[index] << " will be ignored." << endl;
+         }
+     } // end for each command line argument
+     
+     // the compact node store only loads the file and runs S, A, D, F and E
+     if (options.compactNodes)
+     {
+         valid = allowOption("-compact", "-balanced", options.balanced) && valid;
+         valid = allowOption("-compact", "-arena or -hugepages", options.arena) && valid;
+         valid = allowOption("-compact", "-frozen", options.frozenLookups) && valid;
+         valid = allowOption("-compact", "-cache", options.hotCache) && valid;
+         valid = allowOption("-compact", "-restore", !options.restoreFile.empty()) && valid;
+         valid = allowOption("-compact", "-save", !options.saveFile.empty()) && valid;
+         valid = allowOption("-compact", "-stats", !options.statsFile.empty()) && valid;
+         valid = allowOption("-compact", "-log", !options.logFile.empty()) && valid;
+     } // end if integers are kept in the compact node store
+     
+     // the sharded tree only loads the file and runs S, A, D, F and E
+     if (options.shards > 0)
+     {
+         valid = allowOption("-shards", "-compact", options.compactNodes) && valid;
+         valid = allowOption("-shards", "-frozen", options.frozenLookups) && valid;
+         valid = allowOption("-shards", "-restore", !options.restoreFile.empty()) && valid;
+         valid = allowOption("-shards", "-save", !options.saveFile.empty()) && valid;
+         valid = allowOption("-shards", "-stats", !options.statsFile.empty()) && valid;
+         valid = allowOption("-shards", "-log", !options.logFile.empty()) && valid;
+     } // end if the tree is split over shards
+     
+     return valid;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     allowOption
+// DESCRIPTION:  Reports an option that was given with a mode it does not apply to.
+// INPUT:
+//     Parameters:  mode - The option selecting the mode.
+//                  option - The option checked.
+//                  given - Boolean value of whether the option was given.
+// OUTPUT:
+//     Return Val:  allowed - Boolean value of whether the option was left out.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+bool allowOption(const char mode[], const char option[], bool given)
+{
+     if (given)
+     {
+         cout << "ERROR - " << option << " cannot be used with " << mode << "." << endl;
+     }
+     
+     return !given;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     createConcurrentTree
+// DESCRIPTION:  Creates a concurrent tree holding a balanced copy of the integers
+//               in a BST. Lookup threads search it with concurrentFind while one
+//               writer at a time changes it with concurrentInsert and
+//               concurrentDelete.
+// INPUT:
+//     Parameters:  source - A pointer to the BST to copy, NULL for an empty tree.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  memoryFail - Same as input, passed by reference.
+//     Return Val:  sharedTree - A pointer to the new tree, NULL on failure.
+// CALLS TO:     createTree
+//               startIterator
+//               nextNode
+//               buildBalanced
+//               freeNodes
+//               destroyTree
+//------------------------------------------------------------------------------
+
+concurrentTree *createConcurrentTree(binarySearchTree *source, bool& memoryFail)
+{
+    concurrentTree *sharedTree;
+    binarySearchTree *copyTree;
+    treeIterator iterator;
+    treeNode *node;
+    vector<int> keys;
+    int slot;
+    
+    sharedTree = new (nothrow) concurrentTree;
+    copyTree = createTree();
+    
+    if (sharedTree && copyTree)
+    {
+        if (source != NULL)
+        {
+            keys.reserve(source->count);
+            startIterator(iterator, source->root);
+            for (node = nextNode(iterator); node != NULL; node = nextNode(iterator))
+            {
+                keys.push_back(node->number);
+            }
+        } // end if integers are copied from a tree
+        
+        if (!keys.empty())
+        {
+            buildBalanced(copyTree->root, &keys[0], 0, static_cast<int>(keys.size()) - 1,
+                          copyTree, memoryFail);
+        }
+        
+        sharedTree->root.store(copyTree->root);
+        sharedTree->count.store(copyTree->count);
+        sharedTree->epoch.store(1);
+        for (slot = 0; slot < MAX_READERS; slot++)
+        {
+            sharedTree->readers[slot].epoch.store(0);
+            sharedTree->readers[slot].claimed.store(false);
+        }
+        copyTree->root = NULL;
+        
+        if (memoryFail)
+        {
+            destroyConcurrentTree(sharedTree);
+        }
+    } // end if memory allocated for both trees
+    else
+    {
+        delete sharedTree;
+        sharedTree = NULL;
+        memoryFail = true;
+    }
+    
+    if (copyTree)
+    {
+        destroyTree(copyTree);
+    }
+    
+    return sharedTree;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     registerReader
+// DESCRIPTION:  Claims a reader slot for a lookup thread. Each thread that calls
+//               concurrentFind needs a slot of its own.
+// INPUT:
+//     Parameters:  sharedTree - A pointer to the concurrent tree.
+// OUTPUT:
+//     Return Val:  slot - The slot claimed, -1 when all slots are in use.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+int registerReader(concurrentTree *sharedTree)
+{
+    int slot = -1,
+        index;
+    bool expected;
+    
+    for (index = 0; (index < MAX_READERS) && (slot < 0); index++)
+    {
+        expected = false;
+        if (sharedTree->readers[index].claimed.compare_exchange_strong(expected, true))
+        {
+            slot = index;
+        }
+    }
+    
+    return slot;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     unregisterReader
+// DESCRIPTION:  Releases a reader slot so another thread can claim it.
+// INPUT:
+//     Parameters:  sharedTree - A pointer to the concurrent tree.
+//                  slot - The slot to release.
+// OUTPUT:       N/A
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void unregisterReader(concurrentTree *sharedTree, int slot)
+{
+     sharedTree->readers[slot].epoch.store(0);
+     sharedTree->readers[slot].claimed.store(false);
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     concurrentFind
+// DESCRIPTION:  Searches the published tree without taking a lock. The reader
+//               announces the epoch it entered at, so no node it can reach is
+//               deleted until it leaves, and published nodes never change, so
+//               it always sees a whole tree.
+// INPUT:
+//     Parameters:  sharedTree - A pointer to the concurrent tree.
+//                  slot - The reader slot of the calling thread.
+//                  num - The integer that is the target value.
+// OUTPUT:
+//     Return Val:  found - Boolean value of whether the value was found.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+bool concurrentFind(concurrentTree *sharedTree, int slot, int num)
+{
+     treeNode *testNode;
+     bool found = false;
+     
+     sharedTree->readers[slot].epoch.store(sharedTree->epoch.load());
+     testNode = sharedTree->root.load();
+     
+     while ((testNode != NULL) && !found)
+     {
+           if (testNode->number == num)
+           {
+               found = true;
+           }
+           else if (testNode->number > num)
+           {
+               testNode = testNode->leftPtr;
+           }
+           else
+           {
+               testNode = testNode->rightPtr;
+           }
+     }
+     
+     sharedTree->readers[slot].epoch.store(0, memory_order_release);
+     
+     return found;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     concurrentInsert
+// DESCRIPTION:  Adds an integer by copying every node on the path to it, then
+//               publishing the new root in one store. Readers see the tree
+//               either before or after the insert, never part way through.
+// INPUT:
+//     Parameters:  sharedTree - A pointer to the concurrent tree.
+//                  num - The integer to add.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  memoryFail - Same as input, passed by reference.
+//     Return Val:  inserted - Boolean value of whether the integer was added.
+// CALLS TO:     ownNode
+//               createNode
+//               rebalanceCopy
+//               publishRoot
+//------------------------------------------------------------------------------
+
+bool concurrentInsert(concurrentTree *sharedTree, int num, bool& memoryFail)
+{
+     lock_guard<mutex> writer(sharedTree->writerLock);
+     treeUpdate update;
+     treeNode *newRoot,
+              *current,
+              **link;
+     treePath path;
+     bool exists = false,
+          inserted = false;
+     
+     newRoot = sharedTree->root.load();
+     
+     // only copy the path when the integer is not already there
+     current = newRoot;
+     while ((current != NULL) && !exists)
+     {
+           exists = (current->number == num);
+           current = (current->number > num) ? current->leftPtr : current->rightPtr;
+     }
+     
+     if (!exists)
+     {
+         path.length = 0;
+         link = &newRoot;
+         
+         while ((*link != NULL) && !memoryFail)
+         {
+               memoryFail = !ownNode(update, *link);
+               if (!memoryFail)
+               {
+                   path.link[path.length++] = link;
+                   link = ((*link)->number > num) ? &(*link)->leftPtr : &(*link)->rightPtr;
+               }
+         } // end while copying the path down
+         
+         if (!memoryFail)
+         {
+             *link = createNode(num);
+             memoryFail = (*link == NULL);
+             if (!memoryFail)
+             {
+                 update.copies.push_back(*link);
+             }
+         }
+         
+         while ((path.length > 0) && !memoryFail)
+         {
+               path.length--;
+               memoryFail = !rebalanceCopy(update, *path.link[path.length]);
+         }
+         
+         if (!memoryFail)
+         {
+             sharedTree->count++;
+             publishRoot(sharedTree, update, newRoot);
+             inserted = true;
+         } // end if the new version is complete
+         else
+         {
+             for (size_t index = 0; index < update.copies.size(); index++)
+             {
+                 releaseNode(update.copies[index], NULL);
+             }
+         } // end if the copies are thrown away
+     } // end if integer is not in the tree
+     
+     return inserted;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     concurrentDelete
+// DESCRIPTION:  Removes an integer by copying every node on the path to it and,
+//               for a node with two children, the path to its inorder
+//               predecessor, then publishing the new root in one store. The
+//               predecessor value is copied into a private node, so readers
+//               never see a value moved part way.
+// INPUT:
+//     Parameters:  sharedTree - A pointer to the concurrent tree.
+//                  num - The integer to remove.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  memoryFail - Same as input, passed by reference.
+//     Return Val:  deleted - Boolean value of whether the integer was removed.
+// CALLS TO:     ownNode
+//               rebalanceCopy
+//               publishRoot
+//------------------------------------------------------------------------------
+
+bool concurrentDelete(concurrentTree *sharedTree, int num, bool& memoryFail)
+{
+     lock_guard<mutex> writer(sharedTree->writerLock);
+     treeUpdate update;
+     treeNode *newRoot,
+              *current,
+              *target = NULL,
+              *targetCopy = NULL,
+              **link;
+     treePath path;
+     bool deleted = false;
+     
+     newRoot = sharedTree->root.load();
+     
+     // only copy the path when the integer is in the tree
+     current = newRoot;
+     while ((current != NULL) && (target == NULL))
+     {
+           if (current->number == num)
+           {
+               target = current;
+           }
+           current = (current->number > num) ? current->leftPtr : current->rightPtr;
+     }
+     
+     if (target != NULL)
+     {
+         path.length = 0;
+         link = &newRoot;
+         
+         while ((*link != target) && !memoryFail)
+         {
+               memoryFail = !ownNode(update, *link);
+               if (!memoryFail)
+               {
+                   path.link[path.length++] = link;
+                   link = ((*link)->number > num) ? &(*link)->leftPtr : &(*link)->rightPtr;
+               }
+         } // end while copying the path down to the target
+         
+         if (memoryFail)
+         {
+             // nothing is removed, the copies are thrown away below
+         } // end if path could not be copied
+         else if ((target->leftPtr == NULL) || (target->rightPtr == NULL))
+         {
+             *link = (target->leftPtr != NULL) ? target->leftPtr : target->rightPtr;
+             update.replaced.push_back(target);
+         } // end if target has at most one child
+         else
+         {
+             memoryFail = !ownNode(update, *link);
+             if (!memoryFail)
+             {
+                 targetCopy = *link;
+                 path.link[path.length++] = link;
+                 link = &(*link)->leftPtr;
+             }
+             
+             while (!memoryFail && ((*link)->rightPtr != NULL))
+             {
+                   memoryFail = !ownNode(update, *link);
+                   if (!memoryFail)
+                   {
+                       path.link[path.length++] = link;
+                       link = &(*link)->rightPtr;
+                   }
+             } // end while copying the path down to the predecessor
+             
+             if (!memoryFail)
+             {
+                 current = *link;
+                 targetCopy->number = current->number;
+                 *link = current->leftPtr;
+                 update.replaced.push_back(current);
+             } // end if predecessor replaces the target value
+         } // end if target has two children
+         
+         while ((path.length > 0) && !memoryFail)
+         {
+               path.length--;
+               memoryFail = !rebalanceCopy(update, *path.link[path.length]);
+         }
+         
+         if (!memoryFail)
+         {
+             sharedTree->count--;
+             publishRoot(sharedTree, update, newRoot);
+             deleted = true;
+         } // end if the new version is complete
+         else
+         {
+             for (size_t index = 0; index < update.copies.size(); index++)
+             {
+                 releaseNode(update.copies[index], NULL);
+             }
+         } // end if the copies are thrown away
+     } // end if integer is in the tree
+     
+     return deleted;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     ownNode
+// DESCRIPTION:  Makes sure the node in a link is a private copy the update may
+//               change. A published node is copied and the copy stored in the
+//               link; the original is kept until readers are done with it.
+// INPUT:
+//     Parameters:  update - The copies and replaced nodes of the update.
+//                  link - The link holding the node.
+// OUTPUT:
+//     Parameters:  update - Same as input, passed by reference.
+//                  link - Same as input, passed by reference.
+//     Return Val:  owned - Boolean value of whether the node could be copied.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+bool ownNode(treeUpdate& update, treeNode *&link)
+{
+     treeNode *copy;
+     bool owned = true;
+     
+     if (find(update.copies.begin(), update.copies.end(), link) == update.copies.end())
+     {
+         copy = new (nothrow) treeNode;
+         if (copy != NULL)
+         {
+             *copy = *link;
+             update.copies.push_back(copy);
+             update.replaced.push_back(link);
+             link = copy;
+         }
+         else
+         {
+             owned = false;
+         }
+     } // end if node is still published
+     
+     return owned;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     rebalanceCopy
+// DESCRIPTION:  Rebalances a private node like rebalanceNode, first copying the
+//               children a rotation would change.
+// INPUT:
+//     Parameters:  update - The copies and replaced nodes of the update.
+//                  node - The link holding the private node.
+// OUTPUT:
+//     Parameters:  update - Same as input, passed by reference.
+//                  node - Same as input, passed by reference.
+//     Return Val:  owned - Boolean value of whether the children could be copied.
+// CALLS TO:     nodeHeight
+//               ownNode
+//               rebalanceNode
+//------------------------------------------------------------------------------
+
+bool rebalanceCopy(treeUpdate& update, treeNode *&node)
+{
+     int balance = nodeHeight(node->leftPtr) - nodeHeight(node->rightPtr);
+     bool owned = true;
+     
+     if (balance > 1)
+     {
+         owned = ownNode(update, node->leftPtr);
+         if (owned && (nodeHeight(node->leftPtr->leftPtr) < nodeHeight(node->leftPtr->rightPtr)))
+         {
+             owned = ownNode(update, node->leftPtr->rightPtr);
+         }
+     } // end if left side is too tall
+     else if (balance < -1)
+     {
+         owned = ownNode(update, node->rightPtr);
+         if (owned && (nodeHeight(node->rightPtr->rightPtr) < nodeHeight(node->rightPtr->leftPtr)))
+         {
+             owned = ownNode(update, node->rightPtr->leftPtr);
+         }
+     } // end if right side is too tall
+     
+     if (owned)
+     {
+         rebalanceNode(node);
+     }
+     
+     return owned;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     publishRoot
+// DESCRIPTION:  Makes a finished update visible to readers with one store of the
+//               root, retires the nodes it replaced under the current epoch and
+//               starts a new epoch.
+// INPUT:
+//     Parameters:  sharedTree - A pointer to the concurrent tree.
+//                  update - The copies and replaced nodes of the update.
+//                  newRoot - The root of the updated tree.
+// OUTPUT:       N/A
+// CALLS TO:     reclaimNodes
+//------------------------------------------------------------------------------
+
+void publishRoot(concurrentTree *sharedTree, treeUpdate& update, treeNode *newRoot)
+{
+     retiredNode retired;
+     size_t index;
+     
+     sharedTree->root.store(newRoot);
+     
+     retired.epoch = sharedTree->epoch.fetch_add(1);
+     for (index = 0; index < update.replaced.size(); index++)
+     {
+         retired.node = update.replaced[index];
+         sharedTree->retired.push_back(retired);
+     }
+     
+     reclaimNodes(sharedTree);
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     reclaimNodes
+// DESCRIPTION:  Deletes the retired nodes no reader can still reach. A node
+//               retired in an epoch is safe once every active reader entered
+//               at a later epoch, since those readers started from a newer root.
+//               The safe nodes are always the oldest ones, so only they are
+//               visited and a snapshot kept open does not make every update
+//               go over the nodes it holds. Must be called with the writer
+//               lock held.
+// INPUT:
+//     Parameters:  sharedTree - A pointer to the concurrent tree.
+// OUTPUT:       N/A
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void reclaimNodes(concurrentTree *sharedTree)
+{
+     unsigned long long oldest = sharedTree->epoch.load(),
+                        readerEpoch;
+     int slot;
+     
+     for (slot = 0; slot < MAX_READERS; slot++)
+     {
+         readerEpoch = sharedTree->readers[slot].epoch.load();
+         if ((readerEpoch != 0) && (readerEpoch < oldest))
+         {
+             oldest = readerEpoch;
+         }
+     } // end for each reader slot
+     
+     while (!sharedTree->retired.empty() && (sharedTree->retired.front().epoch < oldest))
+     {
+           delete sharedTree->retired.front().node;
+           sharedTree->retired.pop_front();
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     openSnapshot
+// DESCRIPTION:  Takes a snapshot of the current version of a concurrent tree in
+//               constant time. The snapshot claims a reader slot and keeps the
+//               epoch it entered at for as long as it is open, so none of the
+//               nodes of its version are deleted while the writer goes on
+//               copying paths and publishing new versions. Nodes the writer
+//               did not change are shared with every later version.
+// INPUT:
+//     Parameters:  sharedTree - A pointer to the concurrent tree.
+//                  snapshot - The snapshot to open.
+// OUTPUT:
+//     Parameters:  snapshot - Same as input, passed by reference.
+//     Return Val:  opened - Boolean value of whether a reader slot was free.
+// CALLS TO:     registerReader
+//               nodeSize
+//------------------------------------------------------------------------------
+
+bool openSnapshot(concurrentTree *sharedTree, treeSnapshot& snapshot)
+{
+     binarySearchTree& view = snapshot.view;
+     
+     snapshot.slot = registerReader(sharedTree);
+     
+     view.root = NULL;
+     view.balanced = true;
+     view.arena = NULL;
+     view.frozen = NULL;
+     view.cache = NULL;
+#if defined(BST_STATS)
+     memset(&view.stats, 0, sizeof(view.stats));
+#endif
+     
+     if (snapshot.slot >= 0)
+     {
+         sharedTree->readers[snapshot.slot].epoch.store(sharedTree->epoch.load());
+         view.root = sharedTree->root.load();
+     }
+     view.count = nodeSize(view.root);
+     
+     return (snapshot.slot >= 0);
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     closeSnapshot
+// DESCRIPTION:  Releases a snapshot. The nodes only its version still used are
+//               deleted by the next insert or delete.
+// INPUT:
+//     Parameters:  sharedTree - A pointer to the concurrent tree.
+//                  snapshot - The snapshot to release.
+// OUTPUT:
+//     Parameters:  snapshot - Same as input, passed by reference.
+// CALLS TO:     unregisterReader
+//------------------------------------------------------------------------------
+
+void closeSnapshot(concurrentTree *sharedTree, treeSnapshot& snapshot)
+{
+     if (snapshot.slot >= 0)
+     {
+         unregisterReader(sharedTree, snapshot.slot);
+     }
+     
+     snapshot.slot = -1;
+     snapshot.view.root = NULL;
+     snapshot.view.count = 0;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     snapshotDisplay
+// DESCRIPTION:  Displays every integer of the current version of a concurrent
+//               tree in ascending order. The display reads a snapshot, so it
+//               can run on its own thread for as long as it takes while adds
+//               and deletes go on, and it shows the tree exactly as it was
+//               when the display started.
+// INPUT:
+//     Parameters:  sharedTree - A pointer to the concurrent tree.
+//                  currentColumn - An integers of how many columns have been displayed.
+//                  buffer - The display buffer the numbers are formatted into.
+//                  out - Stream the numbers are written to.
+// OUTPUT:
+//     Parameters:  currentColumn - Same as input, passed by reference.
+//                  buffer - Same as input, passed by reference.
+//     Return Val:  shown - The number of integers displayed, -1 when no reader
+//                          slot was free.
+// CALLS TO:     openSnapshot
+//               inOrderDisplay
+//               closeSnapshot
+//------------------------------------------------------------------------------
+
+int snapshotDisplay(concurrentTree *sharedTree, int& currentColumn, displayBuffer& buffer, ostream& out)
+{
+     treeSnapshot snapshot;
+     int shown = -1;
+     
+     if (openSnapshot(sharedTree, snapshot))
+     {
+         inOrderDisplay(snapshot.view.root, currentColumn, buffer, out);
+         shown = snapshot.view.count;
+     }
+     closeSnapshot(sharedTree, snapshot);
+     
+     return shown;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     destroyConcurrentTree
+// DESCRIPTION:  Deallocates a concurrent tree with its nodes and retired nodes.
+//               No reader may be searching it.
+// INPUT:
+//     Parameters:  sharedTree - A pointer to the concurrent tree.
+// OUTPUT:
+//     Parameters:  sharedTree - Same as input, passed by reference.
+// CALLS TO:     freeNodes
+//------------------------------------------------------------------------------
+
+void destroyConcurrentTree(concurrentTree *&sharedTree)
+{
+     treeNode *root = sharedTree->root.load();
+     size_t index;
+     
+     freeNodes(root);
+     for (index = 0; index < sharedTree->retired.size(); index++)
+     {
+         delete sharedTree->retired[index].node;
+     }
+     
+     delete sharedTree;
+     sharedTree = NULL;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     runCompact
+// DESCRIPTION:  Runs the program on the compact node store instead of the BST.
+//               The input file is loaded into it and the S, A, D, F and E
+//               commands are taken from the menu or the batch file the same
+//               way they are for the main tree.
+// INPUT:
+//     Parameters:  options - The command line options.
+// OUTPUT:       N/A
+// CALLS TO:     createCompactTree
+//               loadInputFile
+//               runCommands
+//               destroyTree
+//------------------------------------------------------------------------------
+
+void runCompact(const programOptions& options)
+{
+     compactTree *mainTree;
+     displayBuffer display;
+     bool memoryFail = false,
+          opened = false;
+     
+     mainTree = createCompactTree();
+     
+     if (mainTree)
+     {
+         opened = loadInputFile(options, mainTree, memoryFail);
+     }
+     else
+     {
+         memoryFail = true;
+     }
+     
+     if (!memoryFail && opened)
+     {
+         runCommands(options, mainTree, display, COMPACT_CHOICES);
+     }
+     else if (memoryFail)
+     {
+         cout << "ERROR - A memory allocation failure has occurred." << endl;
+         system("pause");
+     } // end if memory allocation failed
+     
+     if (mainTree)
+     {
+         destroyTree(mainTree);
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     parallelLoad
+// DESCRIPTION:  Loads a mapped input file into the compact node store for
+//               -parallel. The node array is built on one thread, so the
+//               sorted build of -bulk is used.
+// INPUT:
+//     Parameters:  scanner - The mapped input file.
+//                  mainTree - A pointer to the compact tree.
+//                  threadCount - The number of threads asked for.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  scanner - Same as input, passed by reference.
+//                  mainTree - Same as input, passed by reference.
+//                  memoryFail - Same as input, passed by reference.
+// CALLS TO:     bulkLoad
+//------------------------------------------------------------------------------
+
+void parallelLoad(integerScanner& scanner, compactTree *&mainTree, int, bool& memoryFail)
+{
+     bulkLoad(scanner, mainTree, memoryFail);
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     getData
+// DESCRIPTION:  Reads data from the input file into the compact node store.
+// INPUT:
+//     Parameters:  dataIn - Reading input stream or in memory scanner.
+//                  mainTree - A pointer to the compact tree.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  dataIn - Same as input, passed by reference.
+//                  mainTree - Same as input, passed by reference.
+//                  memoryFail - Same as input, passed by reference.
+// CALLS TO:     readInteger
+//               fingerInsert
+//               closeInput
+//------------------------------------------------------------------------------
+
+template <typename InputType>
+void getData(InputType& dataIn, compactTree *&mainTree, bool& memoryFail)
+{
+     vector<compactLevel> finger;
+     int number;
+     bool flag,
+          valid;
+
+     valid = readInteger(dataIn, number);
+     
+     // each number is added, or found to be a repeat, starting from the last one
+     while (valid && !memoryFail)
+     {
+         fingerInsert(mainTree, finger, number, flag, memoryFail);
+         
+         if (flag)
+         {
+             cout << endl << number << " already exists in tree and will be ignored." << endl;
+         }
+         
+         valid = readInteger(dataIn, number);
+     } // read data from input file until last number
+     
+     closeInput(dataIn);
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     bulkLoad
+// DESCRIPTION:  Reads every integer from the input file, sorts them and builds
+//               a height optimal compact tree from the sorted values. Repeated
+//               values get the same notices getData would display.
+// INPUT:
+//     Parameters:  dataIn - Reading input stream or in memory scanner.
+//                  mainTree - A pointer to the compact tree.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  dataIn - Same as input, passed by reference.
+//                  mainTree - Same as input, passed by reference.
+//                  memoryFail - Same as input, passed by reference.
+// CALLS TO:     collectIntegers
+//               closeInput
+//               sortUnique
+//               reportDuplicates
+//               buildCompact
+//------------------------------------------------------------------------------
+
+template <typename InputType>
+void bulkLoad(InputType& dataIn, compactTree *&mainTree, bool& memoryFail)
+{
+     vector<int> values,
+                 keys,
+                 duplicates;
+     
+     collectIntegers(dataIn, values);
+     closeInput(dataIn);
+     
+     keys = values;
+     sortUnique(keys, duplicates);
+     reportDuplicates(values, duplicates);
+     
+     if (!keys.empty())
+     {
+         mainTree->root = buildCompact(mainTree, &keys[0], 0, static_cast<int>(keys.size()) - 1,
+                                       memoryFail);
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     buildCompact
+// DESCRIPTION:  Builds a height optimal compact subtree from a range of sorted
+//               values. Nodes are created in preorder, so each subtree takes up
+//               one run of the node array.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the compact tree.
+//                  keys - Sorted values with no repeats.
+//                  first - Index of the first value in the range.
+//                  last - Index of the last value in the range.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  memoryFail - Same as input, passed by reference.
+//     Return Val:  node - Index of the root of the subtree, COMPACT_NULL when
+//                         the range is empty.
+// CALLS TO:     createNode
+//               buildCompact
+//------------------------------------------------------------------------------
+
+unsigned int buildCompact(compactTree *mainTree, const int keys[], int first, int last, bool& memoryFail)
+{
+     unsigned int node = COMPACT_NULL,
+                  child;
+     int middle;
+     
+     if ((first <= last) && !memoryFail)
+     {
+         middle = first + (last - first) / 2;
+         node = createNode(mainTree, keys[middle]);
+         
+         if (node != COMPACT_NULL)
+         {
+             mainTree->count++;
+             
+             // the node array may move while a subtree is built, so the child
+             // is stored only once it is finished
+             child = buildCompact(mainTree, keys, first, middle - 1, memoryFail);
+             mainTree->nodes[node].leftPtr = child;
+             child = buildCompact(mainTree, keys, middle + 1, last, memoryFail);
+             mainTree->nodes[node].rightPtr = child;
+         } // end if memory allocated for new node
+         else
+         {
+             memoryFail = true;
+         } // end memory not allocated
+     } // end if range holds values
+     
+     return node;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     fingerInsert
+// DESCRIPTION:  Adds a number to the compact tree starting from the last place
+//               the finger reached instead of the root, so nearly sorted input
+//               costs time in the distance from the previous number rather
+//               than the depth of the tree. The same walk finds a number that
+//               is already in the tree. The finger keeps at most
+//               FINGER_MAX_LEVELS nodes; the half nearest the root is dropped
+//               when it is full, and a number outside the nodes that are left
+//               starts again from the root.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the compact tree.
+//                  finger - The nodes passed through, empty before the first number.
+//                  num - The number to add.
+//                  found - Boolean value of whether the number was already in the tree.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+//                  finger - Same as input, passed by reference.
+//                  found - Same as input, passed by reference.
+//                  memoryFail - Same as input, passed by reference.
+//     Return Val:  node - Index of the node holding the number, COMPACT_NULL if
+//                         memory allocation failed.
+// CALLS TO:     createNode
+//------------------------------------------------------------------------------
+
+unsigned int fingerInsert(compactTree *mainTree, vector<compactLevel>& finger, int num, bool& found,
+                          bool& memoryFail)
+{
+     compactLevel level;
+     unsigned int node,
+                  parent = COMPACT_NULL;
+     
+     found = false;
+     
+     // climb until the number is within the range of a subtree
+     while (!finger.empty() && ((num <= finger.back().low) || (num >= finger.back().high)))
+     {
+           finger.pop_back();
+     }
+     
+     if (finger.empty() && (mainTree->root != COMPACT_NULL))
+     {
+         level.node = mainTree->root;
+         level.low = LLONG_MIN;
+         level.high = LLONG_MAX;
+         finger.push_back(level);
+     } // end if finger starts at the root
+     
+     node = finger.empty() ? COMPACT_NULL : finger.back().node;
+     
+     // walk down from there to the number or the empty link where it belongs
+     while ((node != COMPACT_NULL) && !found)
+     {
+           if (num == mainTree->nodes[node].number)
+           {
+               found = true;
+           }
+           else
+           {
+               level = finger.back();
+               parent = node;
+               
+               if (num < mainTree->nodes[node].number)
+               {
+                   node = mainTree->nodes[node].leftPtr;
+                   level.high = mainTree->nodes[parent].number;
+               }
+               else
+               {
+                   node = mainTree->nodes[node].rightPtr;
+                   level.low = mainTree->nodes[parent].number;
+               }
+               level.node = node;
+               
+               if (node != COMPACT_NULL)
+               {
+                   if (finger.size() >= FINGER_MAX_LEVELS)
+                   {
+                       finger.erase(finger.begin(), finger.begin() + FINGER_MAX_LEVELS / 2);
+                   }
+                   finger.push_back(level);
+               } // end if walk goes on to a child
+           } // end if number is not at this node
+     } // end while link points to a node
+     
+     if (!found)
+     {
+         // the node array may move, so the parent is linked by index afterwards
+         node = createNode(mainTree, num);
+         
+         if (node != COMPACT_NULL)
+         {
+             mainTree->count++;
+             
+             if (parent == COMPACT_NULL)
+             {
+                 mainTree->root = node;
+                 level.low = LLONG_MIN;
+                 level.high = LLONG_MAX;
+             } // end if tree was empty
+             else if (num < mainTree->nodes[parent].number)
+             {
+                 mainTree->nodes[parent].leftPtr = node;
+             }
+             else
+             {
+                 mainTree->nodes[parent].rightPtr = node;
+             }
+             
+             level.node = node;
+             if (finger.size() >= FINGER_MAX_LEVELS)
+             {
+                 finger.erase(finger.begin(), finger.begin() + FINGER_MAX_LEVELS / 2);
+             }
+             finger.push_back(level);
+         } // end if memory allocated for new node
+         else
+         {
+             memoryFail = true;
+         } // end memory not allocated
+     } // end if number is added
+     
+     return node;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     createCompactTree
+// DESCRIPTION:  Allocates an empty compact tree. The node array is allocated
+//               by the first createNode.
+// INPUT:        N/A
+// OUTPUT:
+//     Return Val:  mainTree - A pointer to the new tree, NULL on failure.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+compactTree *createCompactTree()
+{
+     compactTree *mainTree;
+     
+     mainTree = new (nothrow) compactTree;
+     
+     if (mainTree)
+     {
+         mainTree->nodes = NULL;
+         mainTree->used = COMPACT_NULL + 1;
+         mainTree->capacity = 0;
+         mainTree->root = COMPACT_NULL;
+         mainTree->freeList = COMPACT_NULL;
+         mainTree->count = 0;
+     }
+     
+     return mainTree;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     isEmptyTree
+// DESCRIPTION:  Tests to see if the compact tree holds no nodes.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the compact tree.
+// OUTPUT:
+//     Return Val:  empty - Boolean value of whether the tree is empty.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+bool isEmptyTree(compactTree *mainTree)
+{
+     return (mainTree->root == COMPACT_NULL);
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     createNode
+// DESCRIPTION:  Takes a node for a number from the compact tree. An index freed
+//               by a delete is reused first, otherwise the next unused entry of
+//               the node array is taken, doubling the array when it is full.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the compact tree.
+//                  num - The number to store in the node.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+//     Return Val:  newNode - Index of the new node, COMPACT_NULL if memory
+//                            allocation failed.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+unsigned int createNode(compactTree *mainTree, int num)
+{
+     compactNode *grown;
+     unsigned long long newCapacity;
+     unsigned int newNode = COMPACT_NULL;
+     
+     if (mainTree->freeList != COMPACT_NULL)
+     {
+         newNode = mainTree->freeList;
+         mainTree->freeList = mainTree->nodes[newNode].leftPtr;
+     } // end if a deleted node can be reused
+     else
+     {
+         if (mainTree->used >= mainTree->capacity)
+         {
+             newCapacity = max(2ULL * mainTree->capacity, static_cast<unsigned long long>(COMPACT_FIRST_NODES));
+             newCapacity = min(newCapacity, static_cast<unsigned long long>(COMPACT_MAX_NODES));
+             grown = NULL;
+             
+             if ((newCapacity > mainTree->capacity) && (newCapacity <= SIZE_MAX / sizeof(compactNode)))
+             {
+                 grown = static_cast<compactNode *>(realloc(mainTree->nodes,
+                                                            static_cast<size_t>(newCapacity) * sizeof(compactNode)));
+             }
+             
+             if (grown)
+             {
+                 mainTree->nodes = grown;
+                 mainTree->capacity = static_cast<unsigned int>(newCapacity);
+             }
+         } // end if node array is full
+         
+         if (mainTree->used < mainTree->capacity)
+         {
+             newNode = mainTree->used;
+             mainTree->used++;
+         }
+     }
+     
+     if (newNode != COMPACT_NULL)
+     {
+         mainTree->nodes[newNode].number = num;
+         mainTree->nodes[newNode].leftPtr = COMPACT_NULL;
+         mainTree->nodes[newNode].rightPtr = COMPACT_NULL;
+     }
+     
+     return newNode;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     releaseNode
+// DESCRIPTION:  Puts the index of a deleted node on the free list of the
+//               compact tree, chained through its leftPtr.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the compact tree.
+//                  node - Index of the node to release.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void releaseNode(compactTree *mainTree, unsigned int node)
+{
+     mainTree->nodes[node].leftPtr = mainTree->freeList;
+     mainTree->nodes[node].rightPtr = COMPACT_NULL;
+     mainTree->freeList = node;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     insertNode
+// DESCRIPTION:  Adds a node into the compact tree in ascending order.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the compact tree.
+//                  newNode - Index of the new node being inserted.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void insertNode(compactTree *mainTree, unsigned int newNode)
+{
+     compactNode *nodes = mainTree->nodes;
+     unsigned int *link;
+     int num = nodes[newNode].number;
+     
+     mainTree->count++;
+     link = &mainTree->root;
+     
+     while (*link != COMPACT_NULL)
+     {
+           if (num < nodes[*link].number)
+           {
+               link = &nodes[*link].leftPtr;
+           } // end if new number is less than current node number
+           else
+           {
+               link = &nodes[*link].rightPtr;
+           } // end if new number is greater than current node number
+     } // end while link points to a node
+     
+     *link = newNode;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     findNode
+// DESCRIPTION:  Searches the compact tree for a target number.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the compact tree.
+//                  num - The number to search for.
+//                  flag - Boolean value of whether the number was found.
+// OUTPUT:
+//     Parameters:  flag - Same as input, passed by reference.
+//     Return Val:  current - Index of the node holding the number, COMPACT_NULL
+//                            if it is not in the tree.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+unsigned int findNode(compactTree *mainTree, int num, bool& flag)
+{
+     const compactNode *nodes = mainTree->nodes;
+     unsigned int current = mainTree->root;
+     
+     flag = false;
+     
+     while ((current != COMPACT_NULL) && !flag)
+     {
+           if (num == nodes[current].number)
+           {
+               flag = true;
+           }
+           else if (num < nodes[current].number)
+           {
+               current = nodes[current].leftPtr;
+           }
+           else
+           {
+               current = nodes[current].rightPtr;
+           }
+     }
+     
+     return current;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     deleteNode
+// DESCRIPTION:  Traverses through the compact tree finding a target node that
+//               will be deleted.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the compact tree.
+//                  num - The target value to be deleted.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+// CALLS TO:     deleteFromTree
+//------------------------------------------------------------------------------
+
+void deleteNode(compactTree *mainTree, int num)
+{
+     compactNode *nodes = mainTree->nodes;
+     unsigned int *link = &mainTree->root;
+     
+     while ((*link != COMPACT_NULL) && (nodes[*link].number != num))
+     {
+           if (num < nodes[*link].number)
+           {
+               link = &nodes[*link].leftPtr;
+           }
+           else
+           {
+               link = &nodes[*link].rightPtr;
+           }
+     }
+     
+     if (*link != COMPACT_NULL)
+     {
+         deleteFromTree(mainTree, *link);
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     deleteFromTree
+// DESCRIPTION:  Deletes a node from the compact tree. A node with two children
+//               takes the value of its inorder predecessor, which is removed
+//               in its place. The index of the removed node is kept for reuse.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the compact tree.
+//                  nodeToRemove - The link holding the node that will be deleted.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+//                  nodeToRemove - Same as input, passed by reference.
+// CALLS TO:     releaseNode
+//------------------------------------------------------------------------------
+
+void deleteFromTree(compactTree *mainTree, unsigned int& nodeToRemove)
+{
+     compactNode *nodes = mainTree->nodes;
+     unsigned int tempNode,
+                  current,
+                  trail;
+     
+     if (nodes[nodeToRemove].leftPtr == COMPACT_NULL)
+     {
+         tempNode = nodeToRemove;
+         nodeToRemove = nodes[tempNode].rightPtr;
+         releaseNode(mainTree, tempNode);
+     } // end if node has no left child
+     else if (nodes[nodeToRemove].rightPtr == COMPACT_NULL)
+     {
+         tempNode = nodeToRemove;
+         nodeToRemove = nodes[tempNode].leftPtr;
+         releaseNode(mainTree, tempNode);
+     } // end if node has no right child
+     else
+     {
+         current = nodes[nodeToRemove].leftPtr;
+         trail = COMPACT_NULL;
+         
+         while (nodes[current].rightPtr != COMPACT_NULL)
+         {
+               trail = current;
+               current = nodes[current].rightPtr;
+         }
+         
+         nodes[nodeToRemove].number = nodes[current].number;
+         
+         if (trail == COMPACT_NULL)
+         {
+             nodes[nodeToRemove].leftPtr = nodes[current].leftPtr;
+         }
+         else
+         {
+             nodes[trail].rightPtr = nodes[current].leftPtr;
+         }
+         releaseNode(mainTree, current);
+     } // end if node has two children
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     inOrderDisplay
+// DESCRIPTION:  Displays all nodes of a compact subtree in ascending order,
+//               keeping the nodes whose right subtrees are still to be visited
+//               on a stack of indices.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the compact tree.
+//                  node - Index of the root of the subtree.
+//                  currentColumn - An integers of how many columns have been displayed.
+//                  buffer - The display buffer the numbers are formatted into.
+//                  out - Stream the numbers are written to.
+// OUTPUT:
+//     Parameters:  currentColumn - Same as input, passed by reference.
+//                  buffer - Same as input, passed by reference.
+// CALLS TO:     startDisplay
+//               formatDisplay
+//               flushDisplay
+//------------------------------------------------------------------------------
+
+void inOrderDisplay(compactTree *mainTree, unsigned int node, int& currentColumn, displayBuffer& buffer,
+                    ostream& out)
+{
+     const compactNode *nodes = mainTree->nodes;
+     vector<unsigned int> pending;
+     
+     startDisplay(buffer, out);
+     
+     while ((node != COMPACT_NULL) || !pending.empty())
+     {
+           while (node != COMPACT_NULL)
+           {
+                 pending.push_back(node);
+                 node = nodes[node].leftPtr;
+           }
+           
+           node = pending.back();
+           pending.pop_back();
+           formatDisplay(nodes[node].number, currentColumn, buffer);
+           node = nodes[node].rightPtr;
+     }
+     
+     flushDisplay(buffer);
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     addInteger
+// DESCRIPTION:  Adds a number to the compact tree unless it is already there.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the compact tree.
+//                  num - The number to add.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+//     Return Val:  status - BATCH_INSERTED, BATCH_DUPLICATE or BATCH_FAILED when
+//                           memory allocation failed.
+// CALLS TO:     findNode
+//               createNode
+//               insertNode
+//------------------------------------------------------------------------------
+
+char addInteger(compactTree *mainTree, int num)
+{
+     unsigned int newNode;
+     char status = BATCH_DUPLICATE;
+     bool flag;
+     
+     findNode(mainTree, num, flag);
+     if (!flag)
+     {
+         newNode = createNode(mainTree, num);
+         if (newNode != COMPACT_NULL)
+         {
+             insertNode(mainTree, newNode);
+             status = BATCH_INSERTED;
+         } // end if memory allocated for new node
+         else
+         {
+             status = BATCH_FAILED;
+         } // end memory not allocated
+     }
+     
+     return status;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     deleteInteger
+// DESCRIPTION:  Deletes a number from the compact tree if it is there.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the compact tree.
+//                  num - The number to delete.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+//     Return Val:  flag - Boolean value of whether the number was in the tree.
+// CALLS TO:     findNode
+//               deleteNode
+//------------------------------------------------------------------------------
+
+bool deleteInteger(compactTree *mainTree, int num)
+{
+     bool flag;
+     
+     findNode(mainTree, num, flag);
+     if (flag)
+     {
+         deleteNode(mainTree, num);
+         mainTree->count--;
+     }
+     
+     return flag;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     displayTree
+// DESCRIPTION:  Displays every integer of the compact tree in ascending order.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the compact tree.
+//                  buffer - The display buffer the numbers are formatted into.
+//                  out - Stream the numbers are written to.
+// OUTPUT:
+//     Parameters:  buffer - Same as input, passed by reference.
+// CALLS TO:     inOrderDisplay
+//------------------------------------------------------------------------------
+
+void displayTree(compactTree *mainTree, displayBuffer& buffer, ostream& out)
+{
+     int initColumn = INIT_COLUMN;
+     
+     inOrderDisplay(mainTree, mainTree->root, initColumn, buffer, out);
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     displaySubtree
+// DESCRIPTION:  Finds a number in the compact tree and displays the subtree
+//               below it.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the compact tree.
+//                  num - The number to find.
+//                  buffer - The display buffer the numbers are formatted into.
+//                  out - Stream the results are written to.
+// OUTPUT:
+//     Parameters:  buffer - Same as input, passed by reference.
+//     Return Val:  flag - Boolean value of whether the number is in the tree.
+// CALLS TO:     findNode
+//               reportFind
+//               inOrderDisplay
+//------------------------------------------------------------------------------
+
+bool displaySubtree(compactTree *mainTree, int num, displayBuffer& buffer, ostream& out)
+{
+     unsigned int miscNode;
+     int initColumn = INIT_COLUMN;
+     bool flag;
+     
+     miscNode = findNode(mainTree, num, flag);
+     reportFind(out, num, flag);
+     if (flag)
+     {
+         inOrderDisplay(mainTree, miscNode, initColumn, buffer, out);
+         out << endl;
+     }
+     
+     return flag;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     destroyTree
+// DESCRIPTION:  Deallocates the compact tree, releasing all of its nodes at once.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the compact tree.
+// OUTPUT:
+//     Parameters:  mainTree - Same as input, passed by reference.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void destroyTree(compactTree *&mainTree)
+{
+     free(mainTree->nodes);
+     delete mainTree;
+     mainTree = NULL;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     runSharded
+// DESCRIPTION:  Runs the program on a sharded tree. The input file is loaded
+//               into a tree set up the way the options select, its nodes are
+//               split by key range over the shards, and the S, A, D, F and E
+//               commands are taken from the menu or the batch file the same
+//               way they are for the main tree.
+// INPUT:
+//     Parameters:  options - The command line options.
+// OUTPUT:       N/A
+// CALLS TO:     createNamedTree
+//               loadInputFile
+//               createShardedTree
+//               releaseTree
+//               runCommands
+//               destroyTree
+//------------------------------------------------------------------------------
+
+void runSharded(const programOptions& options)
+{
+     binarySearchTree *loadTree;
+     shardedTree *shardTree = NULL;
+     treeCatalog catalog;
+     displayBuffer display;
+     bool memoryFail = false,
+          opened = false;
+     
+     // the shards are set up the same way as the main tree
+     catalog.balanced = options.balanced;
+     catalog.arena = options.arena;
+     catalog.hugePages = options.hugePages;
+     catalog.frozenLookups = false;
+     catalog.hotCache = options.hotCache;
+     catalog.threads = options.loadThreads;
+     catalog.log = NULL;
+     
+     // the file is loaded the way it is for the main tree, then split into the shards
+     loadTree = createNamedTree(catalog);
+     
+     if (loadTree)
+     {
+         opened = loadInputFile(options, loadTree, memoryFail);
+         
+         if (!memoryFail && opened)
+         {
+             shardTree = createShardedTree(loadTree, options.shards, catalog, memoryFail);
+         }
+         releaseTree(loadTree);
+     } // end if memory correctly allocated for loadTree
+     else
+     {
+         memoryFail = true;
+     }
+     
+     if (shardTree != NULL)
+     {
+         runCommands(options, shardTree, display, SHARD_CHOICES);
+     }
+     else if (!memoryFail && opened)
+     {
+         cout << "ERROR - The shard worker threads could not be started." << endl;
+     } // end if a worker thread could not be started
+     else if (memoryFail)
+     {
+         cout << "ERROR - A memory allocation failure has occurred." << endl;
+         system("pause");
+     } // end if memory allocation failed
+     
+     if (shardTree)
+     {
+         destroyTree(shardTree);
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     createShardedTree
+// DESCRIPTION:  Creates a sharded tree from the nodes of a BST and starts a
+//               worker thread for each shard. Each shard takes an equal share
+//               of the integers, so the key ranges follow the distribution of
+//               the file; when there are fewer integers than shards the
+//               positive integers are split evenly instead. The first shard
+//               also takes every integer below its range. The nodes are moved,
+//               not copied, so each shard keeps the shape its integers had in
+//               the BST; a balanced shard the split left out of balance is
+//               rebalanced.
+// INPUT:
+//     Parameters:  source - A pointer to a BST set up the way catalog selects,
+//                           NULL for an empty tree.
+//                  shardCount - The number of shards.
+//                  catalog - How the trees of the shards are set up.
+//                  memoryFail - Boolean value of memory allocation success/fail.
+// OUTPUT:
+//     Parameters:  source - Left empty once its nodes are moved, passed by reference.
+//                  memoryFail - Same as input, passed by reference.
+//     Return Val:  shardTree - A pointer to the new tree, NULL on failure. It
+//                              is NULL with no memory failure when a worker
+//                              thread could not be started.
+// CALLS TO:     nodeCount
+//               selectNode
+//               createNamedTree
+//               splitTree
+//               joinArena
+//               recalculateNodes
+//               balanceTree
+//               nodeSize
+//               runShard
+//               destroyTree
+//------------------------------------------------------------------------------
+
+shardedTree *createShardedTree(binarySearchTree *source, int shardCount, const treeCatalog& catalog,
+                               bool& memoryFail)
+{
+     shardedTree *shardTree;
+     treeShard *shard;
+     binarySearchTree *shardPart;
+     int index,
+         count = 0;
+     bool started = true;
+     
+     shardTree = new (nothrow) shardedTree;
+     
+     if (shardTree)
+     {
+         shardTree->stopping.store(false);
+         
+         if (source != NULL)
+         {
+             count = nodeCount(source);
+         }
+         
+         for (index = 0; (index < shardCount) && !memoryFail; index++)
+         {
+             shard = new (nothrow) treeShard;
+             if (shard)
+             {
+                 shard->head.store(0);
+                 shard->tail.store(0);
+                 shard->parked.store(false);
+                 shard->tree = createNamedTree(catalog);
+                 shardTree->shards.push_back(shard);
+                 memoryFail = (shard->tree == NULL);
+                 
+                 if (index == 0)
+                 {
+                     shard->low = INT_MIN;
+                 }
+                 else if (count >= shardCount)
+                 {
+                     shard->low = selectNode(source, static_cast<int>(static_cast<long long>(count) * index
+                                                                      / shardCount) + 1)->number;
+                 }
+                 else
+                 {
+                     shard->low = 1 + (INT_MAX / shardCount) * index;
+                 }
+             } // end if memory allocated for the shard
+             else
+             {
+                 memoryFail = true;
+             }
+         } // end for each shard
+         
+         // move the nodes of each range into its shard, the highest range first
+         if (!memoryFail && (source != NULL))
+         {
+             for (index = shardCount - 1; index > 0; index--)
+             {
+                 splitTree(source->root, shardTree->shards[index]->low, shardTree->shards[index]->tree->root);
+             }
+             shardTree->shards[0]->tree->root = source->root;
+             source->root = NULL;
+             source->count = 0;
+             
+             // the nodes stay in the arena they came from, which the first shard takes over
+             if ((source->arena != NULL) && (shardTree->shards[0]->tree->arena != NULL))
+             {
+                 joinArena(shardTree->shards[0]->tree->arena, source->arena);
+             }
+             
+             for (index = 0; index < shardCount; index++)
+             {
+                 shardPart = shardTree->shards[index]->tree;
+                 if (!recalculateNodes(shardPart->root) && shardPart->balanced)
+                 {
+                     balanceTree(shardPart);
+                 }
+                 shardPart->count = nodeSize(shardPart->root);
+             } // end for each shard
+         } // end if integers are moved from a tree
+         
+         for (index = 0; (index < shardCount) && !memoryFail && started; index++)
+         {
+             shard = shardTree->shards[index];
+             try
+             {
+                 shard->worker = thread(runShard, shardTree, shard);
+             }
+             catch (const system_error&)
+             {
+                 started = false;
+             }
+         } // end for each shard
+         
+         if (memoryFail || !started)
+         {
+             destroyTree(shardTree);
+         }
+     } // end if memory allocated for shardTree
+     else
+     {
+         memoryFail = true;
+     }
+     
+     return shardTree;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     splitTree
+// DESCRIPTION:  Moves the nodes holding integers at or above a value out of a
+//               tree into a second, empty, one. Only the nodes along one path
+//               are relinked, so every node keeps the nodes it had above and
+//               below it in its own range. Heights and sizes along the path
+//               are left for the caller to recalculate.
+// INPUT:
+//     Parameters:  root - The root of the tree to split.
+//                  low - The lowest integer moved.
+//                  upper - Set to the root of the moved nodes.
+// OUTPUT:
+//     Parameters:  root - Same as input, passed by reference.
+//                  upper - Same as input, passed by reference.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void splitTree(treeNode *&root, int low, treeNode *&upper)
+{
+     treeNode *node = root,
+              **lowLink = &root,
+              **highLink = &upper;
+     
+     while (node != NULL)
+     {
+           if (node->number < low)
+           {
+               *lowLink = node;
+               lowLink = &node->rightPtr;
+               node = node->rightPtr;
+           } // end if node stays in the lower tree
+           else
+           {
+               *highLink = node;
+               highLink = &node->leftPtr;
+               node = node->leftPtr;
+           } // end if node moves to the upper tree
+     } // end while the path goes on
+     
+     *lowLink = NULL;
+     *highLink = NULL;
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     findShard
+// DESCRIPTION:  Finds the shard whose key range holds an integer.
+// INPUT:
+//     Parameters:  shardTree - A pointer to the sharded tree.
+//                  num - The integer.
+// OUTPUT:
+//     Return Val:  shard - The index of the shard.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+int findShard(shardedTree *shardTree, int num)
+{
+     int shard = 0,
+         last = static_cast<int>(shardTree->shards.size()) - 1,
+         middle;
+     
+     // the last shard whose range starts at or below num
+     while (shard < last)
+     {
+           middle = shard + (last - shard + 1) / 2;
+           if (shardTree->shards[middle]->low <= num)
+           {
+               shard = middle;
+           }
+           else
+           {
+               last = middle - 1;
+           }
+     } // end while more than one shard remains
+     
+     return shard;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     runShard
+// DESCRIPTION:  Worker thread of a shard. Runs the batches in the shard's ring
+//               in the order they were queued, and moves head past each batch
+//               once its operations are done. An idle worker yields for a
+//               while and then parks until a batch is queued or the tree is
+//               destroyed.
+// INPUT:
+//     Parameters:  shardTree - A pointer to the sharded tree.
+//                  shard - A pointer to the shard served.
+// OUTPUT:       N/A
+// CALLS TO:     runOperation
+//------------------------------------------------------------------------------
+
+void runShard(shardedTree *shardTree, treeShard *shard)
+{
+     shardBatch *batch;
+     unsigned int head;
+     size_t index;
+     int idle = 0;
+     bool running = true;
+     
+     head = shard->head.load();
+     
+     while (running)
+     {
+           if (head != shard->tail.load())
+           {
+               batch = shard->ring[head % SHARD_QUEUE_SLOTS];
+               for (index = 0; index < batch->operations.size(); index++)
+               {
+                   runOperation(shard->tree, shard->display, *batch->operations[index]);
+               }
+               head++;
+               shard->head.store(head);
+               
+               // the group may be released as soon as its last batch is counted
+               {
+                   lock_guard<mutex> lock(batch->work->doneLock);
+                   batch->work->pending--;
+                   if (batch->work->pending == 0)
+                   {
+                       batch->work->done.notify_one();
+                   }
+               }
+               idle = 0;
+           } // end if a batch is queued
+           else if (shardTree->stopping.load())
+           {
+               running = false;
+           }
+           else if (idle < SHARD_IDLE_SPINS)
+           {
+               idle++;
+               this_thread::yield();
+           }
+           else
+           {
+               unique_lock<mutex> lock(shard->parkLock);
+               shard->parked.store(true);
+               while ((head == shard->tail.load()) && !shardTree->stopping.load())
+               {
+                     shard->wake.wait(lock);
+               }
+               shard->parked.store(false);
+           } // end if worker parks until it has work
+     } // end while the tree is in use
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     runOperation
+// DESCRIPTION:  Runs an add, delete or find on the tree of a shard the same way
+//               the menu runs it on the main tree. An add of an integer that
+//               is not positive is left for the report to reject.
+// INPUT:
+//     Parameters:  mainTree - A pointer to the tree of the shard.
+//                  display - The shard's display buffer for F.
+//                  operation - The operation to run.
+// OUTPUT:
+//     Parameters:  display - Same as input, passed by reference.
+//                  operation - Same as input, passed by reference.
+// CALLS TO:     addInteger
+//               deleteInteger
+//               findNode
+//               inOrderDisplay
+//------------------------------------------------------------------------------
+
+void runOperation(binarySearchTree *mainTree, displayBuffer& display, shardOperation& operation)
+{
+     treeNode *miscNode;
+     ostringstream subtree;
+     char status;
+     int initColumn = INIT_COLUMN;
+     bool flag;
+     
+     operation.done = false;
+     operation.memoryFail = false;
+     
+     switch(operation.action)
+     {
+         case 'A':
+              if (operation.number > 0)
+              {
+                  status = addInteger(mainTree, operation.number);
+                  operation.done = (status == BATCH_INSERTED);
+                  operation.memoryFail = (status == BATCH_FAILED);
+              }
+              break;
+              
+         case 'D':
+              operation.done = deleteInteger(mainTree, operation.number);
+              break;
+              
+         case 'F':
+              miscNode = findNode(mainTree, operation.number, flag);
+              if (miscNode != NULL)
+              {
+                  inOrderDisplay(miscNode, initColumn, display, subtree);
+                  operation.text = subtree.str();
+                  operation.done = true;
+              }
+              break;
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     readOperations
+// DESCRIPTION:  Reads batch commands for a group of adds, deletes and finds,
+//               until the group is full, the stream ends, or a command that is
+//               not an add, delete or find is read.
+// INPUT:
+//     Parameters:  commandIn - Stream of commands to read.
+//                  work - The group of operations to fill.
+// OUTPUT:
+//     Parameters:  work - Same as input, passed by reference.
+//     Return Val:  treeAction - The command that ended the group, ' ' when the
+//                               group is full or the stream ended.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+char readOperations(istream& commandIn, shardWork& work)
+{
+     shardOperation operation = shardOperation();
+     char treeAction = ' ';
+     bool reading = true;
+     
+     work.operations.clear();
+     
+     while (reading && (static_cast<int>(work.operations.size()) < SHARD_GROUP_OPERATIONS))
+     {
+           treeAction = ' ';
+           commandIn >> treeAction;
+           treeAction = toupper(treeAction);
+           
+           if (commandIn && ((treeAction == 'A') || (treeAction == 'D') || (treeAction == 'F')))
+           {
+               commandIn >> operation.number;
+               if (commandIn)
+               {
+                   operation.action = treeAction;
+                   work.operations.push_back(operation);
+               }
+               treeAction = ' ';
+           } // end if command is sent to a shard
+           
+           reading = (commandIn && (treeAction == ' '));
+     } // end while the group has room
+     
+     return treeAction;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     submitOperations
+// DESCRIPTION:  Splits a group of operations by shard and queues each shard its
+//               part as one batch, without waiting for them to run. Operations
+//               on one shard run in the order given, so a group may be queued
+//               while earlier groups are still running. The group must be kept
+//               until finishOperations has reported it.
+// INPUT:
+//     Parameters:  shardTree - A pointer to the sharded tree.
+//                  work - The group of operations.
+// OUTPUT:
+//     Parameters:  work - Same as input, passed by reference.
+// CALLS TO:     findShard
+//------------------------------------------------------------------------------
+
+void submitOperations(shardedTree *shardTree, shardWork& work)
+{
+     treeShard *shard;
+     unsigned int tail;
+     size_t index;
+     int batches = 0;
+     
+     work.batches.resize(shardTree->shards.size());
+     for (index = 0; index < work.batches.size(); index++)
+     {
+         work.batches[index].operations.clear();
+         work.batches[index].work = &work;
+     }
+     
+     for (index = 0; index < work.operations.size(); index++)
+     {
+         work.batches[findShard(shardTree, work.operations[index].number)].operations.push_back(
+             &work.operations[index]);
+     }
+     
+     for (index = 0; index < work.batches.size(); index++)
+     {
+         if (!work.batches[index].operations.empty())
+         {
+             batches++;
+         }
+     }
+     work.pending = batches;
+     
+     for (index = 0; index < work.batches.size(); index++)
+     {
+         if (!work.batches[index].operations.empty())
+         {
+             shard = shardTree->shards[index];
+             tail = shard->tail.load();
+             
+             // wait for the worker to free a slot when the ring is full
+             while (tail - shard->head.load() >= static_cast<unsigned int>(SHARD_QUEUE_SLOTS))
+             {
+                   this_thread::yield();
+             }
+             
+             shard->ring[tail % SHARD_QUEUE_SLOTS] = &work.batches[index];
+             shard->tail.store(tail + 1);
+             
+             if (shard->parked.load())
+             {
+                 lock_guard<mutex> lock(shard->parkLock);
+                 shard->wake.notify_one();
+             }
+         } // end if the shard has operations in the group
+     } // end for each shard
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     waitOperations
+// DESCRIPTION:  Waits for every shard to run its part of a group of operations.
+// INPUT:
+//     Parameters:  work - The group of operations.
+// OUTPUT:
+//     Parameters:  work - Same as input, passed by reference.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void waitOperations(shardWork& work)
+{
+     unique_lock<mutex> lock(work.doneLock);
+     
+     while (work.pending > 0)
+     {
+           work.done.wait(lock);
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     finishOperations
+// DESCRIPTION:  Waits for every shard to run its part of a group, then reports
+//               the operations in the order they were given, with the same
+//               messages as the menu. The report stops at an add that could
+//               not allocate its node.
+// INPUT:
+//     Parameters:  work - The group of operations.
+//                  out - Stream the results are written to.
+// OUTPUT:
+//     Parameters:  work - Same as input, passed by reference.
+//     Return Val:  memoryFail - Boolean value of whether an add ran out of memory.
+// CALLS TO:     waitOperations
+//               reportAdd
+//               reportDelete
+//               reportFind
+//------------------------------------------------------------------------------
+
+bool finishOperations(shardWork& work, ostream& out)
+{
+     size_t index;
+     char status;
+     bool memoryFail = false;
+     
+     waitOperations(work);
+     
+     for (index = 0; (index < work.operations.size()) && !memoryFail; index++)
+     {
+         const shardOperation& operation = work.operations[index];
+         
+         switch(operation.action)
+         {
+             case 'A':
+                  if (operation.memoryFail)
+                  {
+                      status = BATCH_FAILED;
+                      memoryFail = true;
+                  }
+                  else
+                  {
+                      status = operation.done ? BATCH_INSERTED : BATCH_DUPLICATE;
+                  }
+                  reportAdd(out, operation.number, status);
+                  break;
+                  
+             case 'D':
+                  reportDelete(out, operation.number, operation.done);
+                  break;
+                  
+             case 'F':
+                  reportFind(out, operation.number, operation.done);
+                  if (operation.done)
+                  {
+                      out << operation.text << endl;
+                  }
+                  break;
+         }
+     } // end for each operation in the group
+     
+     return memoryFail;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     sendOperation
+// DESCRIPTION:  Runs one add, delete or find of the menu on its shard and
+//               waits for it.
+// INPUT:
+//     Parameters:  shardTree - A pointer to the sharded tree.
+//                  work - The group the operation is sent in.
+//                  action - 'A', 'D' or 'F'.
+//                  num - The integer.
+// OUTPUT:
+//     Parameters:  work - Holds the finished operation, passed by reference.
+// CALLS TO:     submitOperations
+//               waitOperations
+//------------------------------------------------------------------------------
+
+void sendOperation(shardedTree *shardTree, shardWork& work, char action, int num)
+{
+     shardOperation operation = shardOperation();
+     
+     operation.action = action;
+     operation.number = num;
+     work.operations.clear();
+     work.operations.push_back(operation);
+     
+     submitOperations(shardTree, work);
+     waitOperations(work);
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     isEmptyTree
+// DESCRIPTION:  Checks whether every shard of a sharded tree is empty. No
+//               operations may be running.
+// INPUT:
+//     Parameters:  shardTree - A pointer to the sharded tree.
+// OUTPUT:
+//     Return Val:  Returns true when the shards hold no integers.
+// CALLS TO:     nodeCount
+//------------------------------------------------------------------------------
+
+bool isEmptyTree(shardedTree *shardTree)
+{
+     return (nodeCount(shardTree) == 0);
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     nodeCount
+// DESCRIPTION:  Adds up the integers held by every shard of a sharded tree. No
+//               operations may be running.
+// INPUT:
+//     Parameters:  shardTree - A pointer to the sharded tree.
+// OUTPUT:
+//     Return Val:  num - An integer of the total nodes in the shards.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+int nodeCount(shardedTree *shardTree)
+{
+     size_t index;
+     int num = 0;
+     
+     for (index = 0; index < shardTree->shards.size(); index++)
+     {
+         num += shardTree->shards[index]->tree->count;
+     }
+     
+     return num;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     inOrderDisplay
+// DESCRIPTION:  Displays every integer of a sharded tree in ascending order,
+//               shard after shard, with the columns carried on from one shard
+//               to the next so the layout is the same as for one tree. No
+//               operations may be running.
+// INPUT:
+//     Parameters:  shardTree - A pointer to the sharded tree.
+//                  currentColumn - An integers of how many columns have been displayed.
+//                  buffer - The display buffer the numbers are formatted into.
+//                  out - Stream the numbers are written to.
+// OUTPUT:
+//     Parameters:  currentColumn - Same as input, passed by reference.
+//                  buffer - Same as input, passed by reference.
+// CALLS TO:     inOrderDisplay
+//------------------------------------------------------------------------------
+
+void inOrderDisplay(shardedTree *shardTree, int& currentColumn, displayBuffer& buffer, ostream& out)
+{
+     size_t index;
+     
+     for (index = 0; index < shardTree->shards.size(); index++)
+     {
+         inOrderDisplay(shardTree->shards[index]->tree->root, currentColumn, buffer, out);
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     addInteger
+// DESCRIPTION:  Adds a number to the sharded tree unless it is already there.
+// INPUT:
+//     Parameters:  shardTree - A pointer to the sharded tree.
+//                  num - The number to add.
+// OUTPUT:
+//     Return Val:  status - BATCH_INSERTED, BATCH_DUPLICATE or BATCH_FAILED when
+//                           memory allocation failed.
+// CALLS TO:     sendOperation
+//------------------------------------------------------------------------------
+
+char addInteger(shardedTree *shardTree, int num)
+{
+     shardWork work;
+     char status = BATCH_DUPLICATE;
+     
+     sendOperation(shardTree, work, 'A', num);
+     if (work.operations[0].memoryFail)
+     {
+         status = BATCH_FAILED;
+     }
+     else if (work.operations[0].done)
+     {
+         status = BATCH_INSERTED;
+     }
+     
+     return status;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     deleteInteger
+// DESCRIPTION:  Deletes a number from the sharded tree if it is there.
+// INPUT:
+//     Parameters:  shardTree - A pointer to the sharded tree.
+//                  num - The number to delete.
+// OUTPUT:
+//     Return Val:  deleted - Boolean value of whether the number was in the tree.
+// CALLS TO:     sendOperation
+//------------------------------------------------------------------------------
+
+bool deleteInteger(shardedTree *shardTree, int num)
+{
+     shardWork work;
+     
+     sendOperation(shardTree, work, 'D', num);
+     
+     return work.operations[0].done;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     displayTree
+// DESCRIPTION:  Displays every integer of the sharded tree in ascending order.
+//               No operations may be running.
+// INPUT:
+//     Parameters:  shardTree - A pointer to the sharded tree.
+//                  buffer - The display buffer the numbers are formatted into.
+//                  out - Stream the numbers are written to.
+// OUTPUT:
+//     Parameters:  buffer - Same as input, passed by reference.
+// CALLS TO:     inOrderDisplay
+//------------------------------------------------------------------------------
+
+void displayTree(shardedTree *shardTree, displayBuffer& buffer, ostream& out)
+{
+     int initColumn = INIT_COLUMN;
+     
+     inOrderDisplay(shardTree, initColumn, buffer, out);
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     displaySubtree
+// DESCRIPTION:  Finds a number in its shard and displays the subtree below it,
+//               which the shard's worker formats into the operation's text.
+// INPUT:
+//     Parameters:  shardTree - A pointer to the sharded tree.
+//                  num - The number to find.
+//                  buffer - Not used, each shard formats with its own buffer.
+//                  out - Stream the results are written to.
+// OUTPUT:
+//     Return Val:  found - Boolean value of whether the number is in the tree.
+// CALLS TO:     sendOperation
+//               reportFind
+//------------------------------------------------------------------------------
+
+bool displaySubtree(shardedTree *shardTree, int num, displayBuffer&, ostream& out)
+{
+     shardWork work;
+     
+     sendOperation(shardTree, work, 'F', num);
+     reportFind(out, num, work.operations[0].done);
+     if (work.operations[0].done)
+     {
+         out << work.operations[0].text << endl;
+     }
+     
+     return work.operations[0].done;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     runBatch
+// DESCRIPTION:  Runs a stream of S, A, D and F commands on the sharded tree
+//               back to back until E or the end of the stream, with no prompts
+//               or pauses. Adds, deletes and finds are read in groups; each
+//               group is queued to the shards before the group ahead of it is
+//               reported, so the shards work while commands are read and
+//               results written. Any other command waits for the groups ahead
+//               of it.
+// INPUT:
+//     Parameters:  shardTree - A pointer to the sharded tree.
+//                  display - The display buffer for S.
+//                  choices - The commands the sharded tree supports.
+//                  commandIn - Stream of commands to run.
+//                  out - Stream the results are written to.
+// OUTPUT:
+//     Parameters:  shardTree - Same as input, passed by reference.
+//     Return Val:  treeAction - The last command, 'E' when the batch finished.
+// CALLS TO:     readOperations
+//               submitOperations
+//               finishOperations
+//               actionController
+//------------------------------------------------------------------------------
+
+char runBatch(shardedTree *&shardTree, displayBuffer& display, const char choices[], istream& commandIn,
+              ostream& out)
+{
+     shardWork works[2];
+     int current = 0;
+     char treeAction = ' ';
+     bool waiting = false,
+          memoryFail = false;
+     
+     while (commandIn && (treeAction != EXIT_CHAR))
+     {
+           treeAction = readOperations(commandIn, works[current]);
+           
+           if (!works[current].operations.empty())
+           {
+               submitOperations(shardTree, works[current]);
+           }
+           
+           // report the group ahead while this one runs
+           if (waiting)
+           {
+               memoryFail = finishOperations(works[1 - current], out) || memoryFail;
+           }
+           waiting = !works[current].operations.empty();
+           current = 1 - current;
+           
+           if ((treeAction != ' ') || memoryFail)
+           {
+               if (waiting)
+               {
+                   memoryFail = finishOperations(works[1 - current], out) || memoryFail;
+                   waiting = false;
+               }
+               
+               if (memoryFail)
+               {
+                   treeAction = EXIT_CHAR;
+               }
+               else if (strchr(choices, treeAction) == NULL)
+               {
+                   out << "ERROR - Invalid character selection " << treeAction << "." << endl;
+               }
+               else if (treeAction != EXIT_CHAR)
+               {
+                   actionController(shardTree, display, treeAction, commandIn, out, false);
+               }
+           } // end if a command waits for the groups ahead of it
+     } // end while commands remain
+     
+     if (waiting)
+     {
+         finishOperations(works[1 - current], out);
+     }
+     
+     out.flush();
+     
+     return EXIT_CHAR;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     destroyTree
+// DESCRIPTION:  Stops the worker threads of a sharded tree once their queued
+//               batches are done, and deallocates the shards and their trees.
+//               Every worker is stopped first, since the nodes of one shard may
+//               sit in the arena of another.
+// INPUT:
+//     Parameters:  shardTree - A pointer to the sharded tree.
+// OUTPUT:
+//     Parameters:  shardTree - Same as input, passed by reference.
+// CALLS TO:     releaseTree
+//------------------------------------------------------------------------------
+
+void destroyTree(shardedTree *&shardTree)
+{
+     size_t index;
+     
+     shardTree->stopping.store(true);
+     
+     for (index = 0; index < shardTree->shards.size(); index++)
+     {
+         {
+             lock_guard<mutex> lock(shardTree->shards[index]->parkLock);
+             shardTree->shards[index]->wake.notify_one();
+         }
+         
+         if (shardTree->shards[index]->worker.joinable())
+         {
+             shardTree->shards[index]->worker.join();
+         }
+     } // end for each shard
+     
+     for (index = 0; index < shardTree->shards.size(); index++)
+     {
+         if (shardTree->shards[index]->tree != NULL)
+         {
+             releaseTree(shardTree->shards[index]->tree);
+         }
+         delete shardTree->shards[index];
+     } // end for each shard
+     
+     delete shardTree;
+     shardTree = NULL;
+     
+     return;
+}
+#if defined(BST_BENCHMARK)
+//------------------------------------------------------------------------------
+// FUNCTION:     runBenchmarks
+// DESCRIPTION:  Times add, find, in order display and delete on generated
+//               workloads for each selected structure, distribution and size.
+//               A table is displayed and one CSV row per operation is written
+//               to the results file, with the number of integers added, found,
+//               displayed or deleted so the structures can be checked against
+//               each other. Built in place of the menu program when
+//               BST_BENCHMARK is defined.
+//                  -sizes N,N,...      Numbers of integers (default 1000,10000,100000,1000000).
+//                  -dist NAME,...      sorted, reverse, random, zipf, clustered (default all).
+//                  -structures NAME,...  bst, avl, arena (AVL with a node arena),
+//                                        set for std::set, shards for an AVL
+//                                        sharded tree, concurrent for the
+//                                        concurrent tree with lookup threads,
+//                                        snapshot for the concurrent tree
+//                                        changed under an open snapshot,
+//                                        finger for an unbalanced tree loaded
+//                                        as a file is, records for an AVL map
+//                                        of long long keys to strings
+//                                        (default bst,avl,set).
+//                  -out FILE           CSV results file (default bst-benchmark.csv).
+//                  -seed N             Seed for the generated workloads.
+//               On POSIX systems each structure runs in a process of its own,
+//               so the peak memory of its rows is its own; elsewhere it is the
+//               peak of the whole run so far.
+// INPUT:
+//     Parameters:  argc - Number of command line arguments.
+//                  argv - The command line arguments.
+// OUTPUT:
+//     Return Val:  Returns 0 when the results file could be written.
+// CALLS TO:     getBenchmarkOptions
+//               generateWorkload
+//               isolateBenchmark
+//------------------------------------------------------------------------------
+
+int runBenchmarks(int argc, char *argv[])
+{
+    benchmarkOptions options;
+    vector<int> keys,
+                queries;
+    ofstream results;
+    size_t sizeIndex,
+           distIndex,
+           structIndex;
+    int status = 0;
+    
+    getBenchmarkOptions(argc, argv, options);
+    
+    results.open(options.resultsFile.c_str());
+    if (!results)
+    {
+        cout << "ERROR - Results file " << options.resultsFile << " could not be opened." << endl;
+        status = 1;
+    }
+    else
+    {
+        results << "structure,distribution,size,operation,operations,found,seconds,opsPerSecond,"
+                << "p50Ns,p90Ns,p99Ns,p999Ns,maxNs,height,peakRssKb" << endl;
+        cout << left << setw(11) << "struct" << setw(10) << "dist" << right << setw(10) << "size"
+             << setw(10) << "op" << setw(14) << "ops/s" << setw(12) << "p50ns" << setw(12) << "p99ns"
+             << setw(12) << "p99.9ns" << setw(8) << "height" << setw(11) << "peakKB" << endl;
+    }
+    
+    for (sizeIndex = 0; (sizeIndex < options.sizes.size()) && (status == 0); sizeIndex++)
+    {
+        for (distIndex = 0; distIndex < options.distributions.size(); distIndex++)
+        {
+            generateWorkload(options.distributions[distIndex], options.sizes[sizeIndex], options.seed,
+                             keys, queries);
+            
+            for (structIndex = 0; structIndex < options.structures.size(); structIndex++)
+            {
+                isolateBenchmark(options.structures[structIndex], options.distributions[distIndex],
+                                 keys, queries, results);
+            }
+        } // end for each distribution
+    } // end for each size
+    
+    return status;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     getBenchmarkOptions
+// DESCRIPTION:  Reads the benchmark command line options described with
+//               runBenchmarks. Unknown options are reported and ignored.
+// INPUT:
+//     Parameters:  argc - Number of command line arguments.
+//                  argv - The command line arguments.
+// OUTPUT:
+//     Parameters:  options - The selected options, passed by reference.
+// CALLS TO:     splitList
+//------------------------------------------------------------------------------
+
+void getBenchmarkOptions(int argc, char *argv[], benchmarkOptions& options)
+{
+     vector<string> sizes;
+     size_t sizeIndex;
+     int index;
+     
+     splitList("1000,10000,100000,1000000", sizes);
+     splitList("sorted,reverse,random,zipf,clustered", options.distributions);
+     splitList("bst,avl,set", options.structures);
+     options.resultsFile = "bst-benchmark.csv";
+     options.seed = 12345;
+     
+     for (index = 1; index < argc; index++)
+     {
+         if ((strcmp(argv[index], "-sizes") == 0) && (index + 1 < argc))
+         {
+             sizes.clear();
+             splitList(argv[++index], sizes);
+         }
+         else if ((strcmp(argv[index], "-dist") == 0) && (index + 1 < argc))
+         {
+             options.distributions.clear();
+             splitList(argv[++index], options.distributions);
+         }
+         else if ((strcmp(argv[index], "-structures") == 0) && (index + 1 < argc))
+         {
+             options.structures.clear();
+             splitList(argv[++index], options.structures);
+         }
+         else if ((strcmp(argv[index], "-out") == 0) && (index + 1 < argc))
+         {
+             options.resultsFile = argv[++index];
+         }
+         else if ((strcmp(argv[index], "-seed") == 0) && (index + 1 < argc))
+         {
+             options.seed = strtoul(argv[++index], NULL, 10);
+         }
+         else
+         {
+             cout << "Unknown option " << argv[index] << " will be ignored." << endl;
+         }
+     } // end for each command line argument
+     
+     for (sizeIndex = 0; sizeIndex < sizes.size(); sizeIndex++)
+     {
+         options.sizes.push_back(strtoul(sizes[sizeIndex].c_str(), NULL, 10));
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     splitList
+// DESCRIPTION:  Splits a comma separated list into its items.
+// INPUT:
+//     Parameters:  list - The comma separated list.
+// OUTPUT:
+//     Parameters:  items - The items of the list, appended.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void splitList(const string& list, vector<string>& items)
+{
+     size_t start = 0,
+            comma;
+     
+     do
+     {
+         comma = list.find(',', start);
+         if (comma == string::npos)
+         {
+             comma = list.size();
+         }
+         if (comma > start)
+         {
+             items.push_back(list.substr(start, comma - start));
+         }
+         start = comma + 1;
+     }while (start < list.size());
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     generateWorkload
+// DESCRIPTION:  Generates the integers to add, in the order they are added, and
+//               the integers to look up.
+//                  sorted     1 to size in ascending order.
+//                  reverse    size down to 1.
+//                  random     Uniform values, with the repeats that brings.
+//                  zipf       Values drawn with Zipf skew (s = 0.99) from size
+//                             scattered ranks, so a few values repeat often.
+//                  clustered  Runs of 1000 consecutive values at random places.
+//               Lookups follow the same distribution; half of the uniform and
+//               ordered lookups miss.
+// INPUT:
+//     Parameters:  distribution - The name of the distribution.
+//                  size - The number of integers to generate.
+//                  seed - Seed for the random number generator.
+// OUTPUT:
+//     Parameters:  keys - The integers to add.
+//                  queries - The integers to look up.
+// CALLS TO:     createZipf
+//               nextZipf
+//------------------------------------------------------------------------------
+
+void generateWorkload(const string& distribution, size_t size, unsigned long seed,
+                      vector<int>& keys, vector<int>& queries)
+{
+     mt19937 random(seed);
+     zipfGenerator zipf;
+     size_t index,
+            start;
+     int base = 0;
+     
+     keys.resize(size);
+     queries.resize(size);
+     
+     if (distribution == "zipf")
+     {
+         createZipf(zipf, size);
+         for (index = 0; index < size; index++)
+         {
+             keys[index] = scatterRank(nextZipf(zipf, random));
+             queries[index] = scatterRank(nextZipf(zipf, random));
+         }
+     } // end if values are skewed
+     else
+     {
+         for (index = 0; index < size; index++)
+         {
+             if (distribution == "sorted")
+             {
+                 keys[index] = static_cast<int>(index + 1);
+             }
+             else if (distribution == "reverse")
+             {
+                 keys[index] = static_cast<int>(size - index);
+             }
+             else if (distribution == "clustered")
+             {
+                 if (index % BENCHMARK_CLUSTER_SIZE == 0)
+                 {
+                     base = static_cast<int>(random() % (INT_MAX - BENCHMARK_CLUSTER_SIZE)) + 1;
+                 }
+                 keys[index] = base + static_cast<int>(index % BENCHMARK_CLUSTER_SIZE);
+             }
+             else
+             {
+                 keys[index] = static_cast<int>(random() % INT_MAX) + 1;
+             }
+         } // end for each integer added
+         
+         // half of the lookups hit an added integer and half are new values
+         for (index = 0; index < size; index++)
+         {
+             start = random() % size;
+             if (index % 2 == 0)
+             {
+                 queries[index] = keys[start];
+             }
+             else if (distribution == "random")
+             {
+                 queries[index] = static_cast<int>(random() % INT_MAX) + 1;
+             }
+             else
+             {
+                 queries[index] = keys[start] + ((distribution == "clustered") ? BENCHMARK_CLUSTER_SIZE
+                                                                               : static_cast<int>(size));
+             }
+         } // end for each lookup
+     } // end if values are not skewed
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     createZipf
+// DESCRIPTION:  Prepares a Zipf distribution over ranks 1 to count using the
+//               method of Gray et al. from "Quickly Generating Billion-Record
+//               Synthetic Databases", which needs one pass to sum the weights
+//               and no tables.
+// INPUT:
+//     Parameters:  count - The number of ranks.
+// OUTPUT:
+//     Parameters:  zipf - The prepared generator.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+void createZipf(zipfGenerator& zipf, size_t count)
+{
+     size_t rank;
+     
+     zipf.count = (count > 1) ? count : 2;
+     zipf.theta = BENCHMARK_ZIPF_THETA;
+     zipf.zeta = 0.0;
+     for (rank = 1; rank <= zipf.count; rank++)
+     {
+         zipf.zeta += 1.0 / pow(static_cast<double>(rank), zipf.theta);
+     }
+     zipf.zetaTwo = 1.0 + 1.0 / pow(2.0, zipf.theta);
+     zipf.alpha = 1.0 / (1.0 - zipf.theta);
+     zipf.eta = (1.0 - pow(2.0 / zipf.count, 1.0 - zipf.theta)) / (1.0 - zipf.zetaTwo / zipf.zeta);
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     nextZipf
+// DESCRIPTION:  Draws the next rank from a Zipf distribution, rank 1 being the
+//               most frequent.
+// INPUT:
+//     Parameters:  zipf - The prepared generator.
+//                  random - The uniform random number generator.
+// OUTPUT:
+//     Parameters:  random - Same as input, advanced.
+//     Return Val:  rank - The rank drawn.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+size_t nextZipf(const zipfGenerator& zipf, mt19937& random)
+{
+     double uniform = generate_canonical<double, 32>(random),
+            scaled = uniform * zipf.zeta;
+     size_t rank;
+     
+     if (scaled < 1.0)
+     {
+         rank = 1;
+     }
+     else if (scaled < zipf.zetaTwo)
+     {
+         rank = 2;
+     }
+     else
+     {
+         rank = 1 + static_cast<size_t>(zipf.count * pow(zipf.eta * uniform - zipf.eta + 1.0, zipf.alpha));
+     }
+     
+     return rank;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     scatterRank
+// DESCRIPTION:  Maps a Zipf rank to a positive integer with a fixed mixing
+//               function, so the frequent values are spread over the tree
+//               instead of sitting together at its low end.
+// INPUT:
+//     Parameters:  rank - The rank to map.
+// OUTPUT:
+//     Return Val:  value - A positive integer unique to the rank.
+// CALLS TO:     N/A
+//------------------------------------------------------------------------------
+
+int scatterRank(size_t rank)
+{
+    unsigned int value = static_cast<unsigned int>(rank);
+    
+    // multiplication by an odd constant is a permutation of 31 bit values
+    value = (value * 2654435761U) & 0x7FFFFFFFU;
+    
+    return (value == 0) ? INT_MAX : static_cast<int>(value);
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     isolateBenchmark
+// DESCRIPTION:  Runs the benchmark of one structure on one workload. On POSIX
+//               systems it runs in a child process, which starts from the
+//               memory the workload holds, so the peak memory its rows report
+//               is not the most an earlier structure held. The rows are
+//               written by the child, and the streams are flushed on both
+//               sides of the fork so no row is written twice. When the child
+//               cannot be created the benchmark runs in this process.
+// INPUT:
+//     Parameters:  structure - The name of the structure.
+//                  distribution - The name of the distribution.
+//                  keys - The integers to add.
+//                  queries - The integers to look up.
+//                  results - The CSV results file.
+// OUTPUT:
+//     Parameters:  results - Same as input, passed by reference.
+// CALLS TO:     benchmarkStructure
+//------------------------------------------------------------------------------
+
+void isolateBenchmark(const string& structure, const string& distribution, const vector<int>& keys,
+                      const vector<int>& queries, ofstream& results)
+{
+#if defined(__unix__) || defined(__APPLE__)
+     pid_t child;
+     int childStatus = 0;
+     
+     cout.flush();
+     results.flush();
+     child = fork();
+     
+     if (child == 0)
+     {
+         benchmarkStructure(structure, distribution, keys, queries, results);
+         cout.flush();
+         results.flush();
+         _exit(results ? 0 : 1);
+     } // end if this is the child process
+     else if (child > 0)
+     {
+         waitpid(child, &childStatus, 0);
+         if (!WIFEXITED(childStatus) || (WEXITSTATUS(childStatus) != 0))
+         {
+             cout << "ERROR - The " << structure << " benchmark for " << distribution << " "
+                  << keys.size() << " did not finish." << endl;
+         }
+     } // end if the child process was created
+     else
+     {
+         benchmarkStructure(structure, distribution, keys, queries, results);
+     }
+#else
+     benchmarkStructure(structure, distribution, keys, queries, results);
+#endif
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     benchmarkStructure
+// DESCRIPTION:  Runs the benchmark of one structure on one workload. The
+//               unbalanced tree is skipped for large ordered workloads.
+// INPUT:
+//     Parameters:  structure - The name of the structure.
+//                  distribution - The name of the distribution.
+//                  keys - The integers to add.
+//                  queries - The integers to look up.
+//                  results - The CSV results file.
+// OUTPUT:
+//     Parameters:  results - Same as input, passed by reference.
+// CALLS TO:     benchmarkSet
+//               benchmarkShards
+//               benchmarkConcurrent
+//               benchmarkSnapshot
+//               benchmarkFinger
+//               benchmarkRecords
+//               benchmarkTree
+//------------------------------------------------------------------------------
+
+void benchmarkStructure(const string& structure, const string& distribution, const vector<int>& keys,
+                        const vector<int>& queries, ostream& results)
+{
+     if (structure == "set")
+     {
+         benchmarkSet(distribution, keys, queries, results);
+     }
+     else if (structure == "shards")
+     {
+         benchmarkShards(distribution, keys, queries, results);
+     }
+     else if (structure == "concurrent")
+     {
+         benchmarkConcurrent(distribution, keys, queries, results);
+     }
+     else if (structure == "snapshot")
+     {
+         benchmarkSnapshot(distribution, keys, results);
+     }
+     else if (structure == "finger")
+     {
+         benchmarkFinger(distribution, keys, results);
+     }
+     else if (structure == "records")
+     {
+         benchmarkRecords(distribution, keys, queries, results);
+     }
+     else if ((structure == "bst") && ((distribution == "sorted") || (distribution == "reverse"))
+              && (keys.size() > BENCHMARK_DEGENERATE_LIMIT))
+     {
+         cout << "bst skipped for " << distribution << " " << keys.size()
+              << ": an unbalanced tree of sorted input takes quadratic time." << endl;
+     } // end if unbalanced tree would degenerate to a list
+     else
+     {
+         benchmarkTree(structure, distribution, keys, queries, results);
+     }
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     benchmarkTree
+// DESCRIPTION:  Times the tree operations the menu uses on one workload: adding
+//               every integer (findNode, createNode, insertNode), finding every
+//               lookup value one at a time and in batches (findBatch), an in
+//               order display to a discarded stream, and deleting every integer
+//               (findNode, deleteNode).
+// INPUT:
+//     Parameters:  structure - bst, avl or arena.
+//                  distribution - The name of the distribution.
+//                  keys - The integers to add.
+//                  queries - The integers to look up.
+//                  results - The CSV results file.
+// OUTPUT:
+//     Parameters:  results - Same as input, passed by reference.
+// CALLS TO:     createTree
+//               createArena
+//               timeOperations
+//               findNode
+//               createNode
+//               insertNode
+//               findBatch
+//               inOrderDisplay
+//               deleteNode
+//               treeDepth
+//               reportResult
+//               destroyArena
+//               freeNodes
+//               destroyTree
+//------------------------------------------------------------------------------
+
+void benchmarkTree(const string& structure, const string& distribution, const vector<int>& keys,
+                   const vector<int>& queries, ostream& results)
+{
+     binarySearchTree *mainTree = createTree();
+     benchmarkResult result;
+     discardOutput discarded;
+     ostream discardStream(&discarded);
+     displayBuffer buffer;
+     vector<int> order(keys);
+     vector<treeNode *> batchNodes;
+     int column = INIT_COLUMN;
+     bool flag;
+     
+     mainTree->balanced = (structure != "bst");
+     if (structure == "arena")
+     {
+         mainTree->arena = createArena(false);
+     }
+     
+     result.structure = structure;
+     result.distribution = distribution;
+     result.size = keys.size();
+     
+     result.operation = "add";
+     timeOperations(keys.size(), result, [&](size_t index)
+     {
+         if (findNode(mainTree, keys[index], flag) == NULL)
+         {
+             insertNode(mainTree, createNode(keys[index], mainTree->arena));
+             result.found++;
+         }
+     });
+     result.height = treeDepth(mainTree->root);
+     reportResult(result, results);
+     
+     result.operation = "find";
+     timeOperations(queries.size(), result, [&](size_t index)
+     {
+         result.found += (findNode(mainTree, queries[index], flag) != NULL);
+     });
+     reportResult(result, results);
+     
+     // the same lookups BENCHMARK_BATCH_KEYS at a time, timed per batch and
+     // reported per lookup
+     batchNodes.resize(BENCHMARK_BATCH_KEYS);
+     result.operation = "findbatch";
+     timeOperations(queries.size(), result, [&](size_t first)
+     {
+         result.found += findBatch(mainTree, &queries[first],
+                                   static_cast<int>(min(BENCHMARK_BATCH_KEYS, queries.size() - first)),
+                                   &batchNodes[0]);
+     }, BENCHMARK_BATCH_KEYS);
+     reportResult(result, results);
+     
+     result.operation = "traverse";
+     timeOperations(1, result, [&](size_t)
+     {
+         inOrderDisplay(mainTree->root, column, buffer, discardStream);
+     });
+     result.operations = nodeSize(mainTree->root);
+     result.found = result.operations;
+     reportResult(result, results);
+     
+     // delete in a different order from the adds
+     shuffle(order.begin(), order.end(), mt19937(static_cast<unsigned>(keys.size())));
+     result.operation = "delete";
+     timeOperations(order.size(), result, [&](size_t index)
+     {
+         if (findNode(mainTree, order[index], flag) != NULL)
+         {
+             deleteNode(mainTree, order[index]);
+             mainTree->count--;
+             result.found++;
+         }
+     });
+     result.height = treeDepth(mainTree->root);
+     reportResult(result, results);
+     
+     if (mainTree->arena != NULL)
+     {
+         destroyArena(mainTree->arena);
+         mainTree->root = NULL;
+     }
+     else
+     {
+         freeNodes(mainTree->root);
+     }
+     destroyTree(mainTree);
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     benchmarkSet
+// DESCRIPTION:  Times the same operations as benchmarkTree on a std::set, as a
+//               baseline. Its height is not available and is reported as -1.
+// INPUT:
+//     Parameters:  distribution - The name of the distribution.
+//                  keys - The integers to add.
+//                  queries - The integers to look up.
+//                  results - The CSV results file.
+// OUTPUT:
+//     Parameters:  results - Same as input, passed by reference.
+// CALLS TO:     timeOperations
+//               startDisplay
+//               formatDisplay
+//               flushDisplay
+//               reportResult
+//------------------------------------------------------------------------------
+
+void benchmarkSet(const string& distribution, const vector<int>& keys, const vector<int>& queries,
+                  ostream& results)
+{
+     set<int> baseline;
+     benchmarkResult result;
+     discardOutput discarded;
+     ostream discardStream(&discarded);
+     displayBuffer buffer;
+     vector<int> order(keys);
+     set<int>::const_iterator position;
+     int column = INIT_COLUMN;
+     
+     result.structure = "set";
+     result.distribution = distribution;
+     result.size = keys.size();
+     result.height = -1;
+     
+     result.operation = "add";
+     timeOperations(keys.size(), result, [&](size_t index)
+     {
+         result.found += baseline.insert(keys[index]).second;
+     });
+     reportResult(result, results);
+     
+     result.operation = "find";
+     timeOperations(queries.size(), result, [&](size_t index)
+     {
+         result.found += (baseline.find(queries[index]) != baseline.end());
+     });
+     reportResult(result, results);
+     
+     result.operation = "traverse";
+     timeOperations(1, result, [&](size_t)
+     {
+         startDisplay(buffer, discardStream);
+         for (position = baseline.begin(); position != baseline.end(); ++position)
+         {
+             formatDisplay(*position, column, buffer);
+         }
+         flushDisplay(buffer);
+     });
+     result.operations = baseline.size();
+     result.found = result.operations;
+     reportResult(result, results);
+     
+     shuffle(order.begin(), order.end(), mt19937(static_cast<unsigned>(keys.size())));
+     result.operation = "delete";
+     timeOperations(order.size(), result, [&](size_t index)
+     {
+         result.found += baseline.erase(order[index]);
+     });
+     reportResult(result, results);
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     benchmarkShards
+// DESCRIPTION:  Times the same operations as benchmarkTree on a sharded tree of
+//               AVL trees, sent to the shards in groups the way a batch file
+//               sends them. The key ranges are set from a sample of the
+//               integers to add, which is removed again before the adds are
+//               timed. The height is that of the tallest shard.
+// INPUT:
+//     Parameters:  distribution - The name of the distribution.
+//                  keys - The integers to add.
+//                  queries - The integers to look up.
+//                  results - The CSV results file.
+// OUTPUT:
+//     Parameters:  results - Same as input, passed by reference.
+// CALLS TO:     createNamedTree
+//               findNode
+//               createNode
+//               insertNode
+//               createShardedTree
+//               releaseTree
+//               runGroup
+//               timeOperations
+//               treeDepth
+//               reportResult
+//               inOrderDisplay
+//               nodeCount
+//               destroyTree
+//------------------------------------------------------------------------------
+
+void benchmarkShards(const string& distribution, const vector<int>& keys, const vector<int>& queries,
+                     ostream& results)
+{
+     binarySearchTree *source;
+     shardedTree *shardTree = NULL;
+     treeCatalog catalog;
+     benchmarkResult result;
+     discardOutput discarded;
+     ostream discardStream(&discarded);
+     displayBuffer buffer;
+     shardWork work;
+     vector<int> order(keys),
+                 sample;
+     size_t index,
+            sampleSize = min(keys.size(), BENCHMARK_SHARD_SAMPLE);
+     int column = INIT_COLUMN;
+     bool flag,
+          memoryFail = false;
+     
+     catalog.balanced = true;
+     catalog.arena = false;
+     catalog.hugePages = false;
+     catalog.frozenLookups = false;
+     catalog.hotCache = false;
+     catalog.threads = 1;
+     catalog.log = NULL;
+     
+     // integers spread evenly through the adds set the key ranges
+     source = createNamedTree(catalog);
+     if (source)
+     {
+         for (index = 0; index < sampleSize; index++)
+         {
+             sample.push_back(keys[index * keys.size() / sampleSize]);
+             if (findNode(source, sample.back(), flag) == NULL)
+             {
+                 insertNode(source, createNode(sample.back(), source->arena));
+             }
+         } // end for each integer in the sample
+         
+         shardTree = createShardedTree(source, BENCHMARK_SHARDS, catalog, memoryFail);
+         releaseTree(source);
+     } // end if memory allocated for source
+     
+     if (shardTree == NULL)
+     {
+         cout << "shards skipped for " << distribution << " " << keys.size()
+              << ": the sharded tree could not be created." << endl;
+     }
+     else
+     {
+         runGroup(shardTree, work, 'D', sample, 0);
+         
+         result.structure = "shards";
+         result.distribution = distribution;
+         result.size = keys.size();
+         
+         result.operation = "add";
+         timeOperations(keys.size(), result, [&](size_t first)
+         {
+             result.found += runGroup(shardTree, work, 'A', keys, first);
+         }, SHARD_GROUP_OPERATIONS);
+         result.height = 0;
+         for (index = 0; index < shardTree->shards.size(); index++)
+         {
+             result.height = max(result.height, treeDepth(shardTree->shards[index]->tree->root));
+         }
+         reportResult(result, results);
+         
+         result.operation = "find";
+         timeOperations(queries.size(), result, [&](size_t first)
+         {
+             result.found += runGroup(shardTree, work, 'F', queries, first);
+         }, SHARD_GROUP_OPERATIONS);
+         reportResult(result, results);
+         
+         result.operation = "traverse";
+         timeOperations(1, result, [&](size_t)
+         {
+             inOrderDisplay(shardTree, column, buffer, discardStream);
+         });
+         result.operations = nodeCount(shardTree);
+         result.found = result.operations;
+         reportResult(result, results);
+         
+         shuffle(order.begin(), order.end(), mt19937(static_cast<unsigned>(keys.size())));
+         result.operation = "delete";
+         timeOperations(order.size(), result, [&](size_t first)
+         {
+             result.found += runGroup(shardTree, work, 'D', order, first);
+         }, SHARD_GROUP_OPERATIONS);
+         result.height = 0;
+         for (index = 0; index < shardTree->shards.size(); index++)
+         {
+             result.height = max(result.height, treeDepth(shardTree->shards[index]->tree->root));
+         }
+         reportResult(result, results);
+         
+         destroyTree(shardTree);
+     } // end if the sharded tree was created
+     
+     return;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     runGroup
+// DESCRIPTION:  Sends up to SHARD_GROUP_OPERATIONS integers to the shards as
+//               one group of adds, deletes or finds and waits for it.
+// INPUT:
+//     Parameters:  shardTree - A pointer to the sharded tree.
+//                  work - The group the operations are sent in.
+//                  action - 'A', 'D' or 'F'.
+//                  numbers - The integers.
+//                  first - The index of the first integer of the group.
+// OUTPUT:
+//     Parameters:  work - Holds the finished group, passed by reference.
+//     Return Val:  done - The number of integers added, deleted or found.
+// CALLS TO:     submitOperations
+//               waitOperations
+//------------------------------------------------------------------------------
+
+size_t runGroup(shardedTree *shardTree, shardWork& work, char action, const vector<int>& numbers,
+                size_t first)
+{
+     shardOperation operation = shardOperation();
+     size_t index,
+            last = min(numbers.size(), first + SHARD_GROUP_OPERATIONS),
+            done = 0;
+     
+     operation.action = action;
+     work.operations.clear();
+     for (index = first; index < last; index++)
+     {
+         operation.number = numbers[index];
+         work.operations.push_back(operation);
+     }
+     
+     submitOperations(shardTree, work);
+     waitOperations(work);
+     
+     for (index = 0; index < work.operations.size(); index++)
+     {
+         done += work.operations[index].done;
+     }
+     
+     return done;
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     benchmarkConcurrent
+// DESCRIPTION:  Times the same operations as benchmarkTree on a concurrent
+//               tree while BENCHMARK_READERS lookup threads search it without
+//               stopping. The adds, finds and deletes run on the writer, the
+//               display reads a snapshot, and one more row gives the lookups
+//               the reader threads made over the whole run.
+// INPUT:
+//     Parameters:  distribution - The name of the distribution.
+//                  keys - The integers to add.
+//                  queries - The integers to look up.
+//                  results - The CSV results file.
+// OUTPUT:
+//     Parameters:  results - Same as input, passed by reference.
+// CALLS TO:     createConcurrentTree
+//               registerReader
+//               concurrentFind
+//               unregisterReader
+//               timeOperations
+//               concurrentInsert
+//               treeDepth
+//               reportResult
+//               snapshotDisplay
+//               concurrentDelete
+//               destroyConcurrentTree
+//------------------------------------------------------------------------------
+
+void benchmarkConcurrent(const string& distribution, const vector<int>& keys, const vector<int>& queries,
+                         ostream& results)
+{
+     concurrentTree *sharedTree;
+     benchmarkResult result;
+     discardOutput discarded;
+     ostream discardStream(&discarded);
+     displayBuffer buffer;
+     vector<int> order(keys);
+     vector<thread> readers;
+     vector<size_t> lookups(BENCHMARK_READERS, 0),
+                    hits(BENCHMARK_READERS, 0);
+     atomic<bool> stopping(false);
+     chrono::steady_clock::time_point start;
+     size_t index;
+     int column = INIT_COLUMN,
+         slot,
+         rank;
+     bool memoryFail = false;
+     
+     sharedTree = createConcurrentTree(NULL, memoryFail);
+     slot = (sharedTree != NULL) ? registerReader(sharedTree) : -1;
+     
+     if (slot < 0)
+     {
+         cout << "concurrent skipped for " << distribution << " " << keys.size()
+              << ": the concurrent tree could not be created." << endl;
+     }
+     else
+     {
+         result.structure = "concurrent";
+         result.distribution = distribution;
+         result.size = keys.size();
+         
+         // each lookup thread goes round the lookups from its own place
+         start = chrono::steady_clock::now();
+         for (index = 0; index < lookups.size(); index++)
+         {
+             try
+             {
+                 readers.push_back(thread([&, index]()
+                 {
+                     size_t next = index * queries.size() / lookups.size();
+                     int readerSlot = registerReader(sharedTree);
+                     
+                     while ((readerSlot >= 0) && !queries.empty() && !stopping.load())
+                     {
+                           hits[index] += concurrentFind(sharedTree, readerSlot, queries[next]);
+                           lookups[index]++;
+                           next = (next + 1 < queries.size()) ? next + 1 : 0;
+                     }
+                     
+                     if (readerSlot >= 0)
+                     {
+                         unregisterReader(sharedTree, readerSlot);
+                     }
+                 }));
+             }
+             catch (const system_error&)
+             {
+                 cout << "Only " << readers.size() << " lookup threads could be started." << endl;
+                 index = lookups.size();
+             }
+         } // end for each lookup thread
+         
+         result.operation = "add";
+         timeOperations(keys.size(), result, [&](size_t index)
+         {
+             result.found += concurrentInsert(sharedTree, keys[index], memoryFail);
+         });
+         result.height = treeDepth(sharedTree->root.load());
+         reportResult(result, results);
+         
+         result.operation = "find";
+         timeOperations(queries.size(), result, [&](size_t index)
+         {
+             result.found += concurrentFind(sharedTree, slot, queries[index]);
+         });
+         reportResult(result, results);
+         
+         result.operation = "traverse";
+         timeOperations(1, result, [&](size_t)
+         {
+             snapshotDisplay(sharedTree, column, buffer, discardStream);
+         });
+         result.operations = sharedTree->count.load();
+         result.found = result.operations;
+         reportResult(result, results);
+         
+         shuffle(order.begin(), order.end(), mt19937(static_cast<unsigned>(keys.size())));
+         result.operation = "delete";
+         timeOperations(order.size(), result, [&](size_t index)
+         {
+             result.found += concurrentDelete(sharedTree, order[index], memoryFail);
+         });
+         result.height = treeDepth(sharedTree->root.load());
+         reportResult(result, results);
+         
+         stopping.store(true);
+         for (index = 0; index < readers.size(); index++)
+         {
+             readers[index].join();
+         }
+         
+         // the lookups made by the reader threads while the rows above ran
+         result.operation = "readers";
+         result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+         result.operations = 0;
+         result.found = 0;
+         for (index = 0; index < readers.size(); index++)
+         {
+             result.operations += lookups[index];
+             result.found += hits[index];
+         }
+         for (rank = 0; rank < BENCHMARK_PERCENTILES; rank++)
+         {
+             result.latency[rank] = 0;
+         }
+         reportResult(result, results);
+         
+         unregisterReader(sharedTree, slot);
+     } // end if the concurrent tree was created
      
-     if (!isEmptyTree(mainTree))
-     {
-         cout << "\nThere are " << nodeCount(mainTree) << " integers in the binary search tree." << endl << endl;
-     }
-     else
+     if (sharedTree != NULL)
      {
-         cout << "\nBinary search tree is empty." << endl << endl;
+         destroyConcurrentTree(sharedTree);
      }
      
-     cout << "--------------------Menu Options--------------------" << endl
-          << "S - Show all integerrs in the binary search tree." << endl
-          << "A - Add an integer to the tree." << endl
-          << "D - Delete an integer from the tree." << endl
-          << "F - Find an integer and display its subtree." << endl
-          << "E - Exit the program." << endl;
-     do
-     {
-          cout << "Enter a choice from the options above: ";
-          cin >> menuChoice;
-          menuChoice = toupper(menuChoice);
-          if ((menuChoice != 'S') && (menuChoice != 'A') && (menuChoice != 'D') && (menuChoice != 'F') && (menuChoice != 'E'))
-          {
-              cout << "ERROR - Invalid character selection." << endl;
-          }
-     }while ((menuChoice != 'S') && (menuChoice != 'A') && (menuChoice != 'D') && (menuChoice != 'F') && (menuChoice != 'E'));
-     
-     return menuChoice;
+     return;
 }
 
 //------------------------------------------------------------------------------
-// FUNCTION:     actionController
-// DESCRIPTION:  Makes calls to the functions selected by the user.
+// FUNCTION:     benchmarkSnapshot
+// DESCRIPTION:  Times a concurrent tree changed while a snapshot of it is open.
+//               Every integer is added, a snapshot is opened and every integer
+//               is deleted again, so each delete retires nodes the snapshot
+//               still holds. The snapshot is then displayed and walked to
+//               check it still holds every integer added, in order, and the
+//               first update after it is closed deletes the retired nodes.
 // INPUT:
-//     Parameters:  mainTree - A pointer to the main BST structure.
-//                  treeAction - A character of what action will be taken.
+//     Parameters:  distribution - The name of the distribution.
+//                  keys - The integers to add.
+//                  results - The CSV results file.
 // OUTPUT:
-//     Parameters:  mainTree - Same as input, passed by reference.
-//                  treeAction - Same as input, passed by reference.
-// CALLS TO:     isEmptyTree
+//     Parameters:  results - Same as input, passed by reference.
+// CALLS TO:     createConcurrentTree
+//               timeOperations
+//               concurrentInsert
+//               treeDepth
+//               reportResult
+//               openSnapshot
+//               concurrentDelete
 //               inOrderDisplay
-//               findNode
-//               createNode
-//               insertNode
-//               deleteNode
+//               startIterator
+//               nextNode
+//               closeSnapshot
+//               destroyConcurrentTree
 //------------------------------------------------------------------------------
 
-void actionController(binarySearchTree *&mainTree, char& treeAction)
+void benchmarkSnapshot(const string& distribution, const vector<int>& keys, ostream& results)
 {
-     treeNode *miscNode;
-     int num,
-         initColumn = INIT_COLUMN;
-     bool flag;
+     concurrentTree *sharedTree;
+     treeSnapshot snapshot;
+     benchmarkResult result;
+     discardOutput discarded;
+     ostream discardStream(&discarded);
+     displayBuffer buffer;
+     vector<int> order(keys);
+     treeIterator iterator;
+     treeNode *node;
+     size_t added;
+     int column = INIT_COLUMN,
+         previous = INT_MIN;
+     bool memoryFail = false;
      
-     switch(treeAction)
+     sharedTree = createConcurrentTree(NULL, memoryFail);
+     
+     if ((sharedTree == NULL) || !openSnapshot(sharedTree, snapshot))
      {
-         case 'S':
-              cout << "\nValues stored in entire binary search tree are:" << endl;
-              if (!isEmptyTree(mainTree))
-              {
-                  inOrderDisplay(mainTree->root, initColumn);
-                  initColumn = INIT_COLUMN;
-                  cout << endl << endl;
-              }
-              break;
-              
-         case 'A':
-              do
-              {
-                  cout << "Enter a number to add to the tree: ";
-                  cin >> num;
-              }while (num <= 0);
-              miscNode = findNode(mainTree, num, flag);
-              if (!flag)
-              {
-                  miscNode = createNode(num);
-                  if (miscNode)
-                  {
-                      insertNode(mainTree, miscNode);
-                      cout << num << " added to tree." << endl;
-                  } // end if memory allocated for new node
-                  else
-                  {
-                      cout << "ERROR - A memory allocation failure has occurred." << endl;
-                      treeAction = EXIT_CHAR;
-                  } // end memory not allocated
-              }
-              else
-              {
-                  cout << "Number already exists in tree and cannot be added." << endl;
-              }
-              system("pause");
-              system("cls");
-              break;
-              
-         case 'D':
-              cout << "Enter a number to delete from the tree: ";
-              cin >> num;
-              miscNode = findNode(mainTree, num, flag);
-              if (miscNode != NULL)
-              {
-                  deleteNode(mainTree, miscNode->number);
-                  mainTree->count--;
-                  cout << num << " deleted from tree." << endl;
-              }
-              else
-              {
-                  cout << num << " does not exist in the binary search tree." << endl;
-              }
-              system("pause");
-              system("cls");
-              break;
-              
-         case 'F':
-              cout << "Enter a number to find: ";
-              cin >> num;
-              miscNode = findNode(mainTree, num, flag);
-              if (miscNode != NULL)
-              {
-                  cout << "Values stored subtree with root " << num << " are:" << endl;
-                  inOrderDisplay(miscNode, initColumn);
-                  cout << endl;
-                  initColumn = INIT_COLUMN;
-              }
-              else
-              {
-                 cout << num << " doen not exist in the binary search tree." << endl;
-              }
-              system("pause");
-              system("cls");
-              break;
+         cout << "snapshot skipped for " << distribution << " " << keys.size()
+              << ": the concurrent tree could not be created." << endl;
+     }
+     else
+     {
+         // the snapshot taken of the empty tree is only used for its slot
+         closeSnapshot(sharedTree, snapshot);
+         
+         result.structure = "snapshot";
+         result.distribution = distribution;
+         result.size = keys.size();
+         
+         result.operation = "add";
+         timeOperations(keys.size(), result, [&](size_t index)
+         {
+             result.found += concurrentInsert(sharedTree, keys[index], memoryFail);
+         });
+         result.height = treeDepth(sharedTree->root.load());
+         reportResult(result, results);
+         added = result.found;
+         
+         openSnapshot(sharedTree, snapshot);
+         shuffle(order.begin(), order.end(), mt19937(static_cast<unsigned>(keys.size())));
+         result.operation = "delete";
+         timeOperations(order.size(), result, [&](size_t index)
+         {
+             result.found += concurrentDelete(sharedTree, order[index], memoryFail);
+         });
+         result.height = treeDepth(sharedTree->root.load());
+         reportResult(result, results);
+         
+         result.operation = "traverse";
+         timeOperations(1, result, [&](size_t)
+         {
+             inOrderDisplay(snapshot.view.root, column, buffer, discardStream);
+         });
+         startIterator(iterator, snapshot.view.root);
+         for (node = nextNode(iterator); node != NULL; node = nextNode(iterator))
+         {
+             result.found += (node->number > previous);
+             previous = node->number;
+         }
+         result.operations = snapshot.view.count;
+         reportResult(result, results);
+         
+         if (result.found != added)
+         {
+             cout << "ERROR - The snapshot changed while it was open." << endl;
+         }
+         
+         // the next update deletes what only the snapshot held
+         closeSnapshot(sharedTree, snapshot);
+         result.operation = "reclaim";
+         timeOperations(1, result, [&](size_t)
+         {
+             result.found += concurrentInsert(sharedTree, 1, memoryFail);
+         });
+         result.height = treeDepth(sharedTree->root.load());
+         reportResult(result, results);
+     } // end if the concurrent tree was created
+     
+     if (sharedTree != NULL)
+     {
+         destroyConcurrentTree(sharedTree);
      }
      
      return;
 }
 
 //------------------------------------------------------------------------------
-// FUNCTION:     deleteNode
-// DESCRIPTION:  Traverses through the BST finding a target node that will be deleted.
+// FUNCTION:     benchmarkFinger
+// DESCRIPTION:  Times adding every integer to an unbalanced tree with a finger,
+//               as getData loads a file, and checks the two things the finger
+//               must keep: it never holds more than FINGER_MAX_LEVELS levels,
+//               and once it is finished every node size is one more than the
+//               sizes of its children. Sorted input does not degenerate here,
+//               since each key is added next to the one before it.
 // INPUT:
-//     Parameters:  mainTree - A pointer to the main BST structure.
-//                  num - An integer of the target value to be deleted
+//     Parameters:  distribution - The name of the distribution.
+//                  keys - The integers to add.
+//                  results - The CSV results file.
 // OUTPUT:
-//     Parameters:  mainTree - Same as input, passed by reference.
-// CALLS TO:     deleteFromTree
+//     Parameters:  results - Same as input, passed by reference.
+// CALLS TO:     createTree
+//               timeOperations
+//               fingerInsert
+//               finishFinger
+//               treeDepth
+//               reportResult
+//               startIterator
+//               nextNode
+//               nodeSize
+//               freeNodes
+//               destroyTree
 //------------------------------------------------------------------------------
 
-void deleteNode(binarySearchTree *&mainTree, int num)
+void benchmarkFinger(const string& distribution, const vector<int>& keys, ostream& results)
 {
-     treeNode *current,
-              *trail;
-     bool found = false;
+     binarySearchTree *mainTree = createTree();
+     basicFinger<treeNode> finger;
+     benchmarkResult result;
+     treeIterator iterator;
+     treeNode *node;
+     size_t mostLevels = 0,
+            wrongSizes = 0;
+     bool found,
+          memoryFail = false;
+     
+     mainTree->balanced = false;
+     finger.above = 0;
      
-     current = mainTree->root;
-     trail = mainTree->root;
+     result.structure = "finger";
+     result.distribution = distribution;
+     result.size = keys.size();
      
-     while ((current != NULL) && !found)
+     result.operation = "add";
+     timeOperations(keys.size(), result, [&](size_t index)
      {
-           if (current->number == num)
-           {
-               found = true;
-           }
-           else
-           {
-               trail = current;
-               
-               if (current->number > num)
-               {
-                   current = current->leftPtr;
-               }
-               else
-               {
-                   current = current->rightPtr;
-               }
-           }
+         if (!memoryFail)
+         {
+             fingerInsert(mainTree, finger, keys[index], found, memoryFail);
+             result.found += (!found && !memoryFail);
+             mostLevels = max(mostLevels, finger.levels.size());
+         }
+     });
+     finishFinger(mainTree, finger);
+     result.height = treeDepth(mainTree->root);
+     reportResult(result, results);
+     
+     startIterator(iterator, mainTree->root);
+     for (node = nextNode(iterator); node != NULL; node = nextNode(iterator))
+     {
+         wrongSizes += (node->size != 1 + nodeSize(node->leftPtr) + nodeSize(node->rightPtr));
      }
      
-     if (current == mainTree->root)
+     if (memoryFail)
      {
-         deleteFromTree(mainTree->root);
+         cout << "ERROR - A memory allocation failure has occurred." << endl;
      }
-     else if (trail->number > num)
+     if (mostLevels > FINGER_MAX_LEVELS)
      {
-          deleteFromTree(trail->leftPtr);
+         cout << "ERROR - The finger held " << mostLevels << " levels, more than "
+              << FINGER_MAX_LEVELS << "." << endl;
      }
-     else
+     if ((wrongSizes > 0) || (static_cast<size_t>(nodeSize(mainTree->root)) != result.found))
      {
-         deleteFromTree(trail->rightPtr);
+         cout << "ERROR - The finger left " << wrongSizes << " subtree sizes wrong." << endl;
      }
      
+     freeNodes(mainTree->root);
+     destroyTree(mainTree);
+     
      return;
 }
 
 //------------------------------------------------------------------------------
-// FUNCTION:     deleteFromTree
-// DESCRIPTION:  Deletes a node from the main BST structure.
+// FUNCTION:     benchmarkRecords
+// DESCRIPTION:  Times the same operations as benchmarkTree on a balanced tree
+//               of long long keys, each mapped to a string, built from the
+//               same templates as the int set. Each integer is shifted past
+//               the range of an int to make its key and stored with its
+//               decimal text. The finds check the text of each key found, and
+//               the traversal walks the tree with an iterator, since the
+//               display only formats ints.
 // INPUT:
-//     Parameters:  nodeToRemove - A pointer to the node that will be deleted.
+//     Parameters:  distribution - The name of the distribution.
+//                  keys - The integers to add.
+//                  queries - The integers to look up.
+//                  results - The CSV results file.
 // OUTPUT:
-//     Parameters:  nodeToRemove - Same as input, passed by reference.
-// CALLS TO:     N/A
+//     Parameters:  results - Same as input, passed by reference.
+// CALLS TO:     createTree
+//               timeOperations
+//               findNode
+//               createNode
+//               insertNode
+//               nodeHeight
+//               reportResult
+//               startIterator
+//               nextNode
+//               deleteNode
+//               freeNodes
+//               destroyTree
 //------------------------------------------------------------------------------
 
-void deleteFromTree(treeNode *&nodeToRemove)
+void benchmarkRecords(const string& distribution, const vector<int>& keys, const vector<int>& queries,
+                      ostream& results)
 {
-     treeNode *tempPtr,
-              *current,
-              *trail;
+     recordTree *mapTree = createTree<recordTree>();
+     recordTree::nodeType *node;
+     basicIterator<recordTree::nodeType> iterator;
+     benchmarkResult result;
+     vector<int> order(keys);
+     size_t textLength = 0;
+     bool flag;
      
-     if ((nodeToRemove->leftPtr == NULL) && (nodeToRemove->rightPtr == NULL))
-     {
-         tempPtr = nodeToRemove;
-         nodeToRemove = NULL;
-         delete tempPtr;
-     }
-     else if (nodeToRemove->leftPtr == NULL)
-     {
-          tempPtr = nodeToRemove;
-          nodeToRemove = tempPtr->rightPtr;
-          delete tempPtr;
-     }
-     else if (nodeToRemove->rightPtr == NULL)
-     {
-          tempPtr = nodeToRemove;
-          nodeToRemove = tempPtr->leftPtr;
-          delete tempPtr;
-     }
-     else
+     mapTree->balanced = true;
+     
+     result.structure = "records";
+     result.distribution = distribution;
+     result.size = keys.size();
+     
+     result.operation = "add";
+     timeOperations(keys.size(), result, [&](size_t index)
      {
-         current = nodeToRemove->leftPtr;
-         trail = NULL;
+         long long key = static_cast<long long>(keys[index]) << BENCHMARK_RECORD_SHIFT;
          
-         while (current->rightPtr != NULL)
+         if (findNode(mapTree, key, flag) == NULL)
          {
-               trail = current;
-               current = current->rightPtr;
+             node = createNode<recordTree::nodeType>(key);
+             node->value = to_string(keys[index]);
+             insertNode(mapTree, node);
+             result.found++;
          }
-         
-         nodeToRemove->number = current->number;
-         
-         if (trail == NULL)
+     });
+     result.height = nodeHeight(mapTree->root);
+     reportResult(result, results);
+     
+     result.operation = "find";
+     timeOperations(queries.size(), result, [&](size_t index)
+     {
+         node = findNode(mapTree, static_cast<long long>(queries[index]) << BENCHMARK_RECORD_SHIFT, flag);
+         result.found += ((node != NULL) && (node->value == to_string(queries[index])));
+     });
+     reportResult(result, results);
+     
+     result.operation = "traverse";
+     timeOperations(1, result, [&](size_t)
+     {
+         startIterator(iterator, mapTree->root);
+         for (node = nextNode(iterator); node != NULL; node = nextNode(iterator))
          {
-             nodeToRemove->leftPtr = current->leftPtr;
+             textLength += node->value.size();
+             result.found++;
          }
-         else
+     });
+     result.operations = result.found;
+     reportResult(result, results);
+     
+     shuffle(order.begin(), order.end(), mt19937(static_cast<unsigned>(keys.size())));
+     result.operation = "delete";
+     timeOperations(order.size(), result, [&](size_t index)
+     {
+         long long key = static_cast<long long>(order[index]) << BENCHMARK_RECORD_SHIFT;
+         
+         if (findNode(mapTree, key, flag) != NULL)
          {
-             trail->rightPtr = current->leftPtr;
+             deleteNode(mapTree, key);
+             mapTree->count--;
+             result.found++;
          }
-         delete current;
+     });
+     result.height = nodeHeight(mapTree->root);
+     reportResult(result, results);
+     
+     if (textLength == 0)
+     {
+         cout << "records held no text for " << distribution << " " << keys.size() << "." << endl;
      }
      
+     freeNodes(mapTree->root);
+     destroyTree(mapTree);
+     
      return;
 }
 
 //------------------------------------------------------------------------------
-// FUNCTION:     nodeCount
-// DESCRIPTION:  Accesses the count variable in the main BST structure.
+// FUNCTION:     timeOperations
+// DESCRIPTION:  Runs an operation for each index and records the total time and
+//               the latency of a sample of single operations. At most
+//               BENCHMARK_SAMPLES operations are timed one at a time, spread
+//               evenly, so the clock reads barely change the total. When the
+//               operation handles a batch of indexes it runs once per batch,
+//               and a timed run counts as the operations of its own batch,
+//               the last batch being shorter.
 // INPUT:
-//     Parameters:  mainTree - A pointer to the main BST structure.
+//     Parameters:  count - The number of operations.
+//                  operation - The operation, given the index of each run, or
+//                              of the first index of its batch.
+//                  batch - The number of indexes each run handles.
 // OUTPUT:
-//     Return Val:  num - An integer of the total nodes in the BST.
-// CALLS TO:     N/A
+//     Parameters:  result - Operations, seconds and latency percentiles set.
+// CALLS TO:     operation
 //------------------------------------------------------------------------------
 
-int nodeCount(binarySearchTree *mainTree)
+template <typename Operation>
+void timeOperations(size_t count, benchmarkResult& result, Operation operation, size_t batch)
 {
-    int num = 0;
-    
-    num = mainTree->count;
-    
-    return num;
+     vector<long long> samples;
+     chrono::steady_clock::time_point start,
+                                      opStart;
+     size_t runs = (count + batch - 1) / batch,
+            run,
+            sampleEvery = runs / BENCHMARK_SAMPLES + 1;
+     const double PERCENTILES[BENCHMARK_PERCENTILES] = {0.50, 0.90, 0.99, 0.999, 1.0};
+     int rank;
+     
+     samples.reserve(runs / sampleEvery + 1);
+     result.found = 0;
+     start = chrono::steady_clock::now();
+     
+     for (run = 0; run < runs; run++)
+     {
+         if (run % sampleEvery == 0)
+         {
+             opStart = chrono::steady_clock::now();
+             operation(run * batch);
+             samples.push_back(chrono::duration_cast<chrono::nanoseconds>(
+                                   chrono::steady_clock::now() - opStart).count()
+                               / static_cast<long long>(min(batch, count - run * batch)));
+         } // end if this operation is timed alone
+         else
+         {
+             operation(run * batch);
+         }
+     } // end for each run
+     
+     result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+     result.operations = count;
+     
+     sort(samples.begin(), samples.end());
+     for (rank = 0; rank < BENCHMARK_PERCENTILES; rank++)
+     {
+         result.latency[rank] = samples.empty() ? 0
+                              : samples[static_cast<size_t>(PERCENTILES[rank] * (samples.size() - 1))];
+     }
+     
+     return;
 }
 
 //------------------------------------------------------------------------------
-// FUNCTION:     inOrderDisplay
-// DESCRIPTION:  Traverses the BST using inorder traversal to display all nodes
-//               in ascending order.
+// FUNCTION:     reportResult
+// DESCRIPTION:  Writes one result as a CSV row and as a row of the table.
 // INPUT:
-//     Parameters:  node - A pointer to a node within the BST.
-//                  currentColumn - An integers of how many columns have been displayed.
+//     Parameters:  result - The measurements of one operation.
+//                  results - The CSV results file.
 // OUTPUT:
-//     Parameters:  currentColumn - Same as input, passed by reference.
-// CALLS TO:     inOrderDisplay
-//               formatDisplay
+//     Parameters:  results - Same as input, passed by reference.
+// CALLS TO:     peakMemory
 //------------------------------------------------------------------------------
 
-void inOrderDisplay(treeNode *node, int& currentColumn)
-{    
-     if (node != NULL)
+void reportResult(const benchmarkResult& result, ostream& results)
+{
+     double rate = (result.seconds > 0.0) ? result.operations / result.seconds : 0.0;
+     long peakKb = peakMemory();
+     int rank;
+     
+     results << result.structure << ',' << result.distribution << ',' << result.size << ','
+             << result.operation << ',' << result.operations << ',' << result.found << ','
+             << result.seconds << ',' << rate;
+     for (rank = 0; rank < BENCHMARK_PERCENTILES; rank++)
      {
-         inOrderDisplay(node->leftPtr, currentColumn);
-         formatDisplay(node->number, currentColumn);     
-         inOrderDisplay(node->rightPtr, currentColumn);
+         results << ',' << result.latency[rank];
      }
+     results << ',' << result.height << ',' << peakKb << endl;
+     
+     cout << left << setw(11) << result.structure << setw(10) << result.distribution << right
+          << setw(10) << result.size << setw(10) << result.operation << setw(14) << fixed
+          << setprecision(0) << rate << setw(12) << result.latency[0] << setw(12) << result.latency[2]
+          << setw(12) << result.latency[3] << setw(8) << result.height << setw(11) << peakKb << endl;
      
      return;
 }
 
 //------------------------------------------------------------------------------
-// FUNCTION:     formatDisplay
-// DESCRIPTION:  Displays an integer ensuring that there are 10 per row.
+// FUNCTION:     treeDepth
+// DESCRIPTION:  Measures the height of a tree from its depth histogram, since
+//               only balanced trees keep node heights.
 // INPUT:
-//     Parameters:  num - An integer from the BST to be displayed.
-//                  currentColumn - An integer of how many columns have been displayed.
+//     Parameters:  node - A pointer to the root of the tree.
 // OUTPUT:
-//     Parameters:  currentColumn - Same as input, passed by reference.
+//     Return Val:  height - The number of nodes on the longest path down.
+// CALLS TO:     depthHistogram
+//------------------------------------------------------------------------------
+
+int treeDepth(treeNode *node)
+{
+    vector<int> counts;
+    
+    return depthHistogram(node, counts);
+}
+
+//------------------------------------------------------------------------------
+// FUNCTION:     peakMemory
+// DESCRIPTION:  Returns the most memory the process has held so far.
+//               isolateBenchmark gives each structure a process of its own
+//               where it can.
+// INPUT:        N/A
+// OUTPUT:
+//     Return Val:  peakKb - Peak resident set size in kilobytes, 0 if unknown.
 // CALLS TO:     N/A
 //------------------------------------------------------------------------------
 
-void formatDisplay(int num, int& currentColumn)
+long peakMemory()
 {
-     if (currentColumn >= MAX_COLUMNS)
+     long peakKb = 0;
+     
+#if defined(_WIN32)
+     PROCESS_MEMORY_COUNTERS counters;
+     
+     if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
      {
-         currentColumn = INIT_COLUMN;
-         cout << endl;
+         peakKb = static_cast<long>(counters.PeakWorkingSetSize / 1024);
      }
-     cout << right << setw(6) << num;
-     currentColumn++;
+#elif defined(__unix__) || defined(__APPLE__)
+     struct rusage usage;
      
-     return;
+     if (getrusage(RUSAGE_SELF, &usage) == 0)
+     {
+         peakKb = usage.ru_maxrss;
+#if defined(__APPLE__)
+         peakKb /= 1024;
+#endif
+     }
+#endif
+     
+     return peakKb;
 }
 
 //------------------------------------------------------------------------------
-// FUNCTION:     freeNodes
-// DESCRIPTION:  Deallocates nodes from BST using postorder traversal.
+// FUNCTION:     discardOutput::overflow
+// DESCRIPTION:  Accepts and discards a character written to the stream.
 // INPUT:
-//     Parameters:  node - A pointer to a node in the BST.
+//     Parameters:  character - The character written.
 // OUTPUT:
-//     Parameters:  node - Same as input, passed by reference.
-// CALLS TO:     freeNodes
-//               deleteFromTree
+//     Return Val:  The character, to report success.
+// CALLS TO:     N/A
 //------------------------------------------------------------------------------
 
-void freeNodes(treeNode *&node)
+int discardOutput::overflow(int character)
 {
-     if (node != NULL)
-     {
-         freeNodes(node->leftPtr);
-         freeNodes(node->rightPtr);
-         deleteFromTree(node);
-     }
-     
-     return;
+    return character;
 }
 
 //------------------------------------------------------------------------------
-// FUNCTION:     destroyTree
-// DESCRIPTION:  Deallocates main BST structure from memory.
+// FUNCTION:     discardOutput::xsputn
+// DESCRIPTION:  Accepts and discards a block of characters written to the stream.
 // INPUT:
-//     Parameters:  mainTree - A pointer to the main BST structure.
+//     Parameters:  text - The characters written.
+//                  length - The number of characters.
 // OUTPUT:
-//     Parameters:  mainTree - Same as input, passed by reference.
+//     Return Val:  length - The number of characters accepted.
 // CALLS TO:     N/A
 //------------------------------------------------------------------------------
 
-void destroyTree(binarySearchTree *&mainTree)
+streamsize discardOutput::xsputn(const char *, streamsize length)
 {
-     delete mainTree;
-     
-     return;
+    return length;
 }
+#endif